@@ -0,0 +1,172 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _ADS_ASIO_H_
+#define _ADS_ASIO_H_
+
+#include "AdsLib.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include <memory>
+#include <vector>
+#include <poll.h>
+
+/**
+ * Runs the polling mode of the library on a boost::asio::io_context, so the
+ * library creates no threads of its own. The sockets of all connections are
+ * watched by the io_context, responses and notifications are processed by the
+ * thread running it and notification callbacks are invoked from that thread.
+ *
+ * Requests stay synchronous. Issue them from the thread running the io_context,
+ * while one waits for its response it processes other events inline.
+ *
+ * Start() has to be called before the first route is added. The io_context must
+ * be run by a single thread and the object must not be destroyed from within a
+ * notification callback. It may be destroyed while handlers are still queued in
+ * the io_context, those return without touching it. POSIX only, like the polling
+ * mode.
+ */
+struct AdsAsioLoop {
+    AdsAsioLoop(boost::asio::io_context& __io)
+        : io(__io),
+        generation(std::make_shared<uint64_t>(0))
+    {}
+
+    ~AdsAsioLoop()
+    {
+        Stop();
+    }
+
+    AdsAsioLoop(const AdsAsioLoop&) = delete;
+    AdsAsioLoop& operator=(const AdsAsioLoop&) = delete;
+
+    /**
+     * Enable the polling mode and watch its file descriptors
+     * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+     */
+    long Start()
+    {
+        const auto status = AdsSetPollingMode(true);
+        return status ? status : Watch();
+    }
+
+    /**
+     * Stop watching, pending handlers return without processing events
+     */
+    void Stop()
+    {
+        ++*generation;
+        for (auto& descriptor : descriptors) {
+            boost::system::error_code ignored;
+            descriptor->cancel(ignored);
+            // the file descriptors belong to the library
+            descriptor->release();
+        }
+        descriptors.clear();
+    }
+
+private:
+    boost::asio::io_context& io;
+    std::vector<std::unique_ptr<boost::asio::posix::stream_descriptor> > descriptors;
+
+    /**
+     * Handlers hold a weak reference and the generation they were queued in, so they
+     * neither run after Stop() nor dereference this object after its destruction.
+     */
+    const std::shared_ptr<uint64_t> generation;
+
+    static bool IsCurrent(const std::weak_ptr<uint64_t>& state, uint64_t current)
+    {
+        const auto alive = state.lock();
+        return alive && (*alive == current);
+    }
+
+    /**
+     * Watch the current set of file descriptors. The last one signals changes of
+     * the set, in which case all descriptors are replaced, as a closed socket
+     * might have been reopened with the same number.
+     */
+    long Watch()
+    {
+        std::vector<int> fds(8);
+        auto numFds = static_cast<uint32_t>(fds.size());
+        auto status = AdsGetPollFds(fds.data(), &numFds);
+        if (ADSERR_DEVICE_INVALIDSIZE == status) {
+            fds.resize(numFds);
+            status = AdsGetPollFds(fds.data(), &numFds);
+        }
+        if (status) {
+            return status;
+        }
+
+        Stop();
+        for (uint32_t i = 0; i < numFds; ++i) {
+            descriptors.emplace_back(new boost::asio::posix::stream_descriptor(io, fds[i]));
+            Wait(i);
+        }
+        return 0;
+    }
+
+    void Wait(size_t index)
+    {
+        const std::weak_ptr<uint64_t> state = generation;
+        const auto current = *generation;
+        descriptors[index]->async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                       [this, state, index, current](const boost::system::error_code& ec) {
+            if (!ec && IsCurrent(state, current)) {
+                Process(index);
+            }
+        });
+    }
+
+    void Process(size_t index)
+    {
+        const std::weak_ptr<uint64_t> state = generation;
+        const auto current = *generation;
+        AdsProcessEvents();
+        if (current != *generation) {
+            // a callback stopped the loop
+            return;
+        }
+        if (index + 1 == descriptors.size()) {
+            Watch();
+            return;
+        }
+
+        // the reactor reports edges only, AdsProcessEvents() might have left data behind
+        pollfd readable {descriptors[index]->native_handle(), POLLIN, 0};
+        if ((::poll(&readable, 1, 0) > 0) && (readable.revents & POLLIN)) {
+            boost::asio::post(io, [this, state, index, current]() {
+                if (IsCurrent(state, current)) {
+                    Process(index);
+                }
+            });
+        } else {
+            Wait(index);
+        }
+    }
+};
+
+#endif /* #ifndef _ADS_ASIO_H_ */
@@ -49,6 +49,7 @@
 #define AMSPORT_R0_PLC_RTS3             821
 #define AMSPORT_R0_PLC_RTS4             831
 #define AMSPORT_R0_PLC_TC3              851
+#define AMSPORT_R3_SYSSERV              10000
 
 ////////////////////////////////////////////////////////////////////////////////
 // ADS Cmd Ids
@@ -149,6 +150,27 @@
 #define ADSIOFFS_DEVDATA_ADSSTATE           0x0000      /**< ads state of device */
 #define ADSIOFFS_DEVDATA_DEVSTATE           0x0002      /**< device state */
 
+////////////////////////////////////////////////////////////////////////////////
+// System service index groups, served on AMSPORT_R3_SYSSERV
+#define SYSTEMSERVICE_FOPEN                 120         /**< AdsRW IOffs open flags, W: path, R: file handle */
+#define SYSTEMSERVICE_FCLOSE                121         /**< AdsRW IOffs file handle */
+#define SYSTEMSERVICE_FREAD                 122         /**< AdsRW IOffs file handle, R: data */
+#define SYSTEMSERVICE_FWRITE                123         /**< AdsRW IOffs file handle, W: data */
+#define SYSTEMSERVICE_FDELETE               131         /**< AdsRW IOffs path flags, W: path */
+#define SYSTEMSERVICE_FFILEFIND             133         /**< AdsRW IOffs path flags or find handle, W: pattern, R: entry */
+
+// SYSTEMSERVICE_FOPEN flags, combine one mode and one path
+#define FOPEN_READ                          0x0001
+#define FOPEN_WRITE                         0x0002
+#define FOPEN_APPEND                        0x0004
+#define FOPEN_PLUS                          0x0008
+#define FOPEN_BINARY                        0x0010
+#define FOPEN_TEXT                          0x0020
+#define FOPEN_PATH_GENERIC                  0x10000     /**< absolute path */
+#define FOPEN_PATH_BOOTPRJ                  0x20000     /**< relative to the boot project directory */
+#define FOPEN_PATH_BOOTDATA                 0x30000     /**< relative to the boot data directory */
+#define FOPEN_PATH_BOOTPATH                 0x40000     /**< relative to the boot directory */
+
 ////////////////////////////////////////////////////////////////////////////////
 // Global Return codes
 #define ERR_GLOBAL                          0x0000
@@ -408,5 +430,14 @@ struct AdsNotificationHeader {
 typedef void (* PAdsNotificationFuncEx)(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification,
                                         uint32_t hUser);
 
+/**
+ * @brief Type definition of the callback function required by the AdsLoadRoutes() function.
+ * @param[in] pNetId AmsNetId of the route
+ * @param[in] ip address of the route
+ * @param[in] status [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663) of the route
+ * @param[in] hUser custom handle pass to AdsLoadRoutes()
+ */
+typedef void (* PAdsRouteStatusFunc)(const AmsNetId* pNetId, const char* ip, long status, uint32_t hUser);
+
 #pragma pack( pop )
 #endif  // __ADSDEF_H__
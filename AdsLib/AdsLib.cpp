@@ -22,6 +22,12 @@
 
 #include "AdsLib.h"
 #include "AmsRouter.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
 
 static AmsRouter& GetRouter()
 {
@@ -29,7 +35,36 @@ static AmsRouter& GetRouter()
     return router;
 }
 
+struct ThreadPort {
+    uint16_t port = 0;
+
+    ~ThreadPort()
+    {
+        if (port) {
+            GetRouter().ClosePort(port);
+        }
+    }
+};
+
+static ThreadPort& CurrentThreadPort()
+{
+    static thread_local ThreadPort threadPort;
+    return threadPort;
+}
+
+static ThreadPort& GetThreadPort()
+{
+    auto& threadPort = CurrentThreadPort();
+    if (!threadPort.port) {
+        threadPort.port = GetRouter().OpenPort();
+    }
+    return threadPort;
+}
+
 #define ASSERT_PORT(port) do { \
+        if (ADSPORT_AUTO == (port)) { \
+            port = GetThreadPort().port; \
+        } \
         if ((port) <= 0 || (port) > UINT16_MAX) { \
             return ADSERR_CLIENT_PORTNOTOPEN; \
         } \
@@ -42,6 +77,23 @@ static AmsRouter& GetRouter()
         } \
 } while (false)
 
+static const size_t DEVICE_INFO_LENGTH = sizeof(AdsVersion) + DEVICE_NAME_LENGTH;
+static const size_t STATE_LENGTH = 2 * sizeof(uint16_t);
+
+static void ParseDeviceInfo(const uint8_t* buffer, char* devName, AdsVersion* version)
+{
+    version->version = buffer[0];
+    version->revision = buffer[1];
+    version->build = qFromLittleEndian<uint16_t>(buffer + offsetof(AdsVersion, build));
+    memcpy(devName, buffer + sizeof(*version), DEVICE_NAME_LENGTH);
+}
+
+static void ParseState(const uint8_t* buffer, uint16_t* adsState, uint16_t* devState)
+{
+    *adsState = qFromLittleEndian<uint16_t>(buffer);
+    *devState = qFromLittleEndian<uint16_t>(buffer + sizeof(*adsState));
+}
+
 long AdsAddRoute(const AmsNetId ams, const char* ip)
 {
     try {
@@ -51,6 +103,268 @@ long AdsAddRoute(const AmsNetId ams, const char* ip)
     }
 }
 
+long AdsAddRouteLazy(const AmsNetId ams, const char* ip)
+{
+    try {
+        return GetRouter().AddRoute(ams, IpV4(ip), true);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+void AdsSetIdleTimeout(uint32_t timeout)
+{
+    GetRouter().SetIdleTimeout(timeout);
+}
+
+long AdsSetPollingMode(bool enable)
+{
+    return GetRouter().SetPollingMode(enable);
+}
+
+long AdsGetPollFds(int* fds, uint32_t* numFds)
+{
+    if (!fds || !numFds) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        return GetRouter().GetPollFds(fds, *numFds);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsProcessEvents()
+{
+    try {
+        return GetRouter().ProcessEvents();
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+void AdsEnableRequestTiming(bool enable, uint32_t sampleInterval)
+{
+    GetRequestTimeline().Enable(enable, sampleInterval);
+}
+
+void AdsResetRequestTiming()
+{
+    GetRequestTimeline().Reset();
+}
+
+long AdsGetRequestStageHistogram(AdsRequestStage stage, AdsHistogram* histogram)
+{
+    if (!histogram || (stage < 0) || (stage >= ADS_STAGE_COUNT)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    GetRequestTimeline().GetHistogram(stage, *histogram);
+    return 0;
+}
+
+long AdsGetRequestTimeline(AdsRequestTiming* timings, uint32_t* numTimings)
+{
+    if (!timings || !numTimings) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    *numTimings = GetRequestTimeline().GetSamples(timings, *numTimings);
+    return 0;
+}
+
+void AdsTraceStart(uint32_t capacity, const char* exitPath)
+{
+    GetTracer().Start(capacity, exitPath ? exitPath : "");
+}
+
+void AdsTraceStop()
+{
+    GetTracer().Stop();
+}
+
+long AdsTraceDump(const char* path)
+{
+    if (!path) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    return GetTracer().Dump(path) ? 0 : ADSERR_DEVICE_ACCESSDENIED;
+}
+
+void AdsSetCallbackBudget(uint32_t budgetUs, uint32_t highWaterPercent, PAdsDispatcherEventFunc pFunc,
+                          uint32_t hUser)
+{
+    GetDispatcherMonitor().Configure(budgetUs, highWaterPercent, pFunc, hUser);
+}
+
+long AdsGetCallbackStatsEx(long port, AdsCallbackStats* stats, uint32_t* numStats)
+{
+    ASSERT_PORT(port);
+    if (!stats || !numStats) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    std::vector<AdsCallbackStats> all;
+    const auto status = GetRouter().GetCallbackStats((uint16_t)port, all);
+    if (status) {
+        return status;
+    }
+    std::sort(all.begin(), all.end(), [](const AdsCallbackStats& lhs, const AdsCallbackStats& rhs) {
+        return lhs.totalNs > rhs.totalNs;
+    });
+    *numStats = std::min<uint32_t>(*numStats, all.size());
+    std::copy(all.begin(), all.begin() + *numStats, stats);
+    return 0;
+}
+
+long AdsEnableLockStats(bool enable)
+{
+#ifdef CONFIG_ADSLIB_LOCK_STATS
+    LockStats::enabled = enable;
+    return 0;
+#else
+    return enable ? ADSERR_DEVICE_SRVNOTSUPP : 0;
+#endif
+}
+
+void AdsResetLockStats()
+{
+    LockStats::Reset();
+}
+
+long AdsGetLockStats(AdsLockStats* stats, uint32_t* numStats)
+{
+    if (!stats || !numStats) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    *numStats = static_cast<uint32_t>(LockStats::Get(stats, *numStats));
+    return 0;
+}
+
+static std::string RenderMetrics()
+{
+    MetricsWriter writer;
+    GetRouter().CollectMetrics(writer);
+    return writer.Str();
+}
+
+long AdsGetMetrics(char* buffer, uint32_t bufferLength, uint32_t* bytesWritten)
+{
+    if (!buffer || !bytesWritten) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    const auto text = RenderMetrics();
+    *bytesWritten = static_cast<uint32_t>(text.size());
+    if (text.size() >= bufferLength) {
+        return ADSERR_DEVICE_INVALIDSIZE;
+    }
+    memcpy(buffer, text.c_str(), text.size() + 1);
+    return 0;
+}
+
+long AdsWriteMetrics(PAdsMetricsFunc pFunc, uint32_t hUser)
+{
+    if (!pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    const auto text = RenderMetrics();
+    pFunc(text.c_str(), static_cast<uint32_t>(text.size()), hUser);
+    return 0;
+}
+
+long AdsGetMemoryUsage(const AmsNetId* pNetId, AdsMemoryUsage* usage)
+{
+    if (!usage) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    if (pNetId) {
+        return GetRouter().GetMemoryUsage(*pNetId, *usage);
+    }
+    GetMemoryUsage().Get(*usage);
+    return 0;
+}
+
+void AdsSetMemoryBudget(uint64_t bytes)
+{
+    SetMemoryBudget(bytes);
+}
+
+long AdsAddRoutes(uint32_t numRoutes, const AmsNetId* pNetIds, const char* const* ips, bool lazy, long* results)
+{
+    if (!pNetIds || !ips || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<AmsRoute> routes;
+        routes.reserve(numRoutes);
+        for (uint32_t i = 0; i < numRoutes; ++i) {
+            routes.emplace_back(pNetIds[i], IpV4 {ips[i] ? ips[i] : ""});
+        }
+        GetRouter().AddRoutes(routes, results, lazy);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsLoadRoutes(const char* path, bool lazy, PAdsRouteStatusFunc pFunc, uint32_t hUser)
+{
+    if (!path) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::ifstream file(path);
+        if (!file) {
+            return ADSERR_DEVICE_NOTFOUND;
+        }
+
+        std::vector<AmsNetId> netIds;
+        std::vector<std::string> ips;
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+            std::istringstream fields(line);
+            std::string netId;
+            std::string ip;
+            std::string trailing;
+            if (!(fields >> netId) || ('#' == netId[0])) {
+                continue;
+            }
+            if (!(fields >> ip) || (fields >> trailing)) {
+                LOG_WARN(path << ":" << std::dec << lineNumber << " malformed route '" << line << "'");
+                return ADSERR_DEVICE_SYNTAX;
+            }
+            netIds.emplace_back(netId);
+            ips.push_back(ip);
+        }
+
+        std::vector<const char*> ipPtrs;
+        for (const auto& ip : ips) {
+            ipPtrs.push_back(ip.c_str());
+        }
+        std::vector<long> results(netIds.size());
+        const auto status = AdsAddRoutes(netIds.size(), netIds.data(), ipPtrs.data(), lazy, results.data());
+        if (status) {
+            return status;
+        }
+
+        long firstError = 0;
+        for (size_t i = 0; i < netIds.size(); ++i) {
+            if (pFunc) {
+                pFunc(&netIds[i], ipPtrs[i], results[i], hUser);
+            }
+            if (!firstError) {
+                firstError = results[i];
+            }
+        }
+        return firstError;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
 void AdsDelRoute(const AmsNetId ams)
 {
     GetRouter().DelRoute(ams);
@@ -58,6 +372,12 @@ void AdsDelRoute(const AmsNetId ams)
 
 long AdsPortCloseEx(long port)
 {
+    if (ADSPORT_AUTO == port) {
+        // don't open a port just to close it again
+        auto& threadPort = CurrentThreadPort();
+        port = threadPort.port;
+        threadPort.port = 0;
+    }
     ASSERT_PORT(port);
     return GetRouter().ClosePort((uint16_t)port);
 }
@@ -115,8 +435,7 @@ long AdsSyncReadDeviceInfoReqEx(long port, const AmsAddr* pAddr, char* devName,
     }
 
     try {
-        static const size_t NAME_LENGTH = 16;
-        uint8_t buffer[sizeof(*version) + NAME_LENGTH];
+        uint8_t buffer[DEVICE_INFO_LENGTH];
         AmsRequest request {
             *pAddr,
             (uint16_t)port,
@@ -126,10 +445,7 @@ long AdsSyncReadDeviceInfoReqEx(long port, const AmsAddr* pAddr, char* devName,
         };
         const auto status = GetRouter().AdsRequest<AoEResponseHeader>(request);
         if (!status) {
-            version->version = buffer[0];
-            version->revision = buffer[1];
-            version->build = qFromLittleEndian<uint16_t>(buffer + offsetof(AdsVersion, build));
-            memcpy(devName, buffer + sizeof(*version), NAME_LENGTH);
+            ParseDeviceInfo(buffer, devName, version);
         }
         return status;
     } catch (const std::bad_alloc&) {
@@ -145,7 +461,7 @@ long AdsSyncReadStateReqEx(long port, const AmsAddr* pAddr, uint16_t* adsState,
     }
 
     try {
-        uint8_t buffer[sizeof(*adsState) + sizeof(*devState)];
+        uint8_t buffer[STATE_LENGTH];
         AmsRequest request {
             *pAddr,
             (uint16_t)port,
@@ -155,8 +471,7 @@ long AdsSyncReadStateReqEx(long port, const AmsAddr* pAddr, uint16_t* adsState,
         };
         const auto status = GetRouter().AdsRequest<AoEResponseHeader>(request);
         if (!status) {
-            *adsState = qFromLittleEndian<uint16_t>(buffer);
-            *devState = qFromLittleEndian<uint16_t>(buffer + sizeof(*adsState));
+            ParseState(buffer, adsState, devState);
         }
         return status;
     } catch (const std::bad_alloc&) {
@@ -234,6 +549,591 @@ long AdsSyncWriteReqEx(long           port,
     }
 }
 
+long AdsSyncWriteVerifyReqEx(long           port,
+                             const AmsAddr* pAddr,
+                             uint32_t       indexGroup,
+                             uint32_t       indexOffset,
+                             uint32_t       bufferLength,
+                             const void*    buffer,
+                             void*          readBack,
+                             bool*          mismatch)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!buffer || !readBack || !mismatch) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        static const uint32_t NUM_SUB_REQUESTS = 2;
+        static const uint32_t SUB_RESULT_LENGTH = 2 * sizeof(uint32_t);
+        std::vector<uint8_t> response(NUM_SUB_REQUESTS * SUB_RESULT_LENGTH + bufferLength);
+        uint32_t bytesRead = 0;
+        AmsRequest request {
+            *pAddr,
+            (uint16_t)port,
+            AoEHeader::READ_WRITE,
+            (uint32_t)response.size(),
+            response.data(),
+            &bytesRead,
+            sizeof(AoEReadWriteReqHeader) * (1 + NUM_SUB_REQUESTS) + bufferLength
+        };
+        request.frame.prepend(buffer, bufferLength);
+        request.frame.prepend(AoEReadWriteReqHeader {indexGroup, indexOffset, bufferLength, 0});
+        request.frame.prepend(AoEReadWriteReqHeader {indexGroup, indexOffset, 0, bufferLength});
+        request.frame.prepend(AoEReadWriteReqHeader {
+            ADSIGRP_SUMUP_READWRITE,
+            NUM_SUB_REQUESTS,
+            (uint32_t)response.size(),
+            (uint32_t)(sizeof(AoEReadWriteReqHeader) * NUM_SUB_REQUESTS + bufferLength)
+        });
+        const auto status = GetRouter().AdsRequest<AoEReadResponseHeader>(request);
+        if (status) {
+            return status;
+        }
+
+        if (bytesRead < NUM_SUB_REQUESTS * SUB_RESULT_LENGTH) {
+            return ADSERR_CLIENT_SYNCRESINVALID;
+        }
+        const uint8_t* pos = response.data();
+        const auto writeResult = qFromLittleEndian<uint32_t>(pos);
+        const auto writeLength = qFromLittleEndian<uint32_t>(pos + sizeof(uint32_t));
+        const auto readResult = qFromLittleEndian<uint32_t>(pos + SUB_RESULT_LENGTH);
+        const auto readLength = qFromLittleEndian<uint32_t>(pos + SUB_RESULT_LENGTH + sizeof(uint32_t));
+        if (writeResult) {
+            return writeResult;
+        }
+        if (readResult) {
+            return readResult;
+        }
+
+        const size_t dataOffset = NUM_SUB_REQUESTS * SUB_RESULT_LENGTH + writeLength;
+        if ((readLength > bufferLength) || (dataOffset + readLength > bytesRead)) {
+            return ADSERR_CLIENT_SYNCRESINVALID;
+        }
+        memcpy(readBack, pos + dataOffset, readLength);
+        *mismatch = (readLength != bufferLength) || memcmp(buffer, readBack, bufferLength);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+/**
+ * Bytes of the process image read or written by one sub request of a sum up request
+ */
+struct ByteRange {
+    uint32_t offset;
+    uint32_t length;
+    size_t pos; // of the data in the buffer of all ranges
+};
+
+static const size_t SUMUP_MAX_SUB_REQUESTS = 500;
+static const size_t SUMUP_MAX_RESPONSE = AmsResponse::FRAME_SIZE - sizeof(AoEReadResponseHeader);
+static const uint32_t BIT_RANGE_MAX_LENGTH = 1024;
+
+/**
+ * Translate a bit addressed index group to the corresponding byte addressed one
+ */
+static bool ByteGroup(uint32_t indexGroup, uint32_t& byteGroup)
+{
+    switch (indexGroup) {
+    case ADSIGRP_IOIMAGE_RWIX:
+        byteGroup = ADSIGRP_IOIMAGE_RWIB;
+        return true;
+
+    case ADSIGRP_IOIMAGE_RWOX:
+        byteGroup = ADSIGRP_IOIMAGE_RWOB;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Merge the bytes containing <bitAddresses> into sorted ranges. Bytes up to <maxGap> apart
+ * share a range, as reading a few needless bytes is cheaper than another sub request.
+ */
+static std::vector<ByteRange> MergeBitAddresses(uint32_t numBits, const uint32_t* bitAddresses, uint32_t maxGap)
+{
+    std::vector<uint32_t> bytes(bitAddresses, bitAddresses + numBits);
+    for (auto& b : bytes) {
+        b /= 8;
+    }
+    std::sort(bytes.begin(), bytes.end());
+    bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+
+    std::vector<ByteRange> ranges;
+    for (const auto b : bytes) {
+        if (!ranges.empty()) {
+            auto& last = ranges.back();
+            if ((b - (last.offset + last.length) <= maxGap) && (b - last.offset < BIT_RANGE_MAX_LENGTH)) {
+                last.length = b - last.offset + 1;
+                continue;
+            }
+        }
+        const size_t pos = ranges.empty() ? 0 : ranges.back().pos + ranges.back().length;
+        ranges.push_back(ByteRange {b, 1, pos});
+    }
+    return ranges;
+}
+
+static uint8_t& BitByte(std::vector<uint8_t>& buffer, const std::vector<ByteRange>& ranges, uint32_t bitAddress)
+{
+    const uint32_t offset = bitAddress / 8;
+    const auto it = std::upper_bound(ranges.begin(), ranges.end(), offset,
+                                     [](uint32_t o, const ByteRange& r) { return o < r.offset; }) - 1;
+    return buffer[it->pos + offset - it->offset];
+}
+
+/**
+ * @return end of the ranges, which fit into one sum up request starting at <first>
+ */
+static std::vector<ByteRange>::const_iterator NextSumUp(std::vector<ByteRange>::const_iterator first,
+                                                        std::vector<ByteRange>::const_iterator end)
+{
+    size_t responseLength = 0;
+    auto last = first;
+    for ( ; (last != end) && (last - first < (ptrdiff_t)SUMUP_MAX_SUB_REQUESTS); ++last) {
+        responseLength += sizeof(uint32_t) + last->length;
+        if (responseLength > SUMUP_MAX_RESPONSE) {
+            break;
+        }
+    }
+    return last;
+}
+
+/**
+ * Read or write the bytes of <ranges> from/to <buffer>, using as few sum up requests as possible
+ */
+static long SumUpRanges(long                          port,
+                        const AmsAddr*                pAddr,
+                        uint32_t                      sumUpGroup,
+                        uint32_t                      indexGroup,
+                        const std::vector<ByteRange>& ranges,
+                        uint8_t*                      buffer)
+{
+    const bool isRead = (ADSIGRP_SUMUP_READ == sumUpGroup);
+    for (auto first = ranges.cbegin(); first != ranges.cend(); ) {
+        const auto last = NextSumUp(first, ranges.cend());
+        const auto numRequests = (uint32_t)(last - first);
+        const auto dataLength = (uint32_t)((last - 1)->pos + (last - 1)->length - first->pos);
+        const uint32_t resultsLength = numRequests * sizeof(uint32_t);
+        const uint32_t headersLength = numRequests * sizeof(AoERequestHeader);
+        const uint32_t writeLength = headersLength + (isRead ? 0 : dataLength);
+        std::vector<uint8_t> response(resultsLength + (isRead ? dataLength : 0));
+        uint32_t bytesRead = 0;
+        AmsRequest request {
+            *pAddr,
+            (uint16_t)port,
+            AoEHeader::READ_WRITE,
+            (uint32_t)response.size(),
+            response.data(),
+            &bytesRead,
+            sizeof(AoEReadWriteReqHeader) + writeLength
+        };
+        if (!isRead) {
+            request.frame.prepend(buffer + first->pos, dataLength);
+        }
+        for (auto r = last; r != first; ) {
+            --r;
+            request.frame.prepend(AoERequestHeader {indexGroup, r->offset, r->length});
+        }
+        request.frame.prepend(AoEReadWriteReqHeader {
+            sumUpGroup,
+            numRequests,
+            (uint32_t)response.size(),
+            writeLength
+        });
+        const auto status = GetRouter().AdsRequest<AoEReadResponseHeader>(request);
+        if (status) {
+            return status;
+        }
+
+        if (bytesRead != response.size()) {
+            return ADSERR_CLIENT_SYNCRESINVALID;
+        }
+        for (uint32_t i = 0; i < numRequests; ++i) {
+            const auto result = qFromLittleEndian<uint32_t>(response.data() + i * sizeof(uint32_t));
+            if (result) {
+                return result;
+            }
+        }
+        if (isRead) {
+            memcpy(buffer + first->pos, response.data() + resultsLength, dataLength);
+        }
+        first = last;
+    }
+    return 0;
+}
+
+long AdsSyncReadBitsReqEx(long            port,
+                          const AmsAddr*  pAddr,
+                          uint32_t        indexGroup,
+                          uint32_t        numBits,
+                          const uint32_t* bitAddresses,
+                          uint8_t*        values)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    uint32_t byteGroup;
+    if (!bitAddresses || !values || !ByteGroup(indexGroup, byteGroup)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        const auto ranges = MergeBitAddresses(numBits, bitAddresses, sizeof(AoERequestHeader));
+        std::vector<uint8_t> buffer(ranges.empty() ? 0 : ranges.back().pos + ranges.back().length);
+        const auto status = SumUpRanges(port, pAddr, ADSIGRP_SUMUP_READ, byteGroup, ranges, buffer.data());
+        if (status) {
+            return status;
+        }
+
+        memset(values, 0, (numBits + 7) / 8);
+        for (uint32_t i = 0; i < numBits; ++i) {
+            if (BitByte(buffer, ranges, bitAddresses[i]) & (1 << (bitAddresses[i] % 8))) {
+                values[i / 8] |= 1 << (i % 8);
+            }
+        }
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncWriteBitsReqEx(long            port,
+                           const AmsAddr*  pAddr,
+                           uint32_t        indexGroup,
+                           uint32_t        numBits,
+                           const uint32_t* bitAddresses,
+                           const uint8_t*  values)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    uint32_t byteGroup;
+    if (!bitAddresses || !values || !ByteGroup(indexGroup, byteGroup)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        // don't merge across gaps, so bytes without addressed bits are never written
+        const auto ranges = MergeBitAddresses(numBits, bitAddresses, 0);
+        std::vector<uint8_t> buffer(ranges.empty() ? 0 : ranges.back().pos + ranges.back().length);
+        const auto status = SumUpRanges(port, pAddr, ADSIGRP_SUMUP_READ, byteGroup, ranges, buffer.data());
+        if (status) {
+            return status;
+        }
+
+        for (uint32_t i = 0; i < numBits; ++i) {
+            const uint8_t mask = 1 << (bitAddresses[i] % 8);
+            auto& byte = BitByte(buffer, ranges, bitAddresses[i]);
+            byte = (values[i / 8] & (1 << (i % 8))) ? (byte | mask) : (byte & ~mask);
+        }
+        return SumUpRanges(port, pAddr, ADSIGRP_SUMUP_WRITE, byteGroup, ranges, buffer.data());
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+static const uint32_t FILE_CHUNK_SIZE = AmsResponse::FRAME_SIZE - sizeof(AoEReadResponseHeader);
+static const size_t FILE_WINDOW_SIZE = 16;
+static const uint32_t FILE_SEGMENT_CHUNKS = 256;
+static const uint32_t FILE_SEGMENT_SIZE = FILE_SEGMENT_CHUNKS * FILE_CHUNK_SIZE;
+static const size_t FILE_ENTRY_LENGTH = 324;
+static const size_t FILE_ENTRY_NAME_OFFSET = 48;
+
+/**
+ * Temporary local ports to keep several requests to the same target in flight,
+ * as a port waits for one response at a time. Create it once per transfer, as
+ * opening and closing ports is not free.
+ */
+struct PortWindow {
+    PortWindow(uint16_t port, size_t size)
+    {
+        uint32_t timeout = 0;
+        if (GetRouter().GetTimeout(port, timeout)) {
+            size = 1;
+        }
+        ports.reserve(size);
+        ports.push_back(port);
+        while (ports.size() < size) {
+            const auto extra = GetRouter().OpenPort();
+            if (!extra) {
+                LOG_WARN("No free port, transferring with a window of " << std::dec << ports.size() << " instead of " <<
+                         size);
+                break;
+            }
+            GetRouter().SetTimeout(extra, timeout);
+            ports.push_back(extra);
+        }
+    }
+
+    ~PortWindow()
+    {
+        for (size_t i = 1; i < ports.size(); ++i) {
+            GetRouter().ClosePort(ports[i]);
+        }
+    }
+
+    uint16_t operator[](size_t i) const
+    {
+        return ports[i % ports.size()];
+    }
+
+private:
+    std::vector<uint16_t> ports;
+};
+
+/**
+ * Read or write <length> bytes with a sliding window of SYSTEMSERVICE_FREAD/FWRITE requests
+ */
+static long FileTransfer(const PortWindow& window,
+                         const AmsAddr*    pAddr,
+                         uint32_t          indexGroup,
+                         uint32_t          hFile,
+                         uint32_t          length,
+                         uint8_t*          buffer,
+                         uint32_t*         bytesTransferred)
+{
+    const bool isRead = (SYSTEMSERVICE_FREAD == indexGroup);
+    const uint32_t numChunks = length / FILE_CHUNK_SIZE + !!(length % FILE_CHUNK_SIZE);
+    std::vector<AmsRequest> requests;
+    std::vector<long> results(std::min(numChunks, FILE_SEGMENT_CHUNKS));
+    std::vector<uint32_t> bytesRead(results.size());
+    *bytesTransferred = 0;
+    for (uint32_t first = 0; first < numChunks; first += FILE_SEGMENT_CHUNKS) {
+        const auto count = std::min(numChunks - first, FILE_SEGMENT_CHUNKS);
+        requests.clear();
+        requests.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t offset = (first + i) * FILE_CHUNK_SIZE;
+            const uint32_t chunkLength = std::min(length - offset, FILE_CHUNK_SIZE);
+            const uint32_t readLength = isRead ? chunkLength : 0;
+            const uint32_t writeLength = isRead ? 0 : chunkLength;
+            requests.emplace_back(*pAddr,
+                                  window[i],
+                                  uint16_t {AoEHeader::READ_WRITE},
+                                  readLength,
+                                  buffer + offset,
+                                  &bytesRead[i],
+                                  sizeof(AoEReadWriteReqHeader) + writeLength);
+            requests.back().frame.prepend(buffer + offset, writeLength);
+            requests.back().frame.prepend(AoEReadWriteReqHeader {
+                indexGroup,
+                hFile,
+                readLength,
+                writeLength
+            });
+        }
+        GetRouter().AdsRequestMulti<AoEReadResponseHeader>(requests, results.data());
+
+        for (uint32_t i = 0; i < count; ++i) {
+            if (results[i]) {
+                return results[i];
+            }
+            if (!isRead) {
+                *bytesTransferred += requests[i].bufferLength;
+                continue;
+            }
+            *bytesTransferred += bytesRead[i];
+            if (bytesRead[i] < requests[i].bufferLength) {
+                // end of file, the requests behind this one read nothing
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+long AdsFileOpenEx(long port, const AmsAddr* pAddr, const char* path, uint32_t flags, uint32_t* hFile)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!path || !hFile) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    uint8_t handle[sizeof(*hFile)];
+    uint32_t bytesRead = 0;
+    const auto status = AdsSyncReadWriteReqEx2(port, pAddr, SYSTEMSERVICE_FOPEN, flags, sizeof(handle), handle,
+                                               (uint32_t)strlen(path) + 1, path, &bytesRead);
+    if (status) {
+        return status;
+    }
+    if (bytesRead != sizeof(handle)) {
+        return ADSERR_CLIENT_SYNCRESINVALID;
+    }
+    *hFile = qFromLittleEndian<uint32_t>(handle);
+    return 0;
+}
+
+long AdsFileCloseEx(long port, const AmsAddr* pAddr, uint32_t hFile)
+{
+    uint8_t unused = 0;
+    return AdsSyncReadWriteReqEx2(port, pAddr, SYSTEMSERVICE_FCLOSE, hFile, 0, &unused, 0, &unused, nullptr);
+}
+
+long AdsFileReadEx(long port, const AmsAddr* pAddr, uint32_t hFile, uint32_t length, void* buffer,
+                   uint32_t* bytesRead)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!buffer || !bytesRead) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        const PortWindow window {(uint16_t)port, FILE_WINDOW_SIZE};
+        return FileTransfer(window, pAddr, SYSTEMSERVICE_FREAD, hFile, length, (uint8_t*)buffer, bytesRead);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsFileWriteEx(long port, const AmsAddr* pAddr, uint32_t hFile, uint32_t length, const void* buffer)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!buffer) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        const PortWindow window {(uint16_t)port, FILE_WINDOW_SIZE};
+        uint32_t bytesWritten;
+        return FileTransfer(window, pAddr, SYSTEMSERVICE_FWRITE, hFile, length, (uint8_t*)buffer, &bytesWritten);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsFileDownloadEx(long           port,
+                       const AmsAddr* pAddr,
+                       const char*    path,
+                       uint32_t       flags,
+                       const char*    localPath,
+                       uint64_t*      bytesCopied)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!path || !localPath) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::ofstream file(localPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return ADSERR_DEVICE_ACCESSDENIED;
+        }
+
+        uint32_t hFile;
+        auto status = AdsFileOpenEx(port, pAddr, path, flags | FOPEN_READ | FOPEN_BINARY, &hFile);
+        if (status) {
+            return status;
+        }
+
+        const PortWindow window {(uint16_t)port, FILE_WINDOW_SIZE};
+        std::vector<uint8_t> segment(FILE_SEGMENT_SIZE);
+        uint64_t total = 0;
+        uint32_t bytesRead;
+        do {
+            status = FileTransfer(window, pAddr, SYSTEMSERVICE_FREAD, hFile, FILE_SEGMENT_SIZE, segment.data(),
+                                  &bytesRead);
+            if (!file.write((const char*)segment.data(), bytesRead)) {
+                status = status ? status : ADSERR_DEVICE_ACCESSDENIED;
+            }
+            total += bytesRead;
+        } while (!status && (bytesRead == FILE_SEGMENT_SIZE));
+
+        const auto closeStatus = AdsFileCloseEx(port, pAddr, hFile);
+        if (bytesCopied) {
+            *bytesCopied = total;
+        }
+        return status ? status : closeStatus;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsFileUploadEx(long port, const AmsAddr* pAddr, const char* localPath, const char* path, uint32_t flags)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!path || !localPath) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::ifstream file(localPath, std::ios::binary);
+        if (!file) {
+            return ADSERR_DEVICE_NOTFOUND;
+        }
+
+        uint32_t hFile;
+        auto status = AdsFileOpenEx(port, pAddr, path, flags | FOPEN_WRITE | FOPEN_BINARY, &hFile);
+        if (status) {
+            return status;
+        }
+
+        const PortWindow window {(uint16_t)port, FILE_WINDOW_SIZE};
+        std::vector<uint8_t> segment(FILE_SEGMENT_SIZE);
+        while (!status && file) {
+            file.read((char*)segment.data(), segment.size());
+            uint32_t bytesWritten;
+            status = FileTransfer(window, pAddr, SYSTEMSERVICE_FWRITE, hFile, (uint32_t)file.gcount(),
+                                  segment.data(), &bytesWritten);
+        }
+        if (!status && !file.eof()) {
+            status = ADSERR_DEVICE_ACCESSDENIED;
+        }
+
+        const auto closeStatus = AdsFileCloseEx(port, pAddr, hFile);
+        return status ? status : closeStatus;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+/**
+ * Parse an entry of SYSTEMSERVICE_FFILEFIND, laid out like WIN32_FIND_DATA preceded by the find handle
+ */
+static uint32_t ParseFileEntry(const uint8_t* buffer, AdsFileEntry& entry)
+{
+    entry.attributes = qFromLittleEndian<uint32_t>(buffer + 4);
+    entry.lastWriteTime = qFromLittleEndian<uint32_t>(buffer + 24) |
+                          (uint64_t)qFromLittleEndian<uint32_t>(buffer + 28) << 32;
+    entry.size = (uint64_t)qFromLittleEndian<uint32_t>(buffer + 32) << 32 | qFromLittleEndian<uint32_t>(buffer + 36);
+    memcpy(entry.name, buffer + FILE_ENTRY_NAME_OFFSET, sizeof(entry.name));
+    entry.name[sizeof(entry.name) - 1] = '\0';
+    return qFromLittleEndian<uint32_t>(buffer);
+}
+
+long AdsFileFindEx(long              port,
+                   const AmsAddr*    pAddr,
+                   const char*       pattern,
+                   uint32_t          flags,
+                   PAdsFileEntryFunc pFunc,
+                   uint32_t          hUser)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!pattern || !pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    uint8_t buffer[FILE_ENTRY_LENGTH];
+    uint32_t bytesRead = 0;
+    auto status = AdsSyncReadWriteReqEx2(port, pAddr, SYSTEMSERVICE_FFILEFIND, flags, sizeof(buffer), buffer,
+                                         (uint32_t)strlen(pattern) + 1, pattern, &bytesRead);
+    uint32_t hFind = 0;
+    while (!status) {
+        if (bytesRead != sizeof(buffer)) {
+            status = ADSERR_CLIENT_SYNCRESINVALID;
+            break;
+        }
+        AdsFileEntry entry;
+        hFind = ParseFileEntry(buffer, entry);
+        pFunc(&entry, hUser);
+        status = AdsSyncReadWriteReqEx2(port, pAddr, SYSTEMSERVICE_FFILEFIND, hFind, sizeof(buffer), buffer,
+                                        0, buffer, &bytesRead);
+    }
+
+    if (hFind) {
+        AdsFileCloseEx(port, pAddr, hFind);
+    }
+    return (ADSERR_DEVICE_NOTFOUND == status) ? 0 : status;
+}
+
 long AdsSyncWriteControlReqEx(long           port,
                               const AmsAddr* pAddr,
                               uint16_t       adsState,
@@ -325,3 +1225,193 @@ long AdsSyncSetTimeoutEx(long port, uint32_t timeout)
     ASSERT_PORT(port);
     return GetRouter().SetTimeout((uint16_t)port, timeout);
 }
+
+long AdsSyncReadReqMulti(long           port,
+                         uint32_t       numTargets,
+                         const AmsAddr* pAddrs,
+                         uint32_t       indexGroup,
+                         uint32_t       indexOffset,
+                         uint32_t       bufferLength,
+                         void*          buffers,
+                         uint32_t*      bytesRead,
+                         long*          results)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddrs);
+    if (!buffers || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<AmsRequest> requests;
+        requests.reserve(numTargets);
+        for (size_t i = 0; i < numTargets; ++i) {
+            requests.emplace_back(pAddrs[i],
+                                  (uint16_t)port,
+                                  uint16_t {AoEHeader::READ},
+                                  bufferLength,
+                                  (uint8_t*)buffers + i * bufferLength,
+                                  bytesRead ? bytesRead + i : nullptr,
+                                  sizeof(AoERequestHeader));
+            requests.back().frame.prepend(AoERequestHeader {
+                indexGroup,
+                indexOffset,
+                bufferLength
+            });
+        }
+        GetRouter().AdsRequestMulti<AoEReadResponseHeader>(requests, results);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncReadDeviceInfoReqMulti(long           port,
+                                   uint32_t       numTargets,
+                                   const AmsAddr* pAddrs,
+                                   char*          devNames,
+                                   AdsVersion*    versions,
+                                   long*          results)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddrs);
+    if (!devNames || !versions || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<uint8_t> buffer(numTargets * DEVICE_INFO_LENGTH);
+        std::vector<AmsRequest> requests;
+        requests.reserve(numTargets);
+        for (size_t i = 0; i < numTargets; ++i) {
+            requests.emplace_back(pAddrs[i],
+                                  (uint16_t)port,
+                                  uint16_t {AoEHeader::READ_DEVICE_INFO},
+                                  DEVICE_INFO_LENGTH,
+                                  buffer.data() + i * DEVICE_INFO_LENGTH);
+        }
+        GetRouter().AdsRequestMulti<AoEResponseHeader>(requests, results);
+        for (size_t i = 0; i < numTargets; ++i) {
+            if (!results[i]) {
+                ParseDeviceInfo(buffer.data() + i * DEVICE_INFO_LENGTH, devNames + i * DEVICE_NAME_LENGTH,
+                                versions + i);
+            }
+        }
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncReadStateReqMulti(long           port,
+                              uint32_t       numTargets,
+                              const AmsAddr* pAddrs,
+                              uint16_t*      adsStates,
+                              uint16_t*      devStates,
+                              long*          results)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddrs);
+    if (!adsStates || !devStates || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<uint8_t> buffer(numTargets * STATE_LENGTH);
+        std::vector<AmsRequest> requests;
+        requests.reserve(numTargets);
+        for (size_t i = 0; i < numTargets; ++i) {
+            requests.emplace_back(pAddrs[i],
+                                  (uint16_t)port,
+                                  uint16_t {AoEHeader::READ_STATE},
+                                  STATE_LENGTH,
+                                  buffer.data() + i * STATE_LENGTH);
+        }
+        GetRouter().AdsRequestMulti<AoEResponseHeader>(requests, results);
+        for (size_t i = 0; i < numTargets; ++i) {
+            if (!results[i]) {
+                ParseState(buffer.data() + i * STATE_LENGTH, adsStates + i, devStates + i);
+            }
+        }
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncReadWriteReqMulti(long           port,
+                              uint32_t       numTargets,
+                              const AmsAddr* pAddrs,
+                              uint32_t       indexGroup,
+                              uint32_t       indexOffset,
+                              uint32_t       readLength,
+                              void*          readData,
+                              uint32_t       writeLength,
+                              const void*    writeData,
+                              uint32_t*      bytesRead,
+                              long*          results)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddrs);
+    if (!readData || !writeData || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<AmsRequest> requests;
+        requests.reserve(numTargets);
+        for (size_t i = 0; i < numTargets; ++i) {
+            requests.emplace_back(pAddrs[i],
+                                  (uint16_t)port,
+                                  uint16_t {AoEHeader::READ_WRITE},
+                                  readLength,
+                                  (uint8_t*)readData + i * readLength,
+                                  bytesRead ? bytesRead + i : nullptr,
+                                  sizeof(AoEReadWriteReqHeader) + writeLength);
+            requests.back().frame.prepend(writeData, writeLength);
+            requests.back().frame.prepend(AoEReadWriteReqHeader {
+                indexGroup,
+                indexOffset,
+                readLength,
+                writeLength
+            });
+        }
+        GetRouter().AdsRequestMulti<AoEReadResponseHeader>(requests, results);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncWriteReqMulti(long           port,
+                          uint32_t       numTargets,
+                          const AmsAddr* pAddrs,
+                          uint32_t       indexGroup,
+                          uint32_t       indexOffset,
+                          uint32_t       bufferLength,
+                          const void*    buffer,
+                          long*          results)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddrs);
+    if (!buffer || !results) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::vector<AmsRequest> requests;
+        requests.reserve(numTargets);
+        for (size_t i = 0; i < numTargets; ++i) {
+            requests.emplace_back(pAddrs[i],
+                                  (uint16_t)port,
+                                  uint16_t {AoEHeader::WRITE},
+                                  0, nullptr, nullptr,
+                                  sizeof(AoERequestHeader) + bufferLength);
+            requests.back().frame.prepend(buffer, bufferLength);
+            requests.back().frame.prepend<AoERequestHeader>({
+                indexGroup,
+                indexOffset,
+                bufferLength
+            });
+        }
+        GetRouter().AdsRequestMulti<AoEReadResponseHeader>(requests, results);
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
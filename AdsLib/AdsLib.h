@@ -25,6 +25,14 @@
 
 #include "AdsDef.h"
 
+/**
+ * Pseudo port number, which can be passed as <port> to all functions of this
+ * library. It refers to a port owned by the calling thread, which is opened
+ * on first use and closed automatically when the thread exits. Threads using
+ * ADSPORT_AUTO never share a port and so never block each other.
+ */
+#define ADSPORT_AUTO (-1L)
+
 /**
  * Add new ams route to target system
  * @param[in] ams address of the target system
@@ -33,8 +41,82 @@
  */
 long AdsAddRoute(AmsNetId ams, const char* ip);
 
+/**
+ * Add new ams route to target system, without connecting to it. The connection
+ * is established on first use of the route.
+ * @param[in] ams address of the target system
+ * @param[in] ip address of the target system
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsAddRouteLazy(AmsNetId ams, const char* ip);
+
+/**
+ * Close connections to target systems, which had no pending requests or
+ * notifications for the specified time. Closed connections are reestablished
+ * on next use.
+ * @param[in] timeout in ms, 0 keeps idle connections open (default)
+ */
+void AdsSetIdleTimeout(uint32_t timeout);
+
+/**
+ * Enable or disable the polling mode. In polling mode the library doesn't create
+ * any threads. Instead the application watches the file descriptors returned by
+ * AdsGetPollFds() in its own event loop and calls AdsProcessEvents() when one of
+ * them is readable. Notification callbacks are invoked from within
+ * AdsProcessEvents() or from within a synchronous request waiting for its response.
+ * The mode can only be changed as long as no route exists. If the library was
+ * built with CONFIG_ADSLIB_SINGLE_THREADED, polling mode is always enabled.
+ * @param[in] enable
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSetPollingMode(bool enable);
+
+/**
+ * Get the file descriptors to watch for readability in polling mode: the
+ * sockets of all established connections and an event descriptor, which
+ * becomes readable whenever this set changes.
+ * @param[out] fds buffer for the file descriptors
+ * @param[in,out] numFds capacity of fds on input, number of file descriptors on output
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetPollFds(int* fds, uint32_t* numFds);
+
+/**
+ * Process all received responses and notifications without blocking. Only
+ * available in polling mode.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsProcessEvents();
+
+/**
+ * Add multiple ams routes at once. Connections to new target systems are
+ * established concurrently.
+ * @param[in] numRoutes number of routes
+ * @param[in] pNetIds array of numRoutes addresses of the target systems
+ * @param[in] ips array of numRoutes ip addresses of the target systems
+ * @param[in] lazy if set, connections are not established now but on first use of the route
+ * @param[out] results array of numRoutes [ADS Return Codes](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663), one per route
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsAddRoutes(uint32_t numRoutes, const AmsNetId* pNetIds, const char* const* ips, bool lazy, long* results);
+
+/**
+ * Add all ams routes listed in a route file. Each line contains the AmsNetId
+ * and the ip address of one target system separated by whitespace, e.g.
+ * "192.168.0.231.1.1 192.168.0.232". Empty lines and lines starting with '#'
+ * are ignored. If the file contains a malformed line no route is added.
+ * @param[in] path of the route file
+ * @param[in] lazy if set, connections are not established now but on first use of the route
+ * @param[in] pFunc optional callback invoked with the status of each route
+ * @param[in] hUser custom handle passed to pFunc
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663) of the file or the first failed route
+ */
+long AdsLoadRoutes(const char* path, bool lazy, PAdsRouteStatusFunc pFunc, uint32_t hUser);
+
 /**
  * Delete ams route that had previously been added with AdsAddRoute().
+ * Notifications of the target system are deleted on all ports, with one
+ * ADSIGRP_SUMUP_DELDEVNOTE request per 500 handles.
  * @param[in] ams address of the target system
  */
 void AdsDelRoute(AmsNetId ams);
@@ -42,8 +124,11 @@ void AdsDelRoute(AmsNetId ams);
 /**
  * The connection (communication port) to the message router is
  * closed. The port to be closed must previously have been opened via
- * an AdsPortOpenEx() call.
- * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * an AdsPortOpenEx() call. Remaining notifications are deleted in
+ * batches per device. Devices, which are not connected or time out, are
+ * not asked again.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx(),
+ * or ADSPORT_AUTO, which fails with ADSERR_CLIENT_PORTNOTOPEN if the calling thread hasn't used its port.
  * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
  */
 long AdsPortCloseEx(long port);
@@ -143,6 +228,179 @@ long AdsSyncWriteReqEx(long           port,
                        uint32_t       bufferLength,
                        const void*    buffer);
 
+/**
+ * Writes data synchronously to an ADS server and reads the same location back within a single round trip.
+ * Both operations are combined into one ADSIGRP_SUMUP_READWRITE request. The write is issued first,
+ * the read back is executed by the ADS server right after it.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data, in bytes, send to the ADS server.
+ * @param[in] buffer Buffer with data send to the ADS server.
+ * @param[out] readBack Buffer of at least bufferLength bytes, which receives the data read back from the ADS server.
+ * @param[out] mismatch set to true if the data read back differs from buffer
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncWriteVerifyReqEx(long           port,
+                             const AmsAddr* pAddr,
+                             uint32_t       indexGroup,
+                             uint32_t       indexOffset,
+                             uint32_t       bufferLength,
+                             const void*    buffer,
+                             void*          readBack,
+                             bool*          mismatch);
+
+/**
+ * Reads many single bits of the process image with as few round trips as possible.
+ * The bytes containing the requested bits are merged into ranges, which are read with
+ * ADSIGRP_SUMUP_READ requests from the byte addressed group (ADSIGRP_IOIMAGE_RWIB/RWOB).
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup ADSIGRP_IOIMAGE_RWIX for inputs or ADSIGRP_IOIMAGE_RWOX for outputs
+ * @param[in] numBits number of entries in bitAddresses
+ * @param[in] bitAddresses bit addresses in the image, byte offset * 8 + bit number
+ * @param[out] values buffer of at least (numBits + 7) / 8 bytes, which receives the value of
+ *             bitAddresses[i] in bit (i % 8) of byte (i / 8)
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncReadBitsReqEx(long            port,
+                          const AmsAddr*  pAddr,
+                          uint32_t        indexGroup,
+                          uint32_t        numBits,
+                          const uint32_t* bitAddresses,
+                          uint8_t*        values);
+
+/**
+ * Writes many single bits of the process image with a masked read-modify-write.
+ * The bytes containing the bits are read with ADSIGRP_SUMUP_READ, only the addressed bits
+ * are changed and the bytes are written back with ADSIGRP_SUMUP_WRITE. Other bits of these
+ * bytes keep their value, unless another client changes them between the read and the write.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup ADSIGRP_IOIMAGE_RWOX for outputs or ADSIGRP_IOIMAGE_RWIX for inputs
+ * @param[in] numBits number of entries in bitAddresses
+ * @param[in] bitAddresses bit addresses in the image, byte offset * 8 + bit number
+ * @param[in] values packed like the values of AdsSyncReadBitsReqEx()
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncWriteBitsReqEx(long            port,
+                           const AmsAddr*  pAddr,
+                           uint32_t        indexGroup,
+                           uint32_t        numBits,
+                           const uint32_t* bitAddresses,
+                           const uint8_t*  values);
+
+/**
+ * Opens a file through the system service of a TwinCAT device.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] path null terminated name of the file
+ * @param[in] flags combination of one FOPEN_PATH_* and the FOPEN_* mode flags
+ * @param[out] hFile handle of the opened file
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileOpenEx(long port, const AmsAddr* pAddr, const char* path, uint32_t flags, uint32_t* hFile);
+
+/**
+ * Closes a file opened with AdsFileOpenEx().
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] hFile handle returned by AdsFileOpenEx()
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileCloseEx(long port, const AmsAddr* pAddr, uint32_t hFile);
+
+/**
+ * Reads from the current position of a file. The data is split into chunks, which fit into one
+ * response frame. A window of chunk requests is kept in flight, each on a temporary local port
+ * of its own, and the chunks are copied straight into buffer, which may be a memory mapped file.
+ * The system service executes the requests in the order they were sent.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx(),
+ *            its timeout applies to every chunk.
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] hFile handle returned by AdsFileOpenEx()
+ * @param[in] length number of bytes to read
+ * @param[out] buffer of at least length bytes
+ * @param[out] bytesRead number of bytes read, less than length at the end of the file
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileReadEx(long port, const AmsAddr* pAddr, uint32_t hFile, uint32_t length, void* buffer,
+                   uint32_t* bytesRead);
+
+/**
+ * Writes at the current position of a file, with a window of chunk requests in flight like AdsFileReadEx().
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx(),
+ *            its timeout applies to every chunk.
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] hFile handle returned by AdsFileOpenEx()
+ * @param[in] length number of bytes to write
+ * @param[in] buffer data to write
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileWriteEx(long port, const AmsAddr* pAddr, uint32_t hFile, uint32_t length, const void* buffer);
+
+/**
+ * Copies a file from a TwinCAT device to a local file, see AdsFileReadEx().
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] path null terminated name of the file on the device
+ * @param[in] flags one of the FOPEN_PATH_* flags
+ * @param[in] localPath null terminated name of the local file, which is overwritten
+ * @param[out] bytesCopied optional, receives the size of the file
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileDownloadEx(long           port,
+                       const AmsAddr* pAddr,
+                       const char*    path,
+                       uint32_t       flags,
+                       const char*    localPath,
+                       uint64_t*      bytesCopied);
+
+/**
+ * Copies a local file to a TwinCAT device, see AdsFileWriteEx().
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] localPath null terminated name of the local file
+ * @param[in] path null terminated name of the file on the device, which is overwritten
+ * @param[in] flags one of the FOPEN_PATH_* flags
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileUploadEx(long port, const AmsAddr* pAddr, const char* localPath, const char* path, uint32_t flags);
+
+/**
+ * A file or directory found by AdsFileFindEx()
+ */
+struct AdsFileEntry {
+    char name[260];
+    uint64_t size;
+    uint32_t attributes;    /**< FILE_ATTRIBUTE_* flags as defined by Windows, 0x10 for directories */
+    uint64_t lastWriteTime; /**< FILETIME, in 100ns since 1601-01-01 */
+};
+
+/**
+ * @param[in] entry valid only during the callback
+ * @param[in] hUser as passed to AdsFileFindEx()
+ */
+typedef void (* PAdsFileEntryFunc)(const AdsFileEntry* entry, uint32_t hUser);
+
+/**
+ * Lists the files and directories on a TwinCAT device, which match a pattern like "C:\\TwinCAT\\*.log".
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr NetId of the device and AMSPORT_R3_SYSSERV
+ * @param[in] pattern null terminated path, the last component may contain wildcards
+ * @param[in] flags one of the FOPEN_PATH_* flags
+ * @param[in] pFunc called for every entry found
+ * @param[in] hUser passed to pFunc
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsFileFindEx(long              port,
+                   const AmsAddr*    pAddr,
+                   const char*       pattern,
+                   uint32_t          flags,
+                   PAdsFileEntryFunc pFunc,
+                   uint32_t          hUser);
+
 /**
  * Changes the ADS status and the device status of an ADS server.
  * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
@@ -208,4 +466,358 @@ long AdsSyncGetTimeoutEx(long port, uint32_t* timeout);
  */
 long AdsSyncSetTimeoutEx(long port, uint32_t timeout);
 
+/**
+ * Reads data synchronously from a list of ADS servers. The requests are pipelined, so
+ * the targets are processed concurrently without spawning a thread per target.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] numTargets Number of ADS servers in pAddrs.
+ * @param[in] pAddrs Array of structures with NetId and port number of the ADS servers.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data in bytes, read from each ADS server.
+ * @param[out] buffers Pointer to a data buffer of numTargets * bufferLength bytes. The data of pAddrs[i] is stored at offset i * bufferLength.
+ * @param[out] bytesRead optional array of numTargets variables, which receive the number of bytes actually read from each ADS server.
+ * @param[out] results array of numTargets variables, which receive the ADS Return Code for each ADS server.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncReadReqMulti(long           port,
+                         uint32_t       numTargets,
+                         const AmsAddr* pAddrs,
+                         uint32_t       indexGroup,
+                         uint32_t       indexOffset,
+                         uint32_t       bufferLength,
+                         void*          buffers,
+                         uint32_t*      bytesRead,
+                         long*          results);
+
+/**
+ * Reads the identification and version number of a list of ADS servers. The requests are pipelined.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] numTargets Number of ADS servers in pAddrs.
+ * @param[in] pAddrs Array of structures with NetId and port number of the ADS servers.
+ * @param[out] devNames Pointer to numTargets * 16 characters. The name of pAddrs[i] is stored at offset i * 16.
+ * @param[out] versions array of numTargets variables of type AdsVersion.
+ * @param[out] results array of numTargets variables, which receive the ADS Return Code for each ADS server.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncReadDeviceInfoReqMulti(long           port,
+                                   uint32_t       numTargets,
+                                   const AmsAddr* pAddrs,
+                                   char*          devNames,
+                                   AdsVersion*    versions,
+                                   long*          results);
+
+/**
+ * Reads the ADS status and the device status of a list of ADS servers. The requests are pipelined.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] numTargets Number of ADS servers in pAddrs.
+ * @param[in] pAddrs Array of structures with NetId and port number of the ADS servers.
+ * @param[out] adsStates array of numTargets variables, which receive the ADS status.
+ * @param[out] devStates array of numTargets variables, which receive the device status.
+ * @param[out] results array of numTargets variables, which receive the ADS Return Code for each ADS server.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncReadStateReqMulti(long           port,
+                              uint32_t       numTargets,
+                              const AmsAddr* pAddrs,
+                              uint16_t*      adsStates,
+                              uint16_t*      devStates,
+                              long*          results);
+
+/**
+ * Writes the same data synchronously into a list of ADS servers and receives data back from each of them.
+ * Use indexGroup ADSIGRP_SYM_VALBYNAME and the symbol name as writeData to read a symbol from all targets.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] numTargets Number of ADS servers in pAddrs.
+ * @param[in] pAddrs Array of structures with NetId and port number of the ADS servers.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] readLength Length, in bytes, of the data read from each ADS server.
+ * @param[out] readData Buffer of numTargets * readLength bytes. The data of pAddrs[i] is stored at offset i * readLength.
+ * @param[in] writeLength Length of the data, in bytes, send to each ADS server.
+ * @param[in] writeData Buffer with data send to the ADS servers.
+ * @param[out] bytesRead optional array of numTargets variables, which receive the number of bytes actually read from each ADS server.
+ * @param[out] results array of numTargets variables, which receive the ADS Return Code for each ADS server.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncReadWriteReqMulti(long           port,
+                              uint32_t       numTargets,
+                              const AmsAddr* pAddrs,
+                              uint32_t       indexGroup,
+                              uint32_t       indexOffset,
+                              uint32_t       readLength,
+                              void*          readData,
+                              uint32_t       writeLength,
+                              const void*    writeData,
+                              uint32_t*      bytesRead,
+                              long*          results);
+
+/**
+ * Writes the same data synchronously to a list of ADS servers. The requests are pipelined.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] numTargets Number of ADS servers in pAddrs.
+ * @param[in] pAddrs Array of structures with NetId and port number of the ADS servers.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data, in bytes, send to each ADS server.
+ * @param[in] buffer Buffer with data send to the ADS servers.
+ * @param[out] results array of numTargets variables, which receive the ADS Return Code for each ADS server.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsSyncWriteReqMulti(long           port,
+                          uint32_t       numTargets,
+                          const AmsAddr* pAddrs,
+                          uint32_t       indexGroup,
+                          uint32_t       indexOffset,
+                          uint32_t       bufferLength,
+                          const void*    buffer,
+                          long*          results);
+
+/**
+ * Stages of a synchronous request, measured by the request timeline
+ */
+enum AdsRequestStage {
+    ADS_STAGE_QUEUE,  /**< from the API call until a response slot was reserved (router lookup, locks) */
+    ADS_STAGE_SEND,   /**< writing the request to the socket */
+    ADS_STAGE_WIRE,   /**< until the response header arrived (network and ADS server) */
+    ADS_STAGE_PARSE,  /**< receiving and matching the response */
+    ADS_STAGE_WAKE,   /**< until the waiting caller was woken up */
+    ADS_STAGE_COUNT
+};
+
+#define ADS_HISTOGRAM_BUCKETS 32
+
+/**
+ * Histogram of durations in ns. buckets[i] counts durations in [2^i, 2^(i+1)),
+ * buckets[0] includes 0 and the last bucket everything above.
+ */
+struct AdsHistogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[ADS_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Timestamps of a single sampled request
+ */
+struct AdsRequestTiming {
+    AmsAddr target;
+    uint16_t port;
+    uint16_t cmdId;
+    uint32_t invokeId;
+    long result;
+    uint64_t start;                    /**< monotonic time of the API call in ns */
+    uint32_t stages[ADS_STAGE_COUNT];  /**< duration of each stage in ns, 0 if not reached */
+};
+
+/**
+ * Enable the request timeline. While enabled, each synchronous request is
+ * timestamped at every stage and the durations are aggregated into one
+ * histogram per stage. Additionally every sampleInterval-th request is stored
+ * into a trace buffer of the most recent samples.
+ * @param[in] enable
+ * @param[in] sampleInterval 0 disables sampling into the trace buffer
+ */
+void AdsEnableRequestTiming(bool enable, uint32_t sampleInterval);
+
+/**
+ * Clear all histograms and the trace buffer of the request timeline.
+ */
+void AdsResetRequestTiming();
+
+/**
+ * Get the histogram of one request stage.
+ * @param[in] stage
+ * @param[out] histogram
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetRequestStageHistogram(AdsRequestStage stage, AdsHistogram* histogram);
+
+/**
+ * Copy the sampled requests, oldest first.
+ * @param[out] timings buffer for the samples
+ * @param[in,out] numTimings capacity of timings on input, number of copied samples on output
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetRequestTimeline(AdsRequestTiming* timings, uint32_t* numTimings);
+
+/**
+ * Start recording library activity into a bounded trace buffer: request spans
+ * per invokeId, connects, notification frame receipt and dispatch, callback
+ * execution and log messages. Receiver and dispatcher threads are named in the
+ * trace. A previous recording is discarded.
+ * @param[in] capacity number of events kept, 0 for the default of 65536
+ * @param[in] exitPath if not nullptr, the trace is written to this file by AdsTraceStop() or at exit
+ */
+void AdsTraceStart(uint32_t capacity, const char* exitPath);
+
+/**
+ * Stop recording. The recorded events stay available for AdsTraceDump().
+ */
+void AdsTraceStop();
+
+/**
+ * Write the recorded events in the Chrome trace event JSON format, which can be
+ * opened with chrome://tracing or ui.perfetto.dev.
+ * @param[in] path of the output file
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsTraceDump(const char* path);
+
+/**
+ * Events raised by the notification dispatchers, see AdsSetCallbackBudget()
+ */
+enum AdsDispatcherEvent {
+    ADS_EVENT_SLOW_CALLBACK,   /**< a callback exceeded the budget, value: execution time in ns */
+    ADS_EVENT_RING_HIGH_WATER, /**< receive buffer usage crossed the high-water mark, value: bytes used */
+};
+
+/**
+ * Called from the dispatcher (ADS_EVENT_SLOW_CALLBACK) or the receiver thread
+ * (ADS_EVENT_RING_HIGH_WATER), so it must not block.
+ * @param[in] pAddr the notifications originate from
+ * @param[in] port local port the notifications are delivered to
+ * @param[in] event
+ * @param[in] hNotify handle of the slow callback or of the callback running, when the
+ *            high-water mark was crossed (0 if none)
+ * @param[in] value see AdsDispatcherEvent
+ * @param[in] hUser as passed to AdsSetCallbackBudget()
+ */
+typedef void (* PAdsDispatcherEventFunc)(const AmsAddr* pAddr, uint16_t port, AdsDispatcherEvent event,
+                                         uint32_t hNotify, uint64_t value, uint32_t hUser);
+
+/**
+ * Execution time statistics of one notification callback
+ */
+struct AdsCallbackStats {
+    AmsAddr source;          /**< device the notifications originate from */
+    uint32_t hNotify;        /**< handle of the notification */
+    uint64_t numCalls;       /**< number of callback invocations */
+    uint64_t totalNs;        /**< accumulated execution time */
+    uint64_t maxNs;          /**< longest execution time */
+    uint64_t numOverBudget;  /**< invocations exceeding the budget */
+    uint32_t ringHighWater;  /**< max. bytes used in the receive buffer of the dispatcher */
+};
+
+/**
+ * Configure the slow callback detection of all notification dispatchers.
+ * @param[in] budgetUs callbacks running longer raise ADS_EVENT_SLOW_CALLBACK, 0 disables
+ * @param[in] highWaterPercent receive buffer usage raising ADS_EVENT_RING_HIGH_WATER, 0 disables.
+ *            The event is raised again after the usage dropped below half of the mark.
+ * @param[in] pFunc event callback, may be nullptr to count budget overruns only
+ * @param[in] hUser passed to pFunc
+ */
+void AdsSetCallbackBudget(uint32_t budgetUs, uint32_t highWaterPercent, PAdsDispatcherEventFunc pFunc,
+                          uint32_t hUser);
+
+/**
+ * Get the callback statistics of all notifications registered on a port,
+ * most expensive (by total execution time) first.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx or AdsPortOpen.
+ * @param[out] stats buffer for the statistics
+ * @param[in,out] numStats capacity of stats on input, number of copied statistics on output
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetCallbackStatsEx(long port, AdsCallbackStats* stats, uint32_t* numStats);
+
+/**
+ * Contention statistics of all library mutexes sharing one name
+ */
+struct AdsLockStats {
+    char name[48];          /**< e.g. "AmsRouter::mutex" */
+    uint64_t numAcquired;   /**< number of lock operations */
+    uint64_t numContended;  /**< lock operations, which had to wait */
+    uint64_t waitNs;        /**< accumulated time spent waiting for the lock */
+    uint64_t maxWaitNs;     /**< longest wait */
+    uint64_t holdNs;        /**< accumulated time the lock was held */
+    uint64_t maxHoldNs;     /**< longest hold */
+};
+
+/**
+ * Enable recording of lock contention statistics. Only available if the
+ * library was built with CONFIG_ADSLIB_LOCK_STATS (make LOCK_STATS=1).
+ * @param[in] enable
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsEnableLockStats(bool enable);
+
+/**
+ * Clear all lock contention statistics.
+ */
+void AdsResetLockStats();
+
+/**
+ * Get the lock contention statistics, ordered by name. Without CONFIG_ADSLIB_LOCK_STATS
+ * no statistics exist and numStats is set to 0.
+ * @param[out] stats buffer for the statistics
+ * @param[in,out] numStats capacity of stats on input, number of copied statistics on output
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetLockStats(AdsLockStats* stats, uint32_t* numStats);
+
+/**
+ * Receives the text rendered by AdsWriteMetrics()
+ * @param[in] text OpenMetrics text, not null terminated
+ * @param[in] length of text in bytes
+ * @param[in] hUser as passed to AdsWriteMetrics()
+ */
+typedef void (* PAdsMetricsFunc)(const char* text, uint32_t length, uint32_t hUser);
+
+/**
+ * Render the library metrics in the OpenMetrics text format, to be served by
+ * the metrics endpoint of the application. Per connection (label ip) requests,
+ * timeouts, errors, bytes, notification frames and drops and the round trip
+ * time histogram are exposed, per local port (label port) request counters and
+ * per notification dispatcher (labels port, source) the receive buffer usage.
+ * ads_route_info maps AmsNetIds to the ip of their connection.
+ * @param[out] buffer for the null terminated text
+ * @param[in] bufferLength size of buffer in bytes
+ * @param[out] bytesWritten length of the text without the terminating null. If buffer is too small,
+ *             ADSERR_DEVICE_INVALIDSIZE is returned and bytesWritten is set to the required length.
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetMetrics(char* buffer, uint32_t bufferLength, uint32_t* bytesWritten);
+
+/**
+ * Render the library metrics like AdsGetMetrics() and pass the text to pFunc.
+ * @param[in] pFunc receives the text
+ * @param[in] hUser passed to pFunc
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsWriteMetrics(PAdsMetricsFunc pFunc, uint32_t hUser);
+
+/**
+ * Categories of memory allocated by the library
+ */
+enum AdsMemoryCategory {
+    ADS_MEM_NOTIFICATION_RING,    /**< receive buffer of each notification dispatcher (local port, source) */
+    ADS_MEM_RESPONSE_FRAMES,      /**< response buffers of each connection */
+    ADS_MEM_REQUEST_FRAMES,       /**< requests in flight, global only */
+    ADS_MEM_NOTIFICATION_BUFFERS, /**< sample buffer of each registered notification */
+    ADS_MEM_RECEIVE_BUFFER,       /**< socket receive buffer of each connection in polling mode */
+    ADS_MEM_COUNT
+};
+
+struct AdsMemoryUsage {
+    uint64_t bytes[ADS_MEM_COUNT]; /**< bytes allocated per AdsMemoryCategory */
+    uint64_t total;                /**< sum of all categories */
+    uint64_t budget;               /**< as set with AdsSetMemoryBudget(), 0 if unlimited */
+};
+
+/**
+ * Get the memory allocated by the library.
+ * @param[in] pNetId AmsNetId of a route to get the memory attributed to its connection, nullptr for the total
+ * @param[out] usage
+ * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+ */
+long AdsGetMemoryUsage(const AmsNetId* pNetId, AdsMemoryUsage* usage);
+
+/**
+ * Limit the memory the library may allocate. New connections and new
+ * notification receive buffers are refused with GLOBALERR_NO_MEMORY, if they
+ * would exceed the budget. Allocations of existing connections are not limited.
+ * @param[in] bytes budget, 0 for unlimited (default)
+ */
+void AdsSetMemoryBudget(uint64_t bytes);
+
 #endif /* #ifndef _ADSLIB_H_ */
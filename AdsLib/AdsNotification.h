@@ -26,12 +26,37 @@
 #include "AdsDef.h"
 #include "RingBuffer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <utility>
 
 using VirtualConnection = std::pair<uint16_t, AmsAddr>;
 
+/**
+ * Execution time statistics of a callback. Add() is serialized by the mutex of the
+ * dispatcher, readers don't take it, as it is held while callbacks run.
+ */
+struct CallbackCost {
+    std::atomic<uint64_t> numCalls {0};
+    std::atomic<uint64_t> total {0};
+    std::atomic<uint64_t> max {0};
+    std::atomic<uint64_t> numOverBudget {0};
+
+    void Add(uint64_t duration, bool overBudget)
+    {
+        ++numCalls;
+        total += duration;
+        if (duration > max) {
+            max = duration;
+        }
+        numOverBudget += overBudget;
+    }
+};
+
 struct Notification {
     const VirtualConnection connection;
+    const std::shared_ptr<CallbackCost> cost;
 
     Notification(PAdsNotificationFuncEx __func,
                  uint32_t               __hUser,
@@ -39,8 +64,9 @@ struct Notification {
                  AmsAddr                __amsAddr,
                  uint16_t               __port)
         : connection({__port, __amsAddr}),
+        cost(std::make_shared<CallbackCost>()),
         callback(__func),
-        buffer(new uint8_t[sizeof(AdsNotificationHeader) + length]),
+        buffer(new uint8_t[sizeof(AdsNotificationHeader) + length], std::default_delete<uint8_t[]>()),
         hUser(__hUser)
     {
         auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
@@ -48,15 +74,14 @@ struct Notification {
         header->cbSampleSize = length;
     }
 
-    void Notify(uint64_t timestamp, RingBuffer& ring) const
+    void Notify(uint64_t timestamp, const RingBuffer& ring, const uint8_t* sample) const
     {
         auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
-        uint8_t* data = reinterpret_cast<uint8_t*>(header + 1);
-        for (size_t i = 0; i < header->cbSampleSize; ++i) {
-            data[i] = ring.ReadFromLittleEndian<uint8_t>();
-        }
+        ring.Copy(header + 1, sample, header->cbSampleSize);
         header->nTimeStamp = timestamp;
-        callback(&connection.second, header, hUser);
+        // the callback might add notifications, which moves this object
+        const auto source = connection.second;
+        callback(&source, header, hUser);
     }
 
     uint32_t Size() const
@@ -65,6 +90,11 @@ struct Notification {
         return header->cbSampleSize;
     }
 
+    size_t BufferSize() const
+    {
+        return sizeof(AdsNotificationHeader) + Size();
+    }
+
     void hNotify(uint32_t value)
     {
         auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
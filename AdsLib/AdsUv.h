@@ -0,0 +1,144 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _ADS_UV_H_
+#define _ADS_UV_H_
+
+#include "AdsLib.h"
+
+#include <uv.h>
+#include <vector>
+
+/**
+ * Runs the polling mode of the library on a libuv loop, so the library creates
+ * no threads of its own. The sockets of all connections are watched with
+ * uv_poll_t handles, responses and notifications are processed by the thread
+ * running the loop and notification callbacks are invoked from that thread.
+ *
+ * Requests stay synchronous. Issue them from the thread running the loop, while
+ * one waits for its response it processes other events inline.
+ *
+ * Start() has to be called before the first route is added. The object must
+ * not be destroyed from within a notification callback. POSIX only, like the
+ * polling mode.
+ */
+struct AdsUvLoop {
+    AdsUvLoop(uv_loop_t* __loop)
+        : loop(__loop)
+    {}
+
+    ~AdsUvLoop()
+    {
+        Stop();
+    }
+
+    AdsUvLoop(const AdsUvLoop&) = delete;
+    AdsUvLoop& operator=(const AdsUvLoop&) = delete;
+
+    /**
+     * Enable the polling mode and watch its file descriptors
+     * @return [ADS Return Code](http://infosys.beckhoff.de/content/1033/tc3_adsdll2/html/ads_returncodes.htm?id=17663)
+     */
+    long Start()
+    {
+        const auto status = AdsSetPollingMode(true);
+        return status ? status : Watch();
+    }
+
+    /**
+     * Stop watching, the handles are released by the next iteration of the loop
+     */
+    void Stop()
+    {
+        for (auto watcher : watchers) {
+            watcher->owner = nullptr;
+            uv_poll_stop(&watcher->handle);
+            uv_close(reinterpret_cast<uv_handle_t*>(&watcher->handle), &AdsUvLoop::OnClose);
+        }
+        watchers.clear();
+    }
+
+private:
+    struct Watcher {
+        uv_poll_t handle;
+        AdsUvLoop* owner;
+        bool isWakeup;
+    };
+
+    uv_loop_t* const loop;
+    std::vector<Watcher*> watchers;
+
+    /**
+     * Watch the current set of file descriptors. The last one signals changes of
+     * the set, in which case all handles are replaced, as a closed socket might
+     * have been reopened with the same number.
+     */
+    long Watch()
+    {
+        std::vector<int> fds(8);
+        auto numFds = static_cast<uint32_t>(fds.size());
+        auto status = AdsGetPollFds(fds.data(), &numFds);
+        if (ADSERR_DEVICE_INVALIDSIZE == status) {
+            fds.resize(numFds);
+            status = AdsGetPollFds(fds.data(), &numFds);
+        }
+        if (status) {
+            return status;
+        }
+
+        Stop();
+        for (uint32_t i = 0; i < numFds; ++i) {
+            const auto watcher = new Watcher {};
+            watcher->owner = this;
+            watcher->isWakeup = (i + 1 == numFds);
+            watcher->handle.data = watcher;
+            if (uv_poll_init(loop, &watcher->handle, fds[i])) {
+                delete watcher;
+                Stop();
+                return ADSERR_DEVICE_ERROR;
+            }
+            watchers.push_back(watcher);
+            uv_poll_start(&watcher->handle, UV_READABLE, &AdsUvLoop::OnReadable);
+        }
+        return 0;
+    }
+
+    static void OnReadable(uv_poll_t* handle, int status, int)
+    {
+        const auto watcher = static_cast<Watcher*>(handle->data);
+        if ((status < 0) || !watcher->owner) {
+            return;
+        }
+        AdsProcessEvents();
+        // a callback might have stopped the loop
+        if (watcher->isWakeup && watcher->owner) {
+            watcher->owner->Watch();
+        }
+    }
+
+    static void OnClose(uv_handle_t* handle)
+    {
+        delete static_cast<Watcher*>(handle->data);
+    }
+};
+
+#endif /* #ifndef _ADS_UV_H_ */
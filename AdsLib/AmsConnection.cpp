@@ -22,9 +22,34 @@
 
 #include "AmsConnection.h"
 #include "Log.h"
+#include "Probes.h"
+
+static const char* CommandName(uint16_t cmdId)
+{
+    static const char* const NAMES[] = {
+        "Invalid",
+        "ReadDeviceInfo",
+        "Read",
+        "Write",
+        "ReadState",
+        "WriteControl",
+        "AddDeviceNotification",
+        "DelDeviceNotification",
+        "DeviceNotification",
+        "ReadWrite",
+    };
+    return (cmdId < sizeof(NAMES) / sizeof(NAMES[0])) ? NAMES[cmdId] : "Unknown";
+}
+
+static std::string ToString(const IpV4& ip)
+{
+    std::stringstream stream;
+    stream << ip;
+    return stream.str();
+}
 
 AmsResponse::AmsResponse()
-    : frame(4096),
+    : frame(FRAME_SIZE),
     invokeId(0),
     errorCode(0)
 {}
@@ -37,7 +62,7 @@ void AmsResponse::Notify()
 
 bool AmsResponse::Wait(uint32_t timeout_ms)
 {
-    std::unique_lock<std::mutex> lock(mutex);
+    std::unique_lock<SignalMutex> lock(mutex);
     return cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
         return !invokeId;
     });
@@ -49,14 +74,15 @@ std::shared_ptr<NotificationDispatcher> AmsConnection::DispatcherListAdd(const V
     if (dispatcher) {
         return dispatcher;
     }
-    std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
+    std::lock_guard<RecursiveMutex> lock(dispatcherListMutex);
     return dispatcherList.emplace(connection,
-                                  std::make_shared<NotificationDispatcher>(*this, connection)).first->second;
+                                  std::make_shared<NotificationDispatcher>(*this, connection, memory,
+                                                                           !polling)).first->second;
 }
 
 std::shared_ptr<NotificationDispatcher> AmsConnection::DispatcherListGet(const VirtualConnection& connection)
 {
-    std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
+    std::lock_guard<RecursiveMutex> lock(dispatcherListMutex);
 
     const auto it = dispatcherList.find(connection);
     if (it != dispatcherList.end()) {
@@ -65,21 +91,248 @@ std::shared_ptr<NotificationDispatcher> AmsConnection::DispatcherListGet(const V
     return std::shared_ptr<NotificationDispatcher>();
 }
 
-AmsConnection::AmsConnection(Router& __router, IpV4 __destIp)
+AmsConnection::AmsConnection(Router& __router, IpV4 __destIp, bool __polling)
     : router(__router),
-    socket(__destIp, ADS_TCP_SERVER_PORT),
+    closedIdle(false),
     refCount(0),
+    memory(std::make_shared<MemoryUsage>(&GetMemoryUsage())),
     invokeId(0),
+    polling(__polling),
+    rxPos(nullptr),
+    rxEnd(nullptr),
+    rxAccounted(0),
     destIp(__destIp),
-    ownIp(socket.Connect())
+    ownIp(0)
 {
-    receiver = std::thread(&AmsConnection::TryRecv, this);
+    for (const auto& response : queue) {
+        memory->Add(ADS_MEM_RESPONSE_FRAMES, response.frame.capacity());
+    }
 }
 
 AmsConnection::~AmsConnection()
 {
-    socket.Shutdown();
-    receiver.join();
+    if (socket) {
+        socket->Shutdown();
+    }
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+}
+
+uint32_t AmsConnection::Connect()
+{
+    std::lock_guard<Mutex> lock(socketMutex);
+    if (ownIp) {
+        return ownIp;
+    }
+
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+    const auto begin = GetTracer().Begin();
+    const bool reconnect = (lastUse != std::chrono::steady_clock::time_point {});
+    socket.reset(new TcpSocket {destIp, ADS_TCP_SERVER_PORT});
+    ownIp = socket->Connect();
+    closedIdle = false;
+    if (begin) {
+        GetTracer().Complete("connection", reconnect ? "reconnect" : "connect", begin, 0,
+                             ownIp ? 0 : GLOBALERR_MISSING_ROUTE, ToString(destIp));
+    }
+    if (ownIp) {
+        ++metrics.numConnects;
+        lastUse = std::chrono::steady_clock::now();
+        if (!polling) {
+            receiver = std::thread(&AmsConnection::TryRecv, this);
+        }
+    }
+    return ownIp;
+}
+
+bool AmsConnection::CloseIfIdle(std::chrono::milliseconds timeout)
+{
+    std::lock_guard<Mutex> lock(socketMutex);
+    if (!ownIp || (std::chrono::steady_clock::now() - lastUse < timeout)) {
+        return false;
+    }
+
+    for (const auto& response : queue) {
+        if (response.invokeId) {
+            return false;
+        }
+    }
+
+    {
+        std::lock_guard<RecursiveMutex> dispatcherLock(dispatcherListMutex);
+        for (const auto& d : dispatcherList) {
+            if (!d.second->IsEmpty()) {
+                return false;
+            }
+        }
+    }
+
+    LOG_INFO("Closing idle connection");
+    ownIp = 0;
+    closedIdle = true;
+    socket->Shutdown();
+    if (polling) {
+        socket.reset();
+        ReleaseRxBuffer();
+    }
+    return true;
+}
+
+void AmsConnection::Disconnect()
+{
+    {
+        std::lock_guard<Mutex> lock(socketMutex);
+        ownIp = 0;
+        socket.reset();
+        ReleaseRxBuffer();
+    }
+    router.PollFdsChanged();
+}
+
+void AmsConnection::ReleaseRxBuffer()
+{
+    std::vector<uint8_t>().swap(rxBuffer);
+    memory->Update(ADS_MEM_RECEIVE_BUFFER, rxAccounted, 0);
+}
+
+bool AmsConnection::NotificationFitsBudget(const VirtualConnection& connection)
+{
+    return DispatcherListGet(connection) || MemoryBudgetFits(NotificationDispatcher::RING_SIZE);
+}
+
+void AmsConnection::CollectMetrics(MetricsWriter& writer)
+{
+    const auto labels = "ip=\"" + ToString(destIp) + '"';
+    writer.AddGauge("ads_connected", "Connection to the target is established", labels, !!ownIp);
+    writer.AddCounter("ads_connects", "Successful connects including reconnects", labels, metrics.numConnects);
+    writer.AddCounter("ads_requests", "Requests sent", labels, metrics.numRequests);
+    writer.AddCounter("ads_request_timeouts", "Requests without response in time", labels, metrics.numTimeouts);
+    writer.AddCounter("ads_request_errors", "Responses with an error code", labels, metrics.numErrors);
+    writer.AddCounter("ads_sent_bytes", "Bytes sent", labels, metrics.bytesSent);
+    writer.AddCounter("ads_received_bytes", "Bytes received", labels, metrics.bytesReceived);
+    writer.AddCounter("ads_notification_frames", "Notification frames received", labels,
+                      metrics.numNotificationFrames);
+    writer.AddCounter("ads_notification_drops", "Notification frames dropped", labels, metrics.numNotificationDrops);
+
+    AdsHistogram rtt;
+    metrics.rtt.Get(rtt);
+    writer.AddHistogram("ads_request_rtt_seconds", "Time from sending a request until its response was handed over",
+                        labels, rtt);
+
+    AdsMemoryUsage usage;
+    memory->Get(usage);
+    for (size_t i = 0; i < ADS_MEM_COUNT; ++i) {
+        const auto category = static_cast<AdsMemoryCategory>(i);
+        writer.AddGauge("ads_connection_memory_bytes", "Memory attributed to the connection",
+                        labels + ",category=\"" + MemoryUsage::Name(category) + '"', usage.bytes[i]);
+    }
+
+    std::lock_guard<RecursiveMutex> lock(dispatcherListMutex);
+    for (const auto& d : dispatcherList) {
+        d.second->CollectMetrics(writer);
+    }
+}
+
+void AmsConnection::Record(const AmsRequest& request, long result, const RequestTimestamps& timestamps,
+                           uint64_t woken)
+{
+    GetRequestTimeline().Record(request.destAddr, request.port, request.cmdId, result, request.start, timestamps,
+                                woken);
+
+    auto& tracer = GetTracer();
+    if (tracer.enabled) {
+        std::stringstream target;
+        target << request.destAddr.netId << ':' << std::dec << request.destAddr.port;
+        const auto end = woken ? woken : RequestTimeline::Now();
+        tracer.Complete("request", CommandName(request.cmdId), request.start, end, timestamps.invokeId, result,
+                        target.str());
+        if (timestamps.received) {
+            tracer.Complete("request", "wire", timestamps.sent, timestamps.received, timestamps.invokeId, 0, {});
+        }
+    }
+}
+
+bool AmsConnection::Poll(timeval* timeout)
+{
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static const size_t NUM_READS_MAX = 16;
+    static const size_t FRAME_SIZE_MAX = 16 * 1024 * 1024;
+
+    if (!ownIp) {
+        return false;
+    }
+
+    std::vector<uint8_t> frames;
+    const auto outerPos = rxPos;
+    const auto outerEnd = rxEnd;
+    try {
+        timeval noWait {0, 0};
+        for (size_t i = 0; i < NUM_READS_MAX; ++i) {
+            const auto offset = rxBuffer.size();
+            rxBuffer.resize(offset + CHUNK_SIZE);
+            const auto bytesRead = socket->read(rxBuffer.data() + offset, CHUNK_SIZE, timeout);
+            rxBuffer.resize(offset + bytesRead);
+            if (!bytesRead) {
+                break;
+            }
+            timeout = &noWait;
+        }
+
+        size_t complete = 0;
+        while (rxBuffer.size() - complete >= sizeof(AmsTcpHeader)) {
+            const auto length = AmsTcpHeader {rxBuffer.data() + complete}.length();
+            if (length > FRAME_SIZE_MAX) {
+                throw std::runtime_error("frame too large");
+            }
+            if (rxBuffer.size() - complete < sizeof(AmsTcpHeader) + length) {
+                break;
+            }
+            complete += sizeof(AmsTcpHeader) + length;
+        }
+
+        // move complete frames out of rxBuffer, as callbacks might poll recursively
+        frames.assign(rxBuffer.begin(), rxBuffer.begin() + complete);
+        rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + complete);
+        memory->Update(ADS_MEM_RECEIVE_BUFFER, rxAccounted, rxBuffer.capacity());
+        for (const uint8_t* frame = frames.data(); frame < frames.data() + frames.size(); frame = rxEnd) {
+            rxPos = frame;
+            rxEnd = frame + sizeof(AmsTcpHeader) + AmsTcpHeader {frame}.length();
+            ProcessFrame();
+        }
+    } catch (const std::runtime_error& e) {
+        LOG_INFO(e.what());
+        rxPos = outerPos;
+        rxEnd = outerEnd;
+        Disconnect();
+        return false;
+    }
+    rxPos = outerPos;
+    rxEnd = outerEnd;
+    return true;
+}
+
+bool AmsConnection::Wait(AmsResponse* response, uint32_t tmms)
+{
+    if (!polling) {
+        return response->Wait(tmms);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(tmms);
+    while (response->invokeId) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return false;
+        }
+        const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+        timeval timeout { static_cast<long>(remaining / 1000000), static_cast<long>(remaining % 1000000) };
+        if (!Poll(&timeout)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 NotifyMapping AmsConnection::CreateNotifyMapping(uint32_t hNotify, Notification& notification)
@@ -103,6 +356,48 @@ long AmsConnection::DeleteNotification(const AmsAddr& amsAddr, uint32_t hNotify,
     return AdsRequest<AoEResponseHeader>(request, tmms);
 }
 
+long AmsConnection::DeleteNotifications(const AmsAddr& amsAddr, const std::vector<uint32_t>& handles, uint32_t tmms,
+                                        uint16_t port)
+{
+    static const size_t SUMUP_DELDEVNOTE_MAX = 500;
+
+    if (!ownIp) {
+        return 0;
+    }
+
+    for (size_t first = 0; first < handles.size(); first += SUMUP_DELDEVNOTE_MAX) {
+        const auto count = static_cast<uint32_t>(std::min(handles.size() - first, SUMUP_DELDEVNOTE_MAX));
+        const uint32_t length = count * sizeof(uint32_t);
+        std::vector<uint8_t> results(length);
+        uint32_t bytesRead = 0;
+        AmsRequest request {
+            amsAddr,
+            port, AoEHeader::READ_WRITE,
+            length, results.data(), &bytesRead,
+            sizeof(AoEReadWriteReqHeader) + length
+        };
+        for (auto i = first + count; i > first; ) {
+            --i;
+            request.frame.prepend(qToLittleEndian(handles[i]));
+        }
+        request.frame.prepend(AoEReadWriteReqHeader {ADSIGRP_SUMUP_DELDEVNOTE, count, length, length});
+
+        auto status = AdsRequest<AoEReadResponseHeader>(request, tmms);
+        if ((ADSERR_DEVICE_SRVNOTSUPP == status) || (ADSERR_DEVICE_INVALIDGRP == status)) {
+            status = 0;
+            for (auto i = first; !status && (i < first + count); ++i) {
+                const auto result = DeleteNotification(amsAddr, handles[i], tmms, port);
+                status = (ADSERR_CLIENT_SYNCTIMEOUT == result) ? result : 0;
+            }
+        }
+        if (ADSERR_CLIENT_SYNCTIMEOUT == status) {
+            LOG_WARN("Releasing " << std::dec << handles.size() - first << " notifications without response");
+            return status;
+        }
+    }
+    return 0;
+}
+
 AmsResponse* AmsConnection::Write(Frame& request, const AmsAddr destAddr, const AmsAddr srcAddr, uint16_t cmdId)
 {
     AoEHeader aoeHeader { destAddr.netId, destAddr.port, srcAddr.netId, srcAddr.port, cmdId,
@@ -112,16 +407,44 @@ AmsResponse* AmsConnection::Write(Frame& request, const AmsAddr destAddr, const
     AmsTcpHeader header { static_cast<uint32_t>(request.size()) };
     request.prepend<AmsTcpHeader>(header);
 
+    std::unique_lock<Mutex> lock(socketMutex);
+    if (!ownIp && closedIdle) {
+        // the caller connected, but the idle timeout closed the connection since then
+        lock.unlock();
+        if (Connect()) {
+            router.PollFdsChanged();
+        }
+        lock.lock();
+    }
+    if (!ownIp) {
+        return nullptr;
+    }
+    lastUse = std::chrono::steady_clock::now();
+
     auto response = Reserve(aoeHeader.invokeId(), srcAddr.port);
 
     if (!response) {
         return nullptr;
     }
 
-    if (request.size() != socket.write(request)) {
+    const bool timed = !!RequestTimestamp();
+    response->timestamps = RequestTimestamps {};
+    response->timestamps.invokeId = aoeHeader.invokeId();
+    response->timestamps.reserved = RequestTimeline::Now();
+
+    ADS_PROBE4(write_begin, aoeHeader.invokeId(), srcAddr.port, request.size(), cmdId);
+    const auto bytesWritten = socket->write(request);
+    ADS_PROBE4(write_end, aoeHeader.invokeId(), srcAddr.port, bytesWritten, cmdId);
+    if (request.size() != bytesWritten) {
         Release(response);
         return nullptr;
     }
+
+    if (timed) {
+        response->timestamps.sent = RequestTimeline::Now();
+    }
+    ++metrics.numRequests;
+    metrics.bytesSent += bytesWritten;
     return response;
 }
 
@@ -166,17 +489,26 @@ void AmsConnection::Release(AmsResponse* response)
     response->invokeId = 0;
 }
 
-void AmsConnection::Receive(void* buffer, size_t bytesToRead) const
+void AmsConnection::Receive(void* buffer, size_t bytesToRead)
 {
+    if (polling) {
+        if (bytesToRead > static_cast<size_t>(rxEnd - rxPos)) {
+            throw std::runtime_error("frame corrupted");
+        }
+        memcpy(buffer, rxPos, bytesToRead);
+        rxPos += bytesToRead;
+        return;
+    }
+
     auto pos = reinterpret_cast<uint8_t*>(buffer);
     while (bytesToRead) {
-        const size_t bytesRead = socket.read(pos, bytesToRead, nullptr);
+        const size_t bytesRead = socket->read(pos, bytesToRead, nullptr);
         bytesToRead -= bytesRead;
         pos += bytesRead;
     }
 }
 
-void AmsConnection::ReceiveJunk(size_t bytesToRead) const
+void AmsConnection::ReceiveJunk(size_t bytesToRead)
 {
     uint8_t buffer[1024];
     while (bytesToRead > sizeof(buffer)) {
@@ -186,7 +518,7 @@ void AmsConnection::ReceiveJunk(size_t bytesToRead) const
     Receive(buffer, bytesToRead);
 }
 
-Frame& AmsConnection::ReceiveFrame(Frame& frame, size_t bytesLeft) const
+Frame& AmsConnection::ReceiveFrame(Frame& frame, size_t bytesLeft)
 {
     if (bytesLeft > frame.capacity()) {
         LOG_WARN("Frame to long: " << std::dec << bytesLeft << '<' << frame.capacity());
@@ -199,87 +531,119 @@ Frame& AmsConnection::ReceiveFrame(Frame& frame, size_t bytesLeft) const
 
 bool AmsConnection::ReceiveNotification(const AoEHeader& header)
 {
+    const auto begin = GetTracer().Begin();
     const auto dispatcher = DispatcherListGet(VirtualConnection { header.targetPort(), header.sourceAms() });
     if (!dispatcher) {
         ReceiveJunk(header.length());
+        ++metrics.numNotificationDrops;
         LOG_WARN("No dispatcher found for notification");
         return false;
     }
 
     auto& ring = dispatcher->ring;
-    auto bytesLeft = header.length();
-    if (bytesLeft > ring.BytesFree()) {
-        ReceiveJunk(bytesLeft);
+    const auto length = header.length();
+    if (!ring.RecordFits(length)) {
+        ADS_PROBE3(notification_overflow, header.targetPort(), length, ring.BytesFree());
+        ReceiveJunk(length);
+        ++metrics.numNotificationDrops;
         LOG_WARN("port " << std::dec << header.targetPort() << " receive buffer was full");
         return false;
     }
 
-    auto chunk = ring.WriteChunk();
-    while (bytesLeft > chunk) {
-        Receive(ring.write, chunk);
-        ring.Write(chunk);
+    // receive behind the record header, the record is committed only if valid
+    const auto frame = ring.RecordPayload(ring.write.load(std::memory_order_relaxed));
+    auto pos = frame;
+    for (size_t bytesLeft = length; bytesLeft; ) {
+        const auto chunk = std::min(bytesLeft, ring.Contiguous(pos));
+        Receive(pos, chunk);
+        pos = ring.Next(pos, chunk);
         bytesLeft -= chunk;
-        chunk = ring.WriteChunk();
     }
-    Receive(ring.write, bytesLeft);
-    ring.Write(bytesLeft);
+    if (!NotificationDispatcher::IsValidFrame(ring, frame, length)) {
+        ++metrics.numNotificationDrops;
+        LOG_WARN("port " << std::dec << header.targetPort() << " dropped malformed notification");
+        return false;
+    }
+    ring.CommitRecord(length);
+    ++metrics.numNotificationFrames;
+    GetTracer().Complete("notification", "receive", begin, header.targetPort());
     dispatcher->Notify();
     return true;
 }
 
 void AmsConnection::TryRecv()
 {
+    GetTracer().SetThreadName("AdsReceiver " + ToString(destIp));
     try {
         Recv();
     } catch (const std::runtime_error& e) {
         LOG_INFO(e.what());
     }
+    GetTracer().Instant("connection", "disconnect", ToString(destIp));
+    // next request reconnects
+    ownIp = 0;
 }
 
 void AmsConnection::Recv()
+{
+    for ( ; ownIp; ) {
+        ProcessFrame();
+    }
+}
+
+void AmsConnection::ProcessFrame()
 {
     AmsTcpHeader amsTcpHeader;
     AoEHeader aoeHeader;
-    for ( ; ownIp; ) {
-        Receive(amsTcpHeader);
-        if (amsTcpHeader.length() < sizeof(aoeHeader)) {
-            LOG_WARN("Frame to short to be AoE");
-            ReceiveJunk(amsTcpHeader.length());
-            continue;
-        }
+    Receive(amsTcpHeader);
+    const auto received = RequestTimestamp();
+    metrics.bytesReceived += sizeof(amsTcpHeader) + amsTcpHeader.length();
+    if (amsTcpHeader.length() < sizeof(aoeHeader)) {
+        LOG_WARN("Frame to short to be AoE");
+        ReceiveJunk(amsTcpHeader.length());
+        return;
+    }
 
-        Receive(aoeHeader);
-        if (aoeHeader.cmdId() == AoEHeader::DEVICE_NOTIFICATION) {
-            ReceiveNotification(aoeHeader);
-            continue;
-        }
+    Receive(aoeHeader);
+    ADS_PROBE4(frame_parsed, aoeHeader.invokeId(), aoeHeader.targetPort(), aoeHeader.length(), aoeHeader.cmdId());
+    if (aoeHeader.cmdId() == AoEHeader::DEVICE_NOTIFICATION) {
+        ReceiveNotification(aoeHeader);
+        return;
+    }
 
-        auto response = GetPending(aoeHeader.invokeId(), aoeHeader.targetPort());
-        if (!response) {
-            LOG_WARN("No response pending");
-            ReceiveJunk(aoeHeader.length());
-            continue;
-        }
+    auto response = GetPending(aoeHeader.invokeId(), aoeHeader.targetPort());
+    if (!response) {
+        ADS_PROBE4(response_mismatched, aoeHeader.invokeId(), aoeHeader.targetPort(), aoeHeader.length(),
+                   aoeHeader.cmdId());
+        LOG_WARN("No response pending");
+        ReceiveJunk(aoeHeader.length());
+        return;
+    }
 
-        ReceiveFrame(response->frame, aoeHeader.length());
-
-        switch (aoeHeader.cmdId()) {
-        case AoEHeader::READ_DEVICE_INFO:
-        case AoEHeader::READ:
-        case AoEHeader::WRITE:
-        case AoEHeader::READ_STATE:
-        case AoEHeader::WRITE_CONTROL:
-        case AoEHeader::ADD_DEVICE_NOTIFICATION:
-        case AoEHeader::DEL_DEVICE_NOTIFICATION:
-        case AoEHeader::READ_WRITE:
-            break;
-
-        default:
-            LOG_WARN("Unkown AMS command id");
-            response->frame.clear();
-        }
+    ReceiveFrame(response->frame, aoeHeader.length());
+
+    switch (aoeHeader.cmdId()) {
+    case AoEHeader::READ_DEVICE_INFO:
+    case AoEHeader::READ:
+    case AoEHeader::WRITE:
+    case AoEHeader::READ_STATE:
+    case AoEHeader::WRITE_CONTROL:
+    case AoEHeader::ADD_DEVICE_NOTIFICATION:
+    case AoEHeader::DEL_DEVICE_NOTIFICATION:
+    case AoEHeader::READ_WRITE:
+        break;
+
+    default:
+        LOG_WARN("Unkown AMS command id");
+        response->frame.clear();
+    }
 
-        response->errorCode = aoeHeader.errorCode();
-        response->Notify();
+    response->errorCode = aoeHeader.errorCode();
+    if (received) {
+        response->timestamps.received = received;
+        response->timestamps.parsed = RequestTimeline::Now();
     }
+    ADS_PROBE4(response_matched, aoeHeader.invokeId(), aoeHeader.targetPort(), aoeHeader.length(),
+               aoeHeader.cmdId());
+    response->Notify();
 }
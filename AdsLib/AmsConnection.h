@@ -26,8 +26,13 @@
 #include "AmsPort.h"
 #include "Sockets.h"
 #include "Router.h"
+#include "MemoryUsage.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 #include <atomic>
+#include <chrono>
+#include <vector>
 
 struct AmsRequest {
     Frame frame;
@@ -37,6 +42,8 @@ struct AmsRequest {
     uint32_t bufferLength;
     void* buffer;
     uint32_t* bytesRead;
+    const uint64_t start;
+    const MemoryCharge memoryCharge;
 
     AmsRequest(const AmsAddr& ams,
                uint16_t       __port,
@@ -51,14 +58,19 @@ struct AmsRequest {
         cmdId(__cmdId),
         bufferLength(__bufferLength),
         buffer(__buffer),
-        bytesRead(__bytesRead)
+        bytesRead(__bytesRead),
+        start(RequestTimestamp()),
+        memoryCharge(ADS_MEM_REQUEST_FRAMES, frame.capacity())
     {}
 };
 
 struct AmsResponse {
+    static const size_t FRAME_SIZE = 4096;
+
     Frame frame;
     std::atomic<uint32_t> invokeId;
     uint32_t errorCode;
+    RequestTimestamps timestamps;
 
     AmsResponse();
     void Notify();
@@ -66,75 +78,175 @@ struct AmsResponse {
     // return true if notified before timeout
     bool Wait(uint32_t timeout_ms);
 private:
-    std::mutex mutex;
-    std::condition_variable cv;
+    SignalMutex mutex;
+    ConditionVariable cv;
 };
 
 struct AmsConnection : AmsProxy {
-    AmsConnection(Router& __router, IpV4 destIp = IpV4 { "" });
+    AmsConnection(Router& __router, IpV4 destIp = IpV4 { "" }, bool polling = false);
     ~AmsConnection();
 
+    /**
+     * Establish the tcp connection to destIp, if not already done.
+     * @return own ip of the established connection or 0 on failure
+     */
+    uint32_t Connect();
+
+    /**
+     * Close the tcp connection, if it was not used for <timeout> and neither
+     * requests nor notifications are pending. The next request reconnects.
+     * Never blocks: the receiver thread terminates on its own after the socket
+     * shutdown and is joined by the next Connect() or the destructor, so the
+     * caller may hold the router lock.
+     * @return true if the connection was closed
+     */
+    bool CloseIfIdle(std::chrono::milliseconds timeout);
+
+    /**
+     * Polling mode only: wait up to <timeout> for data on the socket, read
+     * everything available and process all complete frames. Responses are
+     * handed to the waiting request, notification callbacks run inline.
+     * @return false if the connection was lost
+     */
+    bool Poll(timeval* timeout);
+
+    void CollectMetrics(MetricsWriter& writer);
+
+    /**
+     * @return false if a new notification receive buffer for <connection> wouldn't fit into the memory budget
+     */
+    bool NotificationFitsBudget(const VirtualConnection& connection);
+
     NotifyMapping CreateNotifyMapping(uint32_t hNotify, Notification& notification);
     long DeleteNotification(const AmsAddr& amsAddr, uint32_t hNotify, uint32_t tmms, uint16_t port);
 
+    /**
+     * Delete <handles> with ADSIGRP_SUMUP_DELDEVNOTE requests. Devices without sum up
+     * support get one request per handle. Nothing is sent, if the connection is down,
+     * as the device drops the notifications of a closed connection on its own. After
+     * a timeout the remaining handles are released without asking the device again.
+     */
+    long DeleteNotifications(const AmsAddr& amsAddr, const std::vector<uint32_t>& handles, uint32_t tmms,
+                             uint16_t port);
+
     template<class T> long AdsRequest(AmsRequest& request, uint32_t tmms)
+    {
+        AmsResponse* response;
+        const auto status = Send(request, response);
+        if (status) {
+            return status;
+        }
+        return Finish<T>(request, response, tmms);
+    }
+
+    /**
+     * Send <request> without waiting for the response. On success <response> has to be
+     * passed to Finish() to collect the result and free the response slot of the port.
+     */
+    long Send(AmsRequest& request, AmsResponse*& response)
     {
         AmsAddr srcAddr;
         const auto status = router.GetLocalAddress(request.port, &srcAddr);
         if (status) {
             return status;
         }
-        AmsResponse* response = Write(request.frame, request.destAddr, srcAddr, request.cmdId);
-        if (response) {
-            if (response->Wait(tmms)) {
-                const uint32_t bytesAvailable = std::min<uint32_t>(request.bufferLength,
-                                                                   response->frame.size() - sizeof(T));
+        response = Write(request.frame, request.destAddr, srcAddr, request.cmdId);
+        return response ? 0 : -1;
+    }
+
+    template<class T> long Finish(AmsRequest& request, AmsResponse* response, uint32_t tmms)
+    {
+        if (Wait(response, tmms)) {
+            const auto woken = RequestTimeline::Now();
+            metrics.rtt.Add(woken - response->timestamps.reserved);
+            long result = response->errorCode;
+            uint32_t bytesAvailable = 0;
+            if (response->frame.size() < sizeof(AoEResponseHeader)) {
+                // response was discarded by ReceiveFrame() or is too short to carry a result
+                result = result ? result : ADSERR_DEVICE_INVALIDSIZE;
+            } else {
+                if (response->frame.size() > sizeof(T)) {
+                    bytesAvailable = std::min<uint32_t>(request.bufferLength, response->frame.size() - sizeof(T));
+                }
                 T header(response->frame.data());
                 memcpy(request.buffer, response->frame.data() + sizeof(T), bytesAvailable);
-                if (request.bytesRead) {
-                    *request.bytesRead = bytesAvailable;
-                }
-                const auto errorCode = response->errorCode;
-                Release(response);
-                return errorCode ? errorCode : header.result();
+                result = result ? result : header.result();
+            }
+            if (request.bytesRead) {
+                *request.bytesRead = bytesAvailable;
+            }
+            metrics.numErrors += !!result;
+            if (request.start) {
+                Record(request, result, response->timestamps, woken);
             }
             Release(response);
-            return ADSERR_CLIENT_SYNCTIMEOUT;
+            return result;
+        }
+        ++metrics.numTimeouts;
+        if (request.start) {
+            // the receiver might still write, so only use the timestamps of the sending thread
+            RequestTimestamps timestamps;
+            timestamps.invokeId = response->timestamps.invokeId;
+            timestamps.reserved = response->timestamps.reserved;
+            timestamps.sent = response->timestamps.sent;
+            Record(request, ADSERR_CLIENT_SYNCTIMEOUT, timestamps, 0);
         }
-        return -1;
+        Release(response);
+        return ADSERR_CLIENT_SYNCTIMEOUT;
     }
 
 private:
     friend struct AmsRouter;
     Router& router;
-    TcpSocket socket;
+    std::unique_ptr<TcpSocket> socket;
+    Mutex socketMutex {"AmsConnection::socketMutex"};
+    std::chrono::steady_clock::time_point lastUse;
+    bool closedIdle; // set by CloseIfIdle(), so Write() reconnects instead of failing
     std::thread receiver;
     std::atomic<size_t> refCount;
+    ConnectionMetrics metrics;
+    const std::shared_ptr<MemoryUsage> memory;
     std::atomic<uint32_t> invokeId;
     std::array<AmsResponse, Router::NUM_PORTS_MAX> queue;
 
-    Frame& ReceiveFrame(Frame& frame, size_t length) const;
+    /**
+     * In polling mode no receiver thread exists. Poll() buffers complete frames
+     * in rxBuffer, which are then processed by ProcessFrame() reading from
+     * [rxPos, rxEnd) instead of the socket.
+     */
+    const bool polling;
+    std::vector<uint8_t> rxBuffer;
+    const uint8_t* rxPos;
+    const uint8_t* rxEnd;
+    size_t rxAccounted;
+    void ReleaseRxBuffer();
+
+    Frame& ReceiveFrame(Frame& frame, size_t length);
     bool ReceiveNotification(const AoEHeader& header);
-    void ReceiveJunk(size_t bytesToRead) const;
-    void Receive(void* buffer, size_t bytesToRead) const;
-    template<class T> void Receive(T& buffer) const { Receive(&buffer, sizeof(T)); }
+    void ReceiveJunk(size_t bytesToRead);
+    void Receive(void* buffer, size_t bytesToRead);
+    template<class T> void Receive(T& buffer) { Receive(&buffer, sizeof(T)); }
     AmsResponse* Write(Frame& request, const AmsAddr dest, const AmsAddr srcAddr, uint16_t cmdId);
+    bool Wait(AmsResponse* response, uint32_t tmms);
+    void Disconnect();
+    void Record(const AmsRequest& request, long result, const RequestTimestamps& timestamps, uint64_t woken);
 
     void Recv();
     void TryRecv();
+    void ProcessFrame();
     uint32_t GetInvokeId();
     void Release(AmsResponse* response);
     AmsResponse* Reserve(uint32_t id, uint16_t port);
     AmsResponse* GetPending(uint32_t id, uint16_t port);
 
-    std::map<VirtualConnection, std::shared_ptr<NotificationDispatcher> > dispatcherList;
-    std::recursive_mutex dispatcherListMutex;
+    FlatMap<VirtualConnection, std::shared_ptr<NotificationDispatcher> > dispatcherList;
+    RecursiveMutex dispatcherListMutex {"AmsConnection::dispatcherListMutex"};
     std::shared_ptr<NotificationDispatcher> DispatcherListAdd(const VirtualConnection& connection);
     std::shared_ptr<NotificationDispatcher> DispatcherListGet(const VirtualConnection& connection);
 
 public:
     const IpV4 destIp;
-    const uint32_t ownIp;
+    std::atomic<uint32_t> ownIp;
 };
 
 #endif /* #ifndef _AMSCONNECTION_H_ */
@@ -22,14 +22,6 @@
 
 #include "AmsPort.h"
 
-namespace std
-{
-bool operator==(const AmsAddr& lhs, const AmsAddr& rhs)
-{
-    return 0 == memcmp(&lhs, &rhs, sizeof(lhs));
-}
-}
-
 AmsPort::AmsPort()
     : tmms(DEFAULT_TIMEOUT),
     port(0)
@@ -37,35 +29,79 @@ AmsPort::AmsPort()
 
 void AmsPort::AddNotification(NotifyMapping mapping)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    notifications.insert(mapping);
+    std::lock_guard<Mutex> lock(mutex);
+    notifications.emplace(NotifyKey {mapping.first, mapping.second->conn.second}, mapping.second);
 }
 
 void AmsPort::Close()
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<Mutex> lock(mutex);
+    EraseNotifications(nullptr);
+    port = 0;
+}
+
+void AmsPort::DelNotifications(const AmsNetId& netId)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    EraseNotifications(&netId);
+}
 
-    auto it = std::begin(notifications);
-    while (it != std::end(notifications)) {
-        it->second->Erase(it->first, tmms);
+/**
+ * Delete the notifications of <netId>, or all if nullptr. Handles are grouped by
+ * their source, so each device gets a single batch.
+ */
+void AmsPort::EraseNotifications(const AmsNetId* netId)
+{
+    using Batch = std::pair<std::shared_ptr<NotificationDispatcher>, std::vector<uint32_t> >;
+    FlatMap<AmsAddr, Batch> batches;
+    auto it = notifications.begin();
+    while (it != notifications.end()) {
+        if (netId && !FlatKey<AmsNetId>::Equal(*netId, it->first.second.netId)) {
+            ++it;
+            continue;
+        }
+        auto& batch = batches[it->first.second];
+        batch.first = it->second;
+        batch.second.push_back(it->first.first);
         it = notifications.erase(it);
     }
-    port = 0;
+    for (const auto& batch : batches) {
+        batch.second.first->Erase(batch.second.second, tmms);
+    }
 }
 
 long AmsPort::DelNotification(const AmsAddr& ams, uint32_t hNotify)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (auto it = notifications.begin(); it != notifications.end(); ++it) {
-        if (it->first == hNotify) {
-            if (std::ref(it->second->conn.second) == ams) {
-                const auto status = it->second->Erase(hNotify, tmms);
-                notifications.erase(it);
-                return status;
-            }
+    std::lock_guard<Mutex> lock(mutex);
+    const auto it = notifications.find(NotifyKey {hNotify, ams});
+    if (it == notifications.end()) {
+        return ADSERR_CLIENT_REMOVEHASH;
+    }
+    const auto status = it->second->Erase(hNotify, tmms);
+    notifications.erase(it);
+    return status;
+}
+
+void AmsPort::GetCallbackStats(std::vector<AdsCallbackStats>& stats)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    for (const auto& mapping : notifications) {
+        AdsCallbackStats s;
+        if (mapping.second->GetStats(mapping.first.first, s)) {
+            stats.push_back(s);
         }
     }
-    return ADSERR_CLIENT_REMOVEHASH;
+}
+
+void AmsPort::CollectMetrics(MetricsWriter& writer)
+{
+    std::stringstream labels;
+    labels << "port=\"" << port << '"';
+    writer.AddCounter("ads_port_requests", "Requests issued from the port", labels.str(), numRequests);
+    writer.AddCounter("ads_port_request_errors", "Requests issued from the port, which failed", labels.str(),
+                      numErrors);
+    writer.AddCounter("ads_port_request_timeouts", "Requests issued from the port, which timed out", labels.str(),
+                      numTimeouts);
 }
 
 bool AmsPort::IsOpen() const
@@ -25,10 +25,15 @@
 
 #include "NotificationDispatcher.h"
 
-#include <set>
+#include <vector>
 
 using NotifyMapping = std::pair<uint32_t, std::shared_ptr<NotificationDispatcher> >;
 
+/**
+ * Notification handles are only unique per device, so they are stored by handle and source
+ */
+using NotifyKey = std::pair<uint32_t, AmsAddr>;
+
 struct AmsPort {
     AmsPort();
     void Close();
@@ -40,9 +45,33 @@ struct AmsPort {
     void AddNotification(NotifyMapping mapping);
     long DelNotification(const AmsAddr& ams, uint32_t hNotify);
 
+    /**
+     * Delete all notifications of <netId>, in one batch per device
+     */
+    void DelNotifications(const AmsNetId& netId);
+    void GetCallbackStats(std::vector<AdsCallbackStats>& stats);
+    void CollectMetrics(MetricsWriter& writer);
+
+    /**
+     * Count the result of a request issued from this port
+     * @return status
+     */
+    long Count(long status)
+    {
+        ++numRequests;
+        numErrors += !!status;
+        numTimeouts += (ADSERR_CLIENT_SYNCTIMEOUT == status);
+        return status;
+    }
+
 private:
     static const uint32_t DEFAULT_TIMEOUT = 5000;
-    std::set<NotifyMapping> notifications;
-    std::mutex mutex;
+    void EraseNotifications(const AmsNetId* netId);
+
+    FlatMap<NotifyKey, std::shared_ptr<NotificationDispatcher> > notifications;
+    std::atomic<uint64_t> numRequests {0};
+    std::atomic<uint64_t> numErrors {0};
+    std::atomic<uint64_t> numTimeouts {0};
+    Mutex mutex {"AmsPort::mutex"};
 };
 #endif /* #ifndef _AMS_PORT_H_ */
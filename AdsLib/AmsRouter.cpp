@@ -24,15 +24,260 @@
 #include "Log.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(__gnu_linux__)
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(__APPLE__) || defined(__CYGWIN__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 AmsRouter::AmsRouter(AmsNetId netId)
-    : localAddr(netId)
-{}
+    : localAddr(netId),
+    hasLocalAddr(!!netId),
+    polling(false),
+    wakeup{-1, -1},
+    idleTimeout(0),
+    reaperStop(false)
+{
+#ifdef CONFIG_ADSLIB_SINGLE_THREADED
+    SetPollingMode(true);
+#endif
+}
+
+AmsRouter::~AmsRouter()
+{
+    {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        reaperStop = true;
+    }
+    reaperCv.notify_all();
+    if (reaper.joinable()) {
+        reaper.join();
+    }
+
+#if defined(__gnu_linux__) || defined(__APPLE__) || defined(__CYGWIN__)
+    if (wakeup[1] != wakeup[0]) {
+        close(wakeup[1]);
+    }
+    if (wakeup[0] >= 0) {
+        close(wakeup[0]);
+    }
+#endif
+}
+
+long AmsRouter::SetPollingMode(bool enable)
+{
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    if (enable == polling) {
+        return 0;
+    }
+#ifdef CONFIG_ADSLIB_SINGLE_THREADED
+    if (!enable) {
+        return ADSERR_DEVICE_SRVNOTSUPP;
+    }
+#endif
+    if (!connections.empty() || reaper.joinable()) {
+        return ADSERR_DEVICE_BUSY;
+    }
+
+#if defined(__gnu_linux__)
+    if (wakeup[0] < 0) {
+        wakeup[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        wakeup[1] = wakeup[0];
+    }
+#elif defined(__APPLE__) || defined(__CYGWIN__)
+    if ((wakeup[0] < 0) && !pipe(wakeup)) {
+        fcntl(wakeup[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakeup[1], F_SETFL, O_NONBLOCK);
+    }
+#else
+    return ADSERR_DEVICE_SRVNOTSUPP;
+#endif
+    if (wakeup[0] < 0) {
+        return ADSERR_DEVICE_SRVNOTSUPP;
+    }
+    polling = enable;
+    return 0;
+}
+
+long AmsRouter::GetPollFds(int* fds, uint32_t& numFds)
+{
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    if (!polling) {
+        return ADSERR_DEVICE_SRVNOTSUPP;
+    }
+
+    std::vector<int> result;
+    for (const auto& conn : connections) {
+        if (conn.second->ownIp) {
+            result.push_back(conn.second->socket->NativeHandle());
+        }
+    }
+    result.push_back(wakeup[0]);
+
+    const auto capacity = numFds;
+    numFds = result.size();
+    if (capacity < result.size()) {
+        return ADSERR_DEVICE_INVALIDSIZE;
+    }
+    std::copy(result.begin(), result.end(), fds);
+    return 0;
+}
+
+long AmsRouter::ProcessEvents()
+{
+    if (!polling) {
+        return ADSERR_DEVICE_SRVNOTSUPP;
+    }
+
+#if defined(__gnu_linux__) || defined(__APPLE__) || defined(__CYGWIN__)
+    uint64_t events[8];
+    while (read(wakeup[0], events, sizeof(events)) > 0) {}
+#endif
+
+    // callbacks might delete routes, so look up each connection again
+    std::vector<IpV4> ips;
+    {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        for (const auto& conn : connections) {
+            ips.push_back(conn.first);
+        }
+    }
+
+    for (const auto& ip : ips) {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        const auto conn = connections.find(ip);
+        if (conn == connections.end()) {
+            continue;
+        }
+        if (idleTimeout && conn->second->CloseIfIdle(std::chrono::milliseconds(idleTimeout))) {
+            PollFdsChanged();
+            continue;
+        }
+        timeval noWait {0, 0};
+        conn->second->Poll(&noWait);
+    }
+    return 0;
+}
+
+void AmsRouter::PollFdsChanged()
+{
+#if defined(__gnu_linux__) || defined(__APPLE__) || defined(__CYGWIN__)
+    if (polling) {
+        const uint64_t event = 1;
+        if (write(wakeup[1], &event, sizeof(event)) < 0) {
+            LOG_WARN("Signaling poll fd change failed");
+        }
+    }
+#endif
+}
+
+long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip, bool lazy)
+{
+    std::lock_guard<RecursiveMutex> lock(mutex);
+
+    AmsConnection* conn;
+    const auto status = __AddRoute(ams, ip, conn);
+    if (status || lazy) {
+        return status;
+    }
+    return !Connect(*conn);
+}
+
+void AmsRouter::SetIdleTimeout(uint32_t timeout)
+{
+    {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        idleTimeout = timeout;
+        if (!reaper.joinable() && idleTimeout && !polling) {
+            reaper = std::thread(&AmsRouter::CloseIdleConnections, this);
+        }
+    }
+    reaperCv.notify_all();
+}
+
+void AmsRouter::CloseIdleConnections()
+{
+    std::unique_lock<RecursiveMutex> lock(mutex);
+    while (!reaperStop) {
+        if (idleTimeout) {
+            for (auto& conn : connections) {
+                conn.second->CloseIfIdle(std::chrono::milliseconds(idleTimeout));
+            }
+        }
+
+        // check twice per timeout, so connections are closed within 1.5 * idleTimeout
+        const auto interval = idleTimeout ? std::chrono::milliseconds(idleTimeout / 2 + 1) : std::chrono::hours(1);
+        reaperCv.wait_for(lock, interval);
+    }
+}
+
+void AmsRouter::AddRoutes(const std::vector<AmsRoute>& routes, long* results, bool lazy)
+{
+    std::vector<AmsConnection*> conns(routes.size(), nullptr);
+    std::vector<AmsConnection*> pending;
+    {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        for (size_t i = 0; i < routes.size(); ++i) {
+            const auto& ip = routes[i].second;
+            if (!routes[i].first || !ip.value || (INADDR_NONE == ip.value)) {
+                results[i] = ADSERR_CLIENT_INVALIDPARM;
+                continue;
+            }
+
+            results[i] = __AddRoute(routes[i].first, ip, conns[i]);
+            if (!results[i] && !conns[i]->ownIp &&
+                (std::find(pending.begin(), pending.end(), conns[i]) == pending.end())) {
+                pending.push_back(conns[i]);
+            }
+        }
+    }
+
+    if (lazy) {
+        return;
+    }
+
+    ConnectAll(pending);
+
+    for (size_t i = 0; i < routes.size(); ++i) {
+        if (!results[i] && !conns[i]->ownIp) {
+            LOG_WARN("Connecting route " << routes[i].first << " failed");
+            results[i] = GLOBALERR_MISSING_ROUTE;
+        }
+    }
+}
 
-long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip)
+void AmsRouter::ConnectAll(const std::vector<AmsConnection*>& conns)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (polling || (conns.size() < 2)) {
+        for (const auto conn : conns) {
+            Connect(*conn);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    const auto numWorkers = std::min(conns.size(), size_t {NUM_CONNECT_THREADS_MAX});
+    for (size_t i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([&]() {
+            for (auto n = next++; n < conns.size(); n = next++) {
+                Connect(*conns[n]);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+}
 
+long AmsRouter::__AddRoute(AmsNetId ams, const IpV4& ip, AmsConnection*& connection)
+{
     const auto oldConnection = GetConnection(ams);
     if (oldConnection && !(ip == oldConnection->destIp)) {
         /**
@@ -44,27 +289,54 @@ long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip)
 
     auto conn = connections.find(ip);
     if (conn == connections.end()) {
-        const auto isFirst = connections.empty();
-        conn = connections.emplace(ip, std::unique_ptr<AmsConnection>(new AmsConnection { *this, ip })).first;
-
-        if (isFirst) {
-            localAddr = AmsNetId {conn->second->ownIp};
+        if (!MemoryBudgetFits(Router::NUM_PORTS_MAX * AmsResponse::FRAME_SIZE)) {
+            LOG_WARN("Memory budget exceeded, refusing connection");
+            return GLOBALERR_NO_MEMORY;
         }
+        conn = connections.emplace(ip, std::unique_ptr<AmsConnection>(new AmsConnection { *this, ip, polling })).first;
     }
 
     conn->second->refCount++;
     mapping[ams] = conn->second.get();
-    return !conn->second->ownIp;
+    connection = conn->second.get();
+    return 0;
+}
+
+uint32_t AmsRouter::Connect(AmsConnection& conn)
+{
+    // every request passes here, so established connections must not take any lock
+    const auto wasConnected = conn.ownIp.load();
+    if (wasConnected && hasLocalAddr.load(std::memory_order_acquire)) {
+        return wasConnected;
+    }
+
+    const auto ownIp = conn.Connect();
+    if (ownIp) {
+        std::lock_guard<RecursiveMutex> lock(mutex);
+        if (!localAddr) {
+            localAddr = AmsNetId {ownIp};
+            hasLocalAddr.store(true, std::memory_order_release);
+        }
+        if (!wasConnected) {
+            PollFdsChanged();
+        }
+    }
+    return ownIp;
 }
 
 void AmsRouter::DelRoute(const AmsNetId& ams)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
 
     auto route = mapping.find(ams);
     if (route != mapping.end()) {
         AmsConnection* conn = route->second;
         if (0 == --conn->refCount) {
+            for (auto& port : ports) {
+                if (port.IsOpen()) {
+                    port.DelNotifications(ams);
+                }
+            }
             mapping.erase(route);
             DeleteIfLastConnection(conn);
         }
@@ -85,7 +357,7 @@ void AmsRouter::DeleteIfLastConnection(const AmsConnection* conn)
 
 uint16_t AmsRouter::OpenPort()
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
 
     for (uint16_t i = 0; i < NUM_PORTS_MAX; ++i) {
         if (!ports[i].IsOpen()) {
@@ -97,7 +369,7 @@ uint16_t AmsRouter::OpenPort()
 
 long AmsRouter::ClosePort(uint16_t port)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
     if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX) || !ports[port - PORT_BASE].IsOpen()) {
         return ADSERR_CLIENT_PORTNOTOPEN;
     }
@@ -107,7 +379,7 @@ long AmsRouter::ClosePort(uint16_t port)
 
 long AmsRouter::GetLocalAddress(uint16_t port, AmsAddr* pAddr)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
     if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
         return ADSERR_CLIENT_PORTNOTOPEN;
     }
@@ -122,7 +394,7 @@ long AmsRouter::GetLocalAddress(uint16_t port, AmsAddr* pAddr)
 
 long AmsRouter::GetTimeout(uint16_t port, uint32_t& timeout)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
     if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
         return ADSERR_CLIENT_PORTNOTOPEN;
     }
@@ -133,7 +405,7 @@ long AmsRouter::GetTimeout(uint16_t port, uint32_t& timeout)
 
 long AmsRouter::SetTimeout(uint16_t port, uint32_t timeout)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
     if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
         return ADSERR_CLIENT_PORTNOTOPEN;
     }
@@ -144,7 +416,7 @@ long AmsRouter::SetTimeout(uint16_t port, uint32_t timeout)
 
 AmsConnection* AmsRouter::GetConnection(const AmsNetId& amsDest)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<RecursiveMutex> lock(mutex);
     const auto it = __GetConnection(amsDest);
     if (it == connections.end()) {
         return nullptr;
@@ -152,7 +424,7 @@ AmsConnection* AmsRouter::GetConnection(const AmsNetId& amsDest)
     return it->second.get();
 }
 
-std::map<IpV4, std::unique_ptr<AmsConnection> >::iterator AmsRouter::__GetConnection(const AmsNetId& amsDest)
+FlatMap<IpV4, std::unique_ptr<AmsConnection> >::iterator AmsRouter::__GetConnection(const AmsNetId& amsDest)
 {
     const auto it = mapping.find(amsDest);
     if (it != mapping.end()) {
@@ -167,13 +439,17 @@ long AmsRouter::AddNotification(AmsRequest& request, uint32_t* pNotification, No
         *request.bytesRead = 0;
     }
 
+    auto& port = ports[request.port - Router::PORT_BASE];
     auto ads = GetConnection(request.destAddr.netId);
-    if (!ads) {
-        return GLOBALERR_MISSING_ROUTE;
+    if (!ads || !Connect(*ads)) {
+        return port.Count(GLOBALERR_MISSING_ROUTE);
     }
 
-    auto& port = ports[request.port - Router::PORT_BASE];
-    const long status = ads->AdsRequest<AoEResponseHeader>(request, port.tmms);
+    if (!ads->NotificationFitsBudget(VirtualConnection {request.port, request.destAddr})) {
+        return port.Count(GLOBALERR_NO_MEMORY);
+    }
+
+    const long status = port.Count(ads->AdsRequest<AoEResponseHeader>(request, port.tmms));
     if (!status) {
         *pNotification = qFromLittleEndian<uint32_t>((uint8_t*)request.buffer);
         const auto notifyId = ads->CreateNotifyMapping(*pNotification, notify);
@@ -187,3 +463,51 @@ long AmsRouter::DelNotification(uint16_t port, const AmsAddr* pAddr, uint32_t hN
     auto& p = ports[port - Router::PORT_BASE];
     return p.DelNotification(*pAddr, hNotification);
 }
+
+long AmsRouter::GetMemoryUsage(const AmsNetId& netId, AdsMemoryUsage& usage)
+{
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    const auto it = mapping.find(netId);
+    if (it == mapping.end()) {
+        return GLOBALERR_MISSING_ROUTE;
+    }
+    it->second->memory->Get(usage);
+    return 0;
+}
+
+void AmsRouter::CollectMetrics(MetricsWriter& writer)
+{
+    AdsMemoryUsage usage;
+    ::GetMemoryUsage().Get(usage);
+    for (size_t i = 0; i < ADS_MEM_COUNT; ++i) {
+        const auto category = static_cast<AdsMemoryCategory>(i);
+        writer.AddGauge("ads_memory_bytes", "Memory allocated by the library",
+                        std::string("category=\"") + MemoryUsage::Name(category) + '"', usage.bytes[i]);
+    }
+    writer.AddGauge("ads_memory_budget_bytes", "Memory budget of the library, 0 if unlimited", {}, usage.budget);
+
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    for (const auto& route : mapping) {
+        std::stringstream labels;
+        labels << "netid=\"" << route.first << "\",ip=\"" << route.second->destIp << '"';
+        writer.AddGauge("ads_route_info", "Route from an AmsNetId to the ip of its connection", labels.str(), 1);
+    }
+    for (const auto& conn : connections) {
+        conn.second->CollectMetrics(writer);
+    }
+    for (auto& port : ports) {
+        if (port.IsOpen()) {
+            port.CollectMetrics(writer);
+        }
+    }
+}
+
+long AmsRouter::GetCallbackStats(uint16_t port, std::vector<AdsCallbackStats>& stats)
+{
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX) || !ports[port - PORT_BASE].IsOpen()) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+    ports[port - PORT_BASE].GetCallbackStats(stats);
+    return 0;
+}
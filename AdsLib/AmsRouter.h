@@ -25,8 +25,16 @@
 
 #include "AmsConnection.h"
 
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+using AmsRoute = std::pair<AmsNetId, IpV4>;
+
 struct AmsRouter : Router {
     AmsRouter(AmsNetId netId = AmsNetId {});
+    ~AmsRouter();
 
     uint16_t OpenPort();
     long ClosePort(uint16_t port);
@@ -35,34 +43,210 @@ struct AmsRouter : Router {
     long SetTimeout(uint16_t port, uint32_t timeout);
     long AddNotification(AmsRequest& request, uint32_t* pNotification, Notification& notify);
     long DelNotification(uint16_t port, const AmsAddr* pAddr, uint32_t hNotification);
+    long GetCallbackStats(uint16_t port, std::vector<AdsCallbackStats>& stats);
+    void CollectMetrics(MetricsWriter& writer);
+    long GetMemoryUsage(const AmsNetId& netId, AdsMemoryUsage& usage);
+
+    long AddRoute(AmsNetId ams, const IpV4& ip, bool lazy = false);
 
-    long AddRoute(AmsNetId ams, const IpV4& ip);
+    /**
+     * Add all <routes> at once. Connections to new targets are established
+     * concurrently by up to NUM_CONNECT_THREADS_MAX threads, without holding the
+     * router lock. With <lazy> set, no connection is established now but on first
+     * use of the route. The status of routes[i] is stored in results[i].
+     */
+    void AddRoutes(const std::vector<AmsRoute>& routes, long* results, bool lazy);
     void DelRoute(const AmsNetId& ams);
     AmsConnection* GetConnection(const AmsNetId& pAddr);
 
+    /**
+     * Close connections, which were idle for <timeout> ms. They are reestablished
+     * on next use. A <timeout> of 0 keeps idle connections open (default).
+     */
+    void SetIdleTimeout(uint32_t timeout);
+
+    /**
+     * Switch to polling mode, in which the library creates no threads of its own.
+     * Responses and notifications are processed by ProcessEvents() or while a
+     * synchronous request waits for its response. Only allowed as long as no
+     * route was added.
+     */
+    long SetPollingMode(bool enable);
+
+    /**
+     * Polling mode only: store the file descriptors to watch for readability in
+     * <fds>. On input <numFds> is the capacity of <fds>, on output the number of
+     * file descriptors. The last one is signaled, whenever the set changes.
+     */
+    long GetPollFds(int* fds, uint32_t& numFds);
+
+    /**
+     * Polling mode only: process all pending responses and notifications without blocking
+     */
+    long ProcessEvents();
+    void PollFdsChanged();
+
     template<class T> long AdsRequest(AmsRequest& request)
     {
         if (request.bytesRead) {
             *request.bytesRead = 0;
         }
 
+        auto& port = ports[request.port - Router::PORT_BASE];
         auto ads = GetConnection(request.destAddr.netId);
-        if (!ads) {
-            return GLOBALERR_MISSING_ROUTE;
+        if (!ads || !Connect(*ads)) {
+            return port.Count(GLOBALERR_MISSING_ROUTE);
+        }
+        return port.Count(ads->AdsRequest<T>(request, port.tmms));
+    }
+
+    /**
+     * Pipeline <requests> to their targets. Up to NUM_PENDING_MAX requests are kept in
+     * flight at the same time, only one per connection and port. Requests to the same
+     * target are sent in order, but whichever response arrives first is finished first,
+     * so a slow or dead target doesn't hold back the others. Each request times out
+     * after the timeout of its port, counted from sending it. Unconnected targets are
+     * connected up front, concurrently, and a target which failed to connect fails all
+     * its requests. The status of requests[i] is stored in results[i].
+     */
+    template<class T> void AdsRequestMulti(std::vector<AmsRequest>& requests, long* results)
+    {
+        std::deque<Pending> pending;
+        const auto finishFirst = [&]() {
+            for (;;) {
+                const auto now = std::chrono::steady_clock::now();
+                for (auto it = pending.begin(); it != pending.end(); ++it) {
+                    if (!it->response->invokeId || (it->deadline <= now)) {
+                        // answered or timed out, so Finish() doesn't have to wait
+                        *it->result = it->ads->Finish<T>(*it->request, it->response, 0);
+                        pending.erase(it);
+                        return;
+                    }
+                }
+                // the oldest wakes us up at once, the others are noticed within a millisecond
+                if (polling) {
+                    ProcessEvents();
+                }
+                pending.front().ads->Wait(pending.front().response, 1);
+            }
+        };
+
+        // a blocking connect to one target must not delay the requests to all others
+        std::vector<AmsConnection*> conns(requests.size());
+        std::vector<AmsConnection*> unconnected;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            conns[i] = GetConnection(requests[i].destAddr.netId);
+            if (conns[i] && !conns[i]->ownIp &&
+                (std::find(unconnected.begin(), unconnected.end(), conns[i]) == unconnected.end())) {
+                unconnected.push_back(conns[i]);
+            }
+        }
+        ConnectAll(unconnected);
+
+        std::vector<size_t> unsent;
+        unsent.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (requests[i].bytesRead) {
+                *requests[i].bytesRead = 0;
+            }
+            if (conns[i] && !conns[i]->ownIp) {
+                // failed to connect, don't try again for each request
+                conns[i] = nullptr;
+            }
+            unsent.push_back(i);
+        }
+
+        while (!unsent.empty() || !pending.empty()) {
+            // targets with a request waiting in this pass, all their later requests have to wait, too
+            std::vector<AmsNetId> waiting;
+            size_t numUnsent = 0;
+            for (size_t next = 0; next < unsent.size(); ++next) {
+                const auto i = unsent[next];
+                auto& request = requests[i];
+                if (pending.size() >= NUM_PENDING_MAX) {
+                    unsent[numUnsent++] = i;
+                    continue;
+                }
+                const auto isWaiting = [&](const AmsNetId& netId) {
+                    return FlatKey<AmsNetId>::Equal(netId, request.destAddr.netId);
+                };
+                if (std::find_if(waiting.begin(), waiting.end(), isWaiting) != waiting.end()) {
+                    unsent[numUnsent++] = i;
+                    continue;
+                }
+
+                const auto ads = conns[i];
+                if (!ads || !Connect(*ads)) {
+                    results[i] = GLOBALERR_MISSING_ROUTE;
+                    continue;
+                }
+
+                const auto isBusy = [&](const Pending& p) {
+                    return (p.ads == ads) && (p.request->port == request.port);
+                };
+                if (std::find_if(pending.begin(), pending.end(), isBusy) != pending.end()) {
+                    waiting.push_back(request.destAddr.netId);
+                    unsent[numUnsent++] = i;
+                    continue;
+                }
+
+                AmsResponse* response;
+                results[i] = ads->Send(request, response);
+                if (!results[i]) {
+                    const auto tmms = ports[request.port - Router::PORT_BASE].tmms;
+                    pending.push_back(Pending {&request, ads, response, &results[i],
+                                               std::chrono::steady_clock::now() +
+                                               std::chrono::milliseconds(tmms)});
+                }
+            }
+            unsent.resize(numUnsent);
+
+            if (!pending.empty()) {
+                finishFirst();
+            }
+        }
+
+        for (size_t i = 0; i < requests.size(); ++i) {
+            ports[requests[i].port - Router::PORT_BASE].Count(results[i]);
         }
-        return ads->AdsRequest<T>(request, ports[request.port - Router::PORT_BASE].tmms);
     }
 
 private:
+    static const size_t NUM_PENDING_MAX = 64;
+    static const size_t NUM_CONNECT_THREADS_MAX = 16;
+    struct Pending {
+        AmsRequest* request;
+        AmsConnection* ads;
+        AmsResponse* response;
+        long* result;
+        std::chrono::steady_clock::time_point deadline;
+    };
     AmsNetId localAddr;
-    std::recursive_mutex mutex;
-    std::map<IpV4, std::unique_ptr<AmsConnection> > connections;
-    std::map<AmsNetId, AmsConnection*> mapping;
+    std::atomic<bool> hasLocalAddr; // set once localAddr is known, to check it without the lock
+    RecursiveMutex mutex {"AmsRouter::mutex"};
+    FlatMap<IpV4, std::unique_ptr<AmsConnection> > connections;
+    FlatMap<AmsNetId, AmsConnection*> mapping;
+
+    FlatMap<IpV4, std::unique_ptr<AmsConnection> >::iterator __GetConnection(const AmsNetId& pAddr);
+    long __AddRoute(AmsNetId ams, const IpV4& ip, AmsConnection*& conn);
+    uint32_t Connect(AmsConnection& conn);
 
-    std::map<IpV4, std::unique_ptr<AmsConnection> >::iterator __GetConnection(const AmsNetId& pAddr);
+    /**
+     * Connect <conns> from up to NUM_CONNECT_THREADS_MAX threads, one after the other
+     * in polling mode
+     */
+    void ConnectAll(const std::vector<AmsConnection*>& conns);
     void DeleteIfLastConnection(const AmsConnection* conn);
     void Recv();
 
+    bool polling;
+    int wakeup[2];
+    uint32_t idleTimeout;
+    bool reaperStop;
+    ConditionVariableAny reaperCv;
+    std::thread reaper;
+    void CloseIdleConnections();
+
     std::array<AmsPort, NUM_PORTS_MAX> ports;
 };
 #endif /* #ifndef _AMS_ROUTER_H_ */
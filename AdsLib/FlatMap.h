@@ -0,0 +1,321 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _FLAT_MAP_H_
+#define _FLAT_MAP_H_
+
+#include "AdsDef.h"
+#include "Sockets.h"
+
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+static inline uint64_t FlatMix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+/**
+ * Hash and equality of the keys of a FlatMap. The AdsDef.h types are C structs
+ * without operator==, so the keys are compared here instead.
+ */
+template<class T, class Enable = void> struct FlatKey;
+
+template<class T> struct FlatKey<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static uint64_t Hash(T key) { return FlatMix(static_cast<uint64_t>(key)); }
+    static bool Equal(T lhs, T rhs) { return lhs == rhs; }
+};
+
+template<> struct FlatKey<AmsNetId> {
+    static uint64_t Pack(const AmsNetId& key)
+    {
+        uint64_t value = 0;
+        memcpy(&value, key.b, sizeof(key.b));
+        return value;
+    }
+    static uint64_t Hash(const AmsNetId& key) { return FlatMix(Pack(key)); }
+    static bool Equal(const AmsNetId& lhs, const AmsNetId& rhs) { return !memcmp(lhs.b, rhs.b, sizeof(lhs.b)); }
+};
+
+template<> struct FlatKey<AmsAddr> {
+    static uint64_t Hash(const AmsAddr& key) { return FlatMix((FlatKey<AmsNetId>::Pack(key.netId) << 16) | key.port); }
+    static bool Equal(const AmsAddr& lhs, const AmsAddr& rhs)
+    {
+        return (lhs.port == rhs.port) && FlatKey<AmsNetId>::Equal(lhs.netId, rhs.netId);
+    }
+};
+
+template<> struct FlatKey<IpV4> {
+    static uint64_t Hash(const IpV4& key) { return FlatMix(key.value); }
+    static bool Equal(const IpV4& lhs, const IpV4& rhs) { return lhs.value == rhs.value; }
+};
+
+template<class A, class B> struct FlatKey<std::pair<A, B> > {
+    static uint64_t Hash(const std::pair<A, B>& key)
+    {
+        return FlatMix(FlatKey<A>::Hash(key.first) ^ (FlatKey<B>::Hash(key.second) * 0x9e3779b97f4a7c15ULL));
+    }
+    static bool Equal(const std::pair<A, B>& lhs, const std::pair<A, B>& rhs)
+    {
+        return FlatKey<A>::Equal(lhs.first, rhs.first) && FlatKey<B>::Equal(lhs.second, rhs.second);
+    }
+};
+
+/**
+ * Open addressed hash map with linear probing, for the lookups on the request
+ * and notification paths. The entries live in one array next to an array of
+ * one control byte per slot, which holds 7 bits of the hash, so a lookup
+ * usually touches two cache lines and compares a single key.
+ *
+ * Erased slots become tombstones, which keeps iterators valid while erasing
+ * during iteration, like with std::map. Unlike std::map, entries move when
+ * the table grows, so don't keep pointers to values across an insertion.
+ * The iteration order is unspecified.
+ */
+template<class Key, class Value>
+struct FlatMap {
+    using value_type = std::pair<const Key, Value>;
+
+    template<bool IsConst>
+    struct Iterator {
+        using Map = typename std::conditional<IsConst, const FlatMap, FlatMap>::type;
+        using reference = typename std::conditional<IsConst, const value_type&, value_type&>::type;
+        using pointer = typename std::conditional<IsConst, const value_type*, value_type*>::type;
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator(Map* __map, size_t __index)
+            : map(__map),
+            index(__index)
+        {}
+
+        Iterator(const Iterator<false>& ref)
+            : map(ref.map),
+            index(ref.index)
+        {}
+
+        reference operator*() const { return map->Entry(index); }
+        pointer operator->() const { return &map->Entry(index); }
+        bool operator==(const Iterator& ref) const { return index == ref.index; }
+        bool operator!=(const Iterator& ref) const { return index != ref.index; }
+
+        Iterator& operator++()
+        {
+            index = map->NextUsed(index + 1);
+            return *this;
+        }
+
+        Map* map;
+        size_t index;
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatMap()
+        : capacity(0),
+        numUsed(0),
+        numDeleted(0)
+    {}
+
+    ~FlatMap()
+    {
+        clear();
+    }
+
+    FlatMap(const FlatMap&) = delete;
+    FlatMap& operator=(const FlatMap&) = delete;
+
+    size_t size() const { return numUsed; }
+    bool empty() const { return !numUsed; }
+
+    iterator begin() { return iterator {this, NextUsed(0)}; }
+    iterator end() { return iterator {this, capacity}; }
+    const_iterator begin() const { return const_iterator {this, NextUsed(0)}; }
+    const_iterator end() const { return const_iterator {this, capacity}; }
+
+    iterator find(const Key& key) { return iterator {this, Find(key)}; }
+    const_iterator find(const Key& key) const { return const_iterator {this, Find(key)}; }
+
+    template<class ... Args>
+    std::pair<iterator, bool> emplace(const Key& key, Args&& ... args)
+    {
+        const auto found = Find(key);
+        if (found != capacity) {
+            return {iterator {this, found}, false};
+        }
+
+        if ((numUsed + numDeleted + 1) * 8 > capacity * 7) {
+            Rehash(numUsed + 1);
+        }
+        const auto hash = FlatKey<Key>::Hash(key);
+        auto i = Home(hash, capacity);
+        while (control[i] & USED) {
+            i = (i + 1) & (capacity - 1);
+        }
+        numDeleted -= (DELETED == control[i]);
+        ++numUsed;
+        new (&slots[i]) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+        control[i] = Tag(hash);
+        return {iterator {this, i}, true};
+    }
+
+    Value& operator[](const Key& key)
+    {
+        return emplace(key).first->second;
+    }
+
+    iterator erase(iterator it)
+    {
+        const auto i = it.index;
+        Entry(i).~value_type();
+        --numUsed;
+        // a slot followed by an empty one ends no probe sequence, so it needs no tombstone
+        if (EMPTY == control[(i + 1) & (capacity - 1)]) {
+            control[i] = EMPTY;
+        } else {
+            control[i] = DELETED;
+            ++numDeleted;
+        }
+        return ++it;
+    }
+
+    size_t erase(const Key& key)
+    {
+        const auto it = find(key);
+        if (it == end()) {
+            return 0;
+        }
+        erase(it);
+        return 1;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (control[i] & USED) {
+                Entry(i).~value_type();
+            }
+            control[i] = EMPTY;
+        }
+        numUsed = 0;
+        numDeleted = 0;
+    }
+
+    /**
+     * Grow the table to hold n entries without rehashing
+     */
+    void reserve(size_t n)
+    {
+        if (n * 8 > capacity * 7) {
+            Rehash(n);
+        }
+    }
+
+private:
+    using Slot = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+    static const uint8_t EMPTY = 0;
+    static const uint8_t DELETED = 1;
+    static const uint8_t USED = 0x80;
+    static const size_t MIN_CAPACITY = 16;
+
+    size_t capacity;
+    size_t numUsed;
+    size_t numDeleted;
+    std::unique_ptr<uint8_t[]> control;
+    std::unique_ptr<Slot[]> slots;
+
+    static uint8_t Tag(uint64_t hash)
+    {
+        return USED | static_cast<uint8_t>(hash >> 57);
+    }
+
+    static size_t Home(uint64_t hash, size_t numSlots)
+    {
+        return static_cast<size_t>(hash) & (numSlots - 1);
+    }
+
+    value_type& Entry(size_t i) { return *reinterpret_cast<value_type*>(&slots[i]); }
+    const value_type& Entry(size_t i) const { return *reinterpret_cast<const value_type*>(&slots[i]); }
+
+    size_t NextUsed(size_t i) const
+    {
+        while ((i < capacity) && !(control[i] & USED)) {
+            ++i;
+        }
+        return i;
+    }
+
+    size_t Find(const Key& key) const
+    {
+        if (!numUsed) {
+            return capacity;
+        }
+        const auto hash = FlatKey<Key>::Hash(key);
+        const auto tag = Tag(hash);
+        for (auto i = Home(hash, capacity); EMPTY != control[i]; i = (i + 1) & (capacity - 1)) {
+            if ((tag == control[i]) && FlatKey<Key>::Equal(key, Entry(i).first)) {
+                return i;
+            }
+        }
+        return capacity;
+    }
+
+    /**
+     * Move all entries to a table, which is at most half full with n entries
+     */
+    void Rehash(size_t n)
+    {
+        size_t newCapacity = MIN_CAPACITY;
+        while (newCapacity < 2 * n) {
+            newCapacity *= 2;
+        }
+        std::unique_ptr<uint8_t[]> newControl(new uint8_t[newCapacity]());
+        std::unique_ptr<Slot[]> newSlots(new Slot[newCapacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            if (control[i] & USED) {
+                const auto hash = FlatKey<Key>::Hash(Entry(i).first);
+                auto pos = Home(hash, newCapacity);
+                while (EMPTY != newControl[pos]) {
+                    pos = (pos + 1) & (newCapacity - 1);
+                }
+                new (&newSlots[pos]) value_type(std::move(Entry(i)));
+                newControl[pos] = control[i];
+                Entry(i).~value_type();
+            }
+        }
+        capacity = newCapacity;
+        numDeleted = 0;
+        control = std::move(newControl);
+        slots = std::move(newSlots);
+    }
+};
+
+#endif /* #ifndef _FLAT_MAP_H_ */
@@ -0,0 +1,90 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#include "LockPolicy.h"
+#include "AdsLib.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+std::atomic<bool> LockStats::enabled {false};
+
+static std::mutex& RegistryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::map<std::string, std::unique_ptr<LockStats> >& Registry()
+{
+    // never destroyed, mutexes of static objects might still use their stats at exit
+    static auto registry = new std::map<std::string, std::unique_ptr<LockStats> >;
+    return *registry;
+}
+
+LockStats& LockStats::Get(const char* name)
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    auto& stats = Registry()[name];
+    if (!stats) {
+        stats.reset(new LockStats);
+    }
+    return *stats;
+}
+
+void LockStats::Reset()
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (auto& entry : Registry()) {
+        auto& s = *entry.second;
+        s.numAcquired = 0;
+        s.numContended = 0;
+        s.waitNs = 0;
+        s.maxWaitNs = 0;
+        s.holdNs = 0;
+        s.maxHoldNs = 0;
+    }
+}
+
+size_t LockStats::Get(AdsLockStats* stats, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    size_t num = 0;
+    for (const auto& entry : Registry()) {
+        if (num >= capacity) {
+            break;
+        }
+        auto& out = stats[num++];
+        const auto& s = *entry.second;
+        strncpy(out.name, entry.first.c_str(), sizeof(out.name) - 1);
+        out.name[sizeof(out.name) - 1] = '\0';
+        out.numAcquired = s.numAcquired;
+        out.numContended = s.numContended;
+        out.waitNs = s.waitNs;
+        out.maxWaitNs = s.maxWaitNs;
+        out.holdNs = s.holdNs;
+        out.maxHoldNs = s.maxHoldNs;
+    }
+    return num;
+}
@@ -0,0 +1,209 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _LOCK_POLICY_H_
+#define _LOCK_POLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+struct AdsLockStats;
+
+/**
+ * Contention statistics of all mutexes sharing one name
+ */
+struct LockStats {
+    std::atomic<uint64_t> numAcquired {0};
+    std::atomic<uint64_t> numContended {0};
+    std::atomic<uint64_t> waitNs {0};
+    std::atomic<uint64_t> maxWaitNs {0};
+    std::atomic<uint64_t> holdNs {0};
+    std::atomic<uint64_t> maxHoldNs {0};
+
+    static std::atomic<bool> enabled;
+
+    /**
+     * @return statistics registered for name, which stay valid until exit
+     */
+    static LockStats& Get(const char* name);
+
+    /**
+     * Copy up to capacity statistics, ordered by name
+     * @return number of copied statistics
+     */
+    static size_t Get(AdsLockStats* stats, size_t capacity);
+    static void Reset();
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void Max(std::atomic<uint64_t>& max, uint64_t value)
+    {
+        auto current = max.load();
+        while ((current < value) && !max.compare_exchange_weak(current, value)) {}
+    }
+};
+
+/**
+ * Records wait and hold times of BaseMutex into the LockStats of its name,
+ * while LockStats::enabled is set. Only the outermost lock of a recursive
+ * mutex counts.
+ */
+template<class BaseMutex>
+struct ProfiledMutex {
+    explicit ProfiledMutex(const char* name = "unnamed")
+        : stats(LockStats::Get(name)),
+        depth(0),
+        acquired(0)
+    {}
+
+    void lock()
+    {
+        if (!LockStats::enabled) {
+            base.lock();
+            Acquired(0);
+            return;
+        }
+
+        if (base.try_lock()) {
+            Acquired(LockStats::Now());
+            return;
+        }
+        const auto begin = LockStats::Now();
+        base.lock();
+        const auto now = LockStats::Now();
+        ++stats.numContended;
+        stats.waitNs += now - begin;
+        LockStats::Max(stats.maxWaitNs, now - begin);
+        Acquired(now);
+    }
+
+    bool try_lock()
+    {
+        if (!base.try_lock()) {
+            return false;
+        }
+        Acquired(LockStats::enabled ? LockStats::Now() : 0);
+        return true;
+    }
+
+    void unlock()
+    {
+        if (!--depth && acquired) {
+            const auto hold = LockStats::Now() - acquired;
+            stats.holdNs += hold;
+            LockStats::Max(stats.maxHoldNs, hold);
+        }
+        base.unlock();
+    }
+
+private:
+    void Acquired(uint64_t now)
+    {
+        if (!depth++) {
+            acquired = now;
+            if (now) {
+                ++stats.numAcquired;
+            }
+        }
+    }
+
+    BaseMutex base;
+    LockStats& stats;
+    unsigned depth;
+    uint64_t acquired;
+};
+
+/**
+ * Mutex types used to protect the internal state of the library. Each mutex
+ * can be given a name, under which its contention is reported, if the library
+ * is built with CONFIG_ADSLIB_LOCK_STATS.
+ *
+ * Threads waiting for each other, like a request for its response, use
+ * SignalMutex with ConditionVariable or any mutex with ConditionVariableAny.
+ *
+ * Applications, which only call the library from a single thread, can define
+ * CONFIG_ADSLIB_SINGLE_THREADED to compile all locking and signaling away. This
+ * implies the polling mode, as no internal threads may exist either.
+ */
+#ifdef CONFIG_ADSLIB_SINGLE_THREADED
+struct NullMutex {
+    explicit NullMutex(const char* = nullptr) {}
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+};
+
+/**
+ * No other thread could change the state waited for, so waiting only evaluates
+ * the predicate. Callers poll for progress instead.
+ */
+struct NullConditionVariable {
+    void notify_one() {}
+    void notify_all() {}
+
+    template<class Lock, class Predicate>
+    void wait(Lock&, Predicate) {}
+
+    template<class Lock, class Rep, class Period>
+    std::cv_status wait_for(Lock&, const std::chrono::duration<Rep, Period>&)
+    {
+        return std::cv_status::timeout;
+    }
+
+    template<class Lock, class Rep, class Period, class Predicate>
+    bool wait_for(Lock&, const std::chrono::duration<Rep, Period>&, Predicate pred)
+    {
+        return pred();
+    }
+};
+
+using Mutex = NullMutex;
+using RecursiveMutex = NullMutex;
+using SignalMutex = NullMutex;
+using ConditionVariable = NullConditionVariable;
+using ConditionVariableAny = NullConditionVariable;
+#else
+#ifdef CONFIG_ADSLIB_LOCK_STATS
+using Mutex = ProfiledMutex<std::mutex>;
+using RecursiveMutex = ProfiledMutex<std::recursive_mutex>;
+#else
+template<class BaseMutex>
+struct NamedMutex : BaseMutex {
+    explicit NamedMutex(const char* = nullptr) {}
+};
+
+using Mutex = NamedMutex<std::mutex>;
+using RecursiveMutex = NamedMutex<std::recursive_mutex>;
+#endif
+using SignalMutex = std::mutex;
+using ConditionVariable = std::condition_variable;
+using ConditionVariableAny = std::condition_variable_any;
+#endif
+
+#endif /* #ifndef _LOCK_POLICY_H_ */
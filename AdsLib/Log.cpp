@@ -21,6 +21,7 @@
  */
 
 #include "Log.h"
+#include "Trace.h"
 
 #include <algorithm>
 #include <chrono>
@@ -40,6 +41,13 @@
 #define TIME_T_TO_STRING(DATE_TIME, TIME_T) std::strftime(DATE_TIME, sizeof(DATE_TIME), "%FT%T%z ", localtime(TIME_T));
 #endif
 
+static const char* LEVEL_NAME[] = {
+    "Verbose",
+    "Info",
+    "Warning",
+    "Error"
+};
+
 static const char* CATEGORY[] = {
     "Verbose: ",
     "Info: ",
@@ -49,6 +57,8 @@ static const char* CATEGORY[] = {
 
 void Logger::Log(const size_t level, const std::string& msg)
 {
+    GetTracer().Instant("log", LEVEL_NAME[std::min(level, sizeof(LEVEL_NAME) / sizeof(LEVEL_NAME[0]) - 1)], msg);
+
     std::time_t tt = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
     const auto category = CATEGORY[std::min(level, sizeof(CATEGORY) / sizeof(CATEGORY[0]))];
     char dateTime[28];
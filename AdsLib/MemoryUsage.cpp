@@ -0,0 +1,137 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#include "MemoryUsage.h"
+
+MemoryUsage::MemoryUsage(MemoryUsage* __parent)
+    : parent(__parent)
+{
+    for (auto& b : bytes) {
+        b = 0;
+    }
+}
+
+MemoryUsage::~MemoryUsage()
+{
+    if (parent) {
+        for (size_t i = 0; i < ADS_MEM_COUNT; ++i) {
+            parent->Sub(static_cast<AdsMemoryCategory>(i), bytes[i]);
+        }
+    }
+}
+
+void MemoryUsage::Add(AdsMemoryCategory category, size_t n)
+{
+    bytes[category] += n;
+    if (parent) {
+        parent->Add(category, n);
+    }
+}
+
+void MemoryUsage::Sub(AdsMemoryCategory category, size_t n)
+{
+    bytes[category] -= n;
+    if (parent) {
+        parent->Sub(category, n);
+    }
+}
+
+void MemoryUsage::Update(AdsMemoryCategory category, size_t& accounted, size_t current)
+{
+    if (current > accounted) {
+        Add(category, current - accounted);
+    } else if (current < accounted) {
+        Sub(category, accounted - current);
+    }
+    accounted = current;
+}
+
+void MemoryUsage::Get(AdsMemoryUsage& usage) const
+{
+    for (size_t i = 0; i < ADS_MEM_COUNT; ++i) {
+        usage.bytes[i] = bytes[i];
+    }
+    usage.total = Total();
+    usage.budget = GetMemoryBudget();
+}
+
+uint64_t MemoryUsage::Total() const
+{
+    uint64_t total = 0;
+    for (const auto& b : bytes) {
+        total += b;
+    }
+    return total;
+}
+
+const char* MemoryUsage::Name(AdsMemoryCategory category)
+{
+    static const char* const NAMES[] = {
+        "notification_ring",
+        "response_frames",
+        "request_frames",
+        "notification_buffers",
+        "receive_buffer",
+    };
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == ADS_MEM_COUNT, "missing category name");
+    return NAMES[category];
+}
+
+MemoryCharge::MemoryCharge(AdsMemoryCategory __category, size_t __bytes)
+    : category(__category),
+    bytes(__bytes)
+{
+    GetMemoryUsage().Add(category, bytes);
+}
+
+MemoryCharge::MemoryCharge(const MemoryCharge& ref)
+    : MemoryCharge(ref.category, ref.bytes)
+{}
+
+MemoryCharge::~MemoryCharge()
+{
+    GetMemoryUsage().Sub(category, bytes);
+}
+
+MemoryUsage& GetMemoryUsage()
+{
+    static MemoryUsage* const usage = new MemoryUsage {nullptr};
+    return *usage;
+}
+
+static std::atomic<uint64_t> g_Budget {0};
+
+bool MemoryBudgetFits(size_t bytes)
+{
+    const auto budget = g_Budget.load();
+    return !budget || (GetMemoryUsage().Total() + bytes <= budget);
+}
+
+void SetMemoryBudget(uint64_t bytes)
+{
+    g_Budget = bytes;
+}
+
+uint64_t GetMemoryBudget()
+{
+    return g_Budget;
+}
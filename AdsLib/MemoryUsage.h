@@ -0,0 +1,84 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _MEMORY_USAGE_H_
+#define _MEMORY_USAGE_H_
+
+#include "AdsLib.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+/**
+ * Bytes allocated by the library per AdsMemoryCategory. Usage of a route is
+ * accumulated into its parent, the global usage, too. Whatever is still
+ * accounted, when a MemoryUsage is destroyed, is released from its parent.
+ */
+struct MemoryUsage {
+    explicit MemoryUsage(MemoryUsage* parent);
+    ~MemoryUsage();
+
+    void Add(AdsMemoryCategory category, size_t bytes);
+    void Sub(AdsMemoryCategory category, size_t bytes);
+
+    /**
+     * Account <current> bytes instead of the <accounted> ones, for buffers, which may grow
+     */
+    void Update(AdsMemoryCategory category, size_t& accounted, size_t current);
+    void Get(AdsMemoryUsage& usage) const;
+    uint64_t Total() const;
+
+    static const char* Name(AdsMemoryCategory category);
+
+private:
+    MemoryUsage* const parent;
+    std::array<std::atomic<uint64_t>, ADS_MEM_COUNT> bytes;
+};
+
+/**
+ * Charge a fixed number of bytes for the lifetime of the owning object, copies charge again.
+ */
+struct MemoryCharge {
+    MemoryCharge(AdsMemoryCategory category, size_t bytes);
+    MemoryCharge(const MemoryCharge& ref);
+    ~MemoryCharge();
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+private:
+    const AdsMemoryCategory category;
+    const size_t bytes;
+};
+
+/**
+ * The global usage is never destroyed, so buffers released at exit can still be accounted.
+ */
+MemoryUsage& GetMemoryUsage();
+
+/**
+ * @return true if no budget was set or <bytes> more still fit into it
+ */
+bool MemoryBudgetFits(size_t bytes);
+void SetMemoryBudget(uint64_t bytes);
+uint64_t GetMemoryBudget();
+
+#endif /* #ifndef _MEMORY_USAGE_H_ */
@@ -0,0 +1,92 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#include "Metrics.h"
+
+#include <cstdio>
+#include <cstring>
+
+std::ostream& MetricsWriter::Sample(const char* name, const char* type, const char* help)
+{
+    for (auto& f : families) {
+        if (!strcmp(f->name, name)) {
+            return f->samples;
+        }
+    }
+    families.emplace_back(new Family {name, type, help});
+    return families.back()->samples;
+}
+
+static std::string Braces(const std::string& labels)
+{
+    return labels.empty() ? labels : '{' + labels + '}';
+}
+
+void MetricsWriter::AddCounter(const char* name, const char* help, const std::string& labels, uint64_t value)
+{
+    Sample(name, "counter", help) << name << "_total" << Braces(labels) << ' ' << value << '\n';
+}
+
+void MetricsWriter::AddGauge(const char* name, const char* help, const std::string& labels, uint64_t value)
+{
+    Sample(name, "gauge", help) << name << Braces(labels) << ' ' << value << '\n';
+}
+
+static std::string Seconds(uint64_t ns, const char* format)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), format, ns / 1e9);
+    return buffer;
+}
+
+void MetricsWriter::AddHistogram(const char* name, const char* help, const std::string& labels,
+                                 const AdsHistogram& histogram)
+{
+    // bucket i counts durations in [2^i, 2^(i+1)) ns, the first buckets below 1us are merged
+    static const size_t FIRST_BUCKET = 9;
+
+    auto& os = Sample(name, "histogram", help);
+    const auto prefix = labels.empty() ? labels : labels + ',';
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < ADS_HISTOGRAM_BUCKETS - 1; ++i) {
+        cumulative += histogram.buckets[i];
+        if (i >= FIRST_BUCKET) {
+            os << name << "_bucket{" << prefix << "le=\"" << Seconds(uint64_t {1} << (i + 1), "%g") << "\"} " <<
+                cumulative << '\n';
+        }
+    }
+    os << name << "_bucket{" << prefix << "le=\"+Inf\"} " << histogram.count << '\n';
+    os << name << "_sum" << Braces(labels) << ' ' << Seconds(histogram.sum, "%.9f") << '\n';
+    os << name << "_count" << Braces(labels) << ' ' << histogram.count << '\n';
+}
+
+std::string MetricsWriter::Str() const
+{
+    std::stringstream os;
+    for (const auto& f : families) {
+        os << "# TYPE " << f->name << ' ' << f->type << '\n';
+        os << "# HELP " << f->name << ' ' << f->help << '\n';
+        os << f->samples.str();
+    }
+    os << "# EOF\n";
+    return os.str();
+}
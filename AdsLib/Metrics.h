@@ -0,0 +1,78 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "RequestTimeline.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Always-on counters of one connection
+ */
+struct ConnectionMetrics {
+    std::atomic<uint64_t> numRequests {0};
+    std::atomic<uint64_t> numTimeouts {0};
+    std::atomic<uint64_t> numErrors {0};
+    std::atomic<uint64_t> bytesSent {0};
+    std::atomic<uint64_t> bytesReceived {0};
+    std::atomic<uint64_t> numNotificationFrames {0};
+    std::atomic<uint64_t> numNotificationDrops {0};
+    std::atomic<uint64_t> numConnects {0};
+    Histogram rtt;
+};
+
+/**
+ * Collects samples grouped by metric family and renders them in the
+ * OpenMetrics text format.
+ */
+struct MetricsWriter {
+    void AddCounter(const char* name, const char* help, const std::string& labels, uint64_t value);
+    void AddGauge(const char* name, const char* help, const std::string& labels, uint64_t value);
+
+    /**
+     * Add a histogram of durations in ns, which are exposed in seconds
+     */
+    void AddHistogram(const char* name, const char* help, const std::string& labels, const AdsHistogram& histogram);
+    std::string Str() const;
+
+private:
+    struct Family {
+        Family(const char* __name, const char* __type, const char* __help)
+            : name(__name), type(__type), help(__help)
+        {}
+
+        const char* name;
+        const char* type;
+        const char* help;
+        std::stringstream samples;
+    };
+    std::vector<std::unique_ptr<Family> > families;
+
+    std::ostream& Sample(const char* name, const char* type, const char* help);
+};
+
+#endif /* #ifndef _METRICS_H_ */
@@ -22,18 +22,75 @@
 
 #include "NotificationDispatcher.h"
 #include "Log.h"
+#include "Probes.h"
+#include "Trace.h"
 
-NotificationDispatcher::NotificationDispatcher(AmsProxy& __proxy, VirtualConnection __conn)
+DispatcherMonitor::DispatcherMonitor()
+    : budget(0),
+    highWaterPercent(0),
+    func(nullptr),
+    hUser(0)
+{}
+
+void DispatcherMonitor::Configure(uint32_t budgetUs, uint32_t __highWaterPercent, PAdsDispatcherEventFunc __func,
+                                  uint32_t __hUser)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    func = __func;
+    hUser = __hUser;
+    budget = uint64_t {budgetUs} * 1000;
+    highWaterPercent = std::min<uint32_t>(__highWaterPercent, 100);
+}
+
+void DispatcherMonitor::Raise(const VirtualConnection& conn, AdsDispatcherEvent event, uint32_t hNotify,
+                              uint64_t value)
+{
+    PAdsDispatcherEventFunc callback;
+    uint32_t user;
+    {
+        std::lock_guard<Mutex> lock(mutex);
+        callback = func;
+        user = hUser;
+    }
+    if (callback) {
+        callback(&conn.second, conn.first, event, hNotify, value, user);
+    }
+}
+
+DispatcherMonitor& GetDispatcherMonitor()
+{
+    static DispatcherMonitor monitor;
+    return monitor;
+}
+
+NotificationDispatcher::NotificationDispatcher(AmsProxy& __proxy, VirtualConnection __conn,
+                                               std::shared_ptr<MemoryUsage> __memory, bool __threaded)
     : conn(__conn),
-    ring(4 * 1024 * 1024),
+    ring(RING_SIZE),
+    numNotifications(0),
+    memory(__memory),
     proxy(__proxy),
-    thread(&NotificationDispatcher::Run, this)
-{}
+    threaded(__threaded),
+    running(0),
+    ringHighWater(0),
+    aboveHighWater(false)
+{
+    memory->Add(ADS_MEM_NOTIFICATION_RING, RING_SIZE);
+    if (threaded) {
+        thread = std::thread(&NotificationDispatcher::Run, this);
+    }
+}
 
 NotificationDispatcher::~NotificationDispatcher()
 {
-    sem.Close();
-    thread.join();
+    if (threaded) {
+        sem.Close();
+        thread.join();
+    }
+    memory->Sub(ADS_MEM_NOTIFICATION_RING, RING_SIZE);
+    for (const auto& n : notifications) {
+        memory->Sub(ADS_MEM_NOTIFICATION_BUFFERS, n.second.BufferSize());
+    }
 }
 
 bool NotificationDispatcher::operator<(const NotificationDispatcher& ref) const
@@ -43,42 +100,208 @@ bool NotificationDispatcher::operator<(const NotificationDispatcher& ref) const
 
 void NotificationDispatcher::Emplace(uint32_t hNotify, Notification& notification)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    notifications.emplace(hNotify, notification);
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    if (notifications.emplace(hNotify, notification).second) {
+        numNotifications = notifications.size();
+        memory->Add(ADS_MEM_NOTIFICATION_BUFFERS, notification.BufferSize());
+        std::lock_guard<Mutex> statsLock(statsMutex);
+        costs.emplace(hNotify, notification.cost);
+    }
 }
 
 long NotificationDispatcher::Erase(uint32_t hNotify, uint32_t tmms)
 {
     const auto status = proxy.DeleteNotification(conn.second, hNotify, tmms, conn.first);
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    notifications.erase(hNotify);
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    Remove(hNotify);
     return status;
 }
 
+long NotificationDispatcher::Erase(const std::vector<uint32_t>& handles, uint32_t tmms)
+{
+    const auto status = proxy.DeleteNotifications(conn.second, handles, tmms, conn.first);
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    for (const auto hNotify : handles) {
+        Remove(hNotify);
+    }
+    return status;
+}
+
+void NotificationDispatcher::Remove(uint32_t hNotify)
+{
+    const auto it = notifications.find(hNotify);
+    if (it != notifications.end()) {
+        memory->Sub(ADS_MEM_NOTIFICATION_BUFFERS, it->second.BufferSize());
+        notifications.erase(it);
+        numNotifications = notifications.size();
+        std::lock_guard<Mutex> statsLock(statsMutex);
+        costs.erase(hNotify);
+    }
+}
+
+bool NotificationDispatcher::IsEmpty()
+{
+    return !numNotifications;
+}
+
+bool NotificationDispatcher::GetStats(uint32_t hNotify, AdsCallbackStats& stats)
+{
+    std::lock_guard<Mutex> lock(statsMutex);
+    const auto it = costs.find(hNotify);
+    if (it == costs.end()) {
+        return false;
+    }
+    const auto& cost = *it->second;
+    stats = AdsCallbackStats {conn.second, hNotify, cost.numCalls, cost.total, cost.max, cost.numOverBudget,
+                              ringHighWater};
+    return true;
+}
+
+void NotificationDispatcher::CollectMetrics(MetricsWriter& writer)
+{
+    std::stringstream labels;
+    labels << "port=\"" << conn.first << "\",source=\"" << conn.second.netId << ':' << conn.second.port << '"';
+    writer.AddGauge("ads_notifications", "Registered notifications", labels.str(), numNotifications);
+    writer.AddGauge("ads_notification_ring_size_bytes", "Receive buffer size", labels.str(), RING_SIZE);
+    writer.AddGauge("ads_notification_ring_used_bytes", "Receive buffer usage", labels.str(), ring.BytesAvailable());
+    writer.AddGauge("ads_notification_ring_high_water_bytes", "Max. receive buffer usage", labels.str(),
+                    ringHighWater);
+}
+
+void NotificationDispatcher::CheckHighWater()
+{
+    const auto used = static_cast<uint32_t>(ring.BytesAvailable());
+    if (used > ringHighWater) {
+        ringHighWater = used;
+    }
+
+    const auto percent = GetDispatcherMonitor().highWaterPercent.load();
+    if (!percent) {
+        return;
+    }
+
+    const auto mark = RING_SIZE / 100 * percent;
+    if (!aboveHighWater && (used >= mark)) {
+        aboveHighWater = true;
+        const uint32_t hNotify = running;
+        LOG_WARN("port " << std::dec << conn.first << " receive buffer above " << percent << "% while running 0x" <<
+                 std::hex << hNotify);
+        GetDispatcherMonitor().Raise(conn, ADS_EVENT_RING_HIGH_WATER, hNotify, used);
+    } else if (aboveHighWater && (used < mark / 2)) {
+        aboveHighWater = false;
+    }
+}
+
+void NotificationDispatcher::Notify()
+{
+    CheckHighWater();
+    if (threaded) {
+        sem.Post();
+    } else {
+        Dispatch();
+    }
+}
+
 void NotificationDispatcher::Run()
 {
+    std::stringstream name;
+    name << "AdsDispatcher " << conn.second.netId << ':' << conn.second.port << " -> " << conn.first;
+    GetTracer().SetThreadName(name.str());
     while (sem.Wait()) {
-        const auto length = ring.ReadFromLittleEndian<uint32_t>();
-        (void)length;
-        const auto numStamps = ring.ReadFromLittleEndian<uint32_t>();
-        for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
-            const auto timestamp = ring.ReadFromLittleEndian<uint64_t>();
-            const auto numSamples = ring.ReadFromLittleEndian<uint32_t>();
-            for (uint32_t sample = 0; sample < numSamples; ++sample) {
-                const auto hNotify = ring.ReadFromLittleEndian<uint32_t>();
-                const auto size = ring.ReadFromLittleEndian<uint32_t>();
-                std::lock_guard<std::recursive_mutex> lock(mutex);
-                auto it = notifications.find(hNotify);
+        Dispatch();
+    }
+}
+
+/**
+ * A frame is: uint32_t length, uint32_t numStamps and for each stamp a uint64_t
+ * timestamp, uint32_t numSamples and for each sample uint32_t hNotify, uint32_t
+ * size and size bytes of data. Devices disagree whether the leading length
+ * includes itself, so only the sample headers are checked against the frame size.
+ */
+bool NotificationDispatcher::IsValidFrame(const RingBuffer& ring, const uint8_t* frame, uint32_t length)
+{
+    uint64_t pos = 2 * sizeof(uint32_t);
+    if (pos > length) {
+        return false;
+    }
+    const auto numStamps = ring.PeekFromLittleEndian<uint32_t>(ring.Next(frame, sizeof(uint32_t)));
+    for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
+        if (pos + sizeof(uint64_t) + sizeof(uint32_t) > length) {
+            return false;
+        }
+        const auto numSamples = ring.PeekFromLittleEndian<uint32_t>(ring.Next(frame, pos + sizeof(uint64_t)));
+        pos += sizeof(uint64_t) + sizeof(uint32_t);
+        for (uint32_t sample = 0; sample < numSamples; ++sample) {
+            if (pos + 2 * sizeof(uint32_t) > length) {
+                return false;
+            }
+            pos += 2 * sizeof(uint32_t) + ring.PeekFromLittleEndian<uint32_t>(ring.Next(frame, pos + sizeof(uint32_t)));
+            if (pos > length) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t NotificationDispatcher::Dispatch()
+{
+    auto& tracer = GetTracer();
+    const auto begin = tracer.Begin();
+
+    // records committed while this batch runs are left for the next wakeup
+    const uint8_t* const end = ring.write.load(std::memory_order_acquire);
+    size_t numRecords = 0;
+    while (ring.read.load(std::memory_order_relaxed) != end) {
+        DispatchRecord(ring.RecordPayload(ring.read.load(std::memory_order_relaxed)));
+        ring.ReadRecord();
+        ++numRecords;
+    }
+    tracer.Complete("notification", "dispatch", begin, conn.first);
+    return numRecords;
+}
+
+void NotificationDispatcher::DispatchRecord(const uint8_t* frame)
+{
+    auto& tracer = GetTracer();
+    std::lock_guard<RecursiveMutex> lock(mutex);
+    const auto numStamps = ring.PeekFromLittleEndian<uint32_t>(ring.Next(frame, sizeof(uint32_t)));
+    auto pos = ring.Next(frame, 2 * sizeof(uint32_t));
+    for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
+        const auto timestamp = ring.PeekFromLittleEndian<uint64_t>(pos);
+        const auto numSamples = ring.PeekFromLittleEndian<uint32_t>(ring.Next(pos, sizeof(uint64_t)));
+        pos = ring.Next(pos, sizeof(uint64_t) + sizeof(uint32_t));
+        for (uint32_t sample = 0; sample < numSamples; ++sample) {
+            const auto hNotify = ring.PeekFromLittleEndian<uint32_t>(pos);
+            const auto size = ring.PeekFromLittleEndian<uint32_t>(ring.Next(pos, sizeof(uint32_t)));
+            const auto data = ring.Next(pos, 2 * sizeof(uint32_t));
+            pos = ring.Next(data, size);
+            auto it = notifications.find(hNotify);
+            if (it != notifications.end()) {
+                auto& notification = it->second;
+                if (size != notification.Size()) {
+                    LOG_WARN("Notification sample size: " << size << " doesn't match: " << notification.Size());
+                    continue;
+                }
+                running = hNotify;
+                const auto callback = RequestTimeline::Now();
+                ADS_PROBE3(callback_entry, hNotify, conn.first, size);
+                notification.Notify(timestamp, ring, data);
+                ADS_PROBE3(callback_exit, hNotify, conn.first, size);
+                const auto end = RequestTimeline::Now();
+                running = 0;
+                tracer.Complete("notification", "callback", callback, end, hNotify, 0, {});
+
+                const auto duration = end - callback;
+                const auto budget = GetDispatcherMonitor().budget.load();
+                const bool overBudget = budget && (duration > budget);
+                // the callback might have added or deleted notifications
+                it = notifications.find(hNotify);
                 if (it != notifications.end()) {
-                    auto& notification = it->second;
-                    if (size != notification.Size()) {
-                        LOG_WARN("Notification sample size: " << size << " doesn't match: " << notification.Size());
-                        ring.Read(size);
-                        return;
-                    }
-                    notification.Notify(timestamp, ring);
-                } else {
-                    ring.Read(size);
+                    it->second.cost->Add(duration, overBudget);
+                }
+                if (overBudget) {
+                    GetDispatcherMonitor().Raise(conn, ADS_EVENT_SLOW_CALLBACK, hNotify, duration);
                 }
             }
         }
@@ -23,33 +23,103 @@
 #ifndef _NOTIFICATION_DISPATCHER_H_
 #define _NOTIFICATION_DISPATCHER_H_
 
+#include "AdsLib.h"
 #include "AdsNotification.h"
 #include "AmsHeader.h"
+#include "FlatMap.h"
+#include "LockPolicy.h"
+#include "MemoryUsage.h"
+#include "Metrics.h"
 #include "Semaphore.h"
 
-#include <map>
+#include <atomic>
 #include <thread>
+#include <vector>
 
 struct AmsProxy {
     virtual long DeleteNotification(const AmsAddr& amsAddr, uint32_t hNotify, uint32_t tmms, uint16_t port) = 0;
+    virtual long DeleteNotifications(const AmsAddr& amsAddr, const std::vector<uint32_t>& handles, uint32_t tmms,
+                                     uint16_t port) = 0;
 };
 
+/**
+ * Slow callback and receive buffer high-water detection shared by all dispatchers
+ */
+struct DispatcherMonitor {
+    DispatcherMonitor();
+    void Configure(uint32_t budgetUs, uint32_t highWaterPercent, PAdsDispatcherEventFunc func, uint32_t hUser);
+    void Raise(const VirtualConnection& conn, AdsDispatcherEvent event, uint32_t hNotify, uint64_t value);
+
+    std::atomic<uint64_t> budget;
+    std::atomic<uint32_t> highWaterPercent;
+private:
+    Mutex mutex {"DispatcherMonitor::mutex"};
+    PAdsDispatcherEventFunc func;
+    uint32_t hUser;
+};
+
+DispatcherMonitor& GetDispatcherMonitor();
+
 struct NotificationDispatcher {
-    NotificationDispatcher(AmsProxy& __proxy, VirtualConnection __conn);
+    static const size_t RING_SIZE = 4 * 1024 * 1024;
+
+    NotificationDispatcher(AmsProxy& __proxy, VirtualConnection __conn, std::shared_ptr<MemoryUsage> memory,
+                           bool threaded = true);
     ~NotificationDispatcher();
     bool operator<(const NotificationDispatcher& ref) const;
     void Emplace(uint32_t hNotify, Notification& notification);
     long Erase(uint32_t hNotify, uint32_t tmms);
-    inline void Notify() { sem.Post(); }
+
+    /**
+     * Delete many notifications with as few requests as possible
+     */
+    long Erase(const std::vector<uint32_t>& handles, uint32_t tmms);
+    bool IsEmpty();
+    bool GetStats(uint32_t hNotify, AdsCallbackStats& stats);
+    void CollectMetrics(MetricsWriter& writer);
+
+    /**
+     * Check that the sample headers of a notification frame stored in ring are
+     * consistent with its length, before it is committed as a record.
+     */
+    static bool IsValidFrame(const RingBuffer& ring, const uint8_t* frame, uint32_t length);
+
+    /**
+     * Called by the receiver after a notification record was committed to the ring
+     */
+    void Notify();
     void Run();
 
+    /**
+     * Invoke the callbacks for all records committed to the ring so far
+     * @return number of records dispatched
+     */
+    size_t Dispatch();
+
     const VirtualConnection conn;
     RingBuffer ring;
 private:
-    std::map<uint32_t, Notification> notifications;
-    std::recursive_mutex mutex;
+    void CheckHighWater();
+    void DispatchRecord(const uint8_t* frame);
+    void Remove(uint32_t hNotify);
+
+    FlatMap<uint32_t, Notification> notifications;
+    std::atomic<size_t> numNotifications; // notifications.size() for readers, which must not wait for callbacks
+    const std::shared_ptr<MemoryUsage> memory;
+    RecursiveMutex mutex {"NotificationDispatcher::mutex"};
+
+    /**
+     * The callback statistics of all notifications. Kept apart from notifications,
+     * so GetStats() doesn't wait for running callbacks.
+     */
+    FlatMap<uint32_t, std::shared_ptr<CallbackCost> > costs;
+    Mutex statsMutex {"NotificationDispatcher::statsMutex"};
     AmsProxy& proxy;
+    const bool threaded;
     Semaphore sem;
+    std::atomic<uint32_t> running;
+    std::atomic<uint32_t> ringHighWater;
+    bool aboveHighWater;
     std::thread thread;
 };
 
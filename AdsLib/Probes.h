@@ -0,0 +1,60 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+/**
+ * Statically defined tracepoints (USDT) of provider "adslib" for bpftrace, perf
+ * or SystemTap. On Linux they are compiled in, whenever <sys/sdt.h>
+ * (systemtap-sdt-dev) is available. CONFIG_ADSLIB_USDT enforces them,
+ * CONFIG_ADSLIB_NO_USDT leaves them out. A probe nobody is attached to costs a
+ * nop and the loads of its arguments.
+ *
+ * write_begin(invokeId, port, length, cmdId)        request frame about to be sent
+ * write_end(invokeId, port, bytesWritten, cmdId)    request frame sent
+ * frame_parsed(invokeId, port, length, cmdId)       AoE header of a received frame parsed
+ * response_matched(invokeId, port, length, cmdId)   response handed to the waiting request
+ * response_mismatched(invokeId, port, length, cmdId) response without pending request dropped
+ * notification_overflow(port, length, bytesFree)    notification frame dropped, ring is full
+ * callback_entry(hNotify, port, length)             notification sample taken from the ring, before
+ *                                                   the user callback is invoked
+ * callback_exit(hNotify, port, length)              after the user callback returned
+ *
+ * e.g.: bpftrace -e 'usdt:./example.bin:adslib:write_begin { @[arg3] = count(); }'
+ */
+#if !defined(CONFIG_ADSLIB_USDT) && !defined(CONFIG_ADSLIB_NO_USDT) && defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define CONFIG_ADSLIB_USDT
+#endif
+#endif
+
+#ifdef CONFIG_ADSLIB_USDT
+#include <sys/sdt.h>
+#define ADS_PROBE3(NAME, A1, A2, A3) DTRACE_PROBE3(adslib, NAME, A1, A2, A3)
+#define ADS_PROBE4(NAME, A1, A2, A3, A4) DTRACE_PROBE4(adslib, NAME, A1, A2, A3, A4)
+#else
+#define ADS_PROBE3(NAME, A1, A2, A3) do {} while (0)
+#define ADS_PROBE4(NAME, A1, A2, A3, A4) do {} while (0)
+#endif
+
+#endif /* #ifndef _PROBES_H_ */
@@ -0,0 +1,148 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#include "RequestTimeline.h"
+
+#include <algorithm>
+
+Histogram::Histogram()
+{
+    Reset();
+}
+
+void Histogram::Add(uint64_t value)
+{
+    size_t bucket = 0;
+    for (auto v = value >> 1; v && (bucket < ADS_HISTOGRAM_BUCKETS - 1); v >>= 1) {
+        ++bucket;
+    }
+    ++buckets[bucket];
+    ++count;
+    sum += value;
+}
+
+void Histogram::Get(AdsHistogram& histogram) const
+{
+    histogram.count = count;
+    histogram.sum = sum;
+    for (size_t i = 0; i < ADS_HISTOGRAM_BUCKETS; ++i) {
+        histogram.buckets[i] = buckets[i];
+    }
+}
+
+void Histogram::Reset()
+{
+    count = 0;
+    sum = 0;
+    for (auto& b : buckets) {
+        b = 0;
+    }
+}
+
+RequestTimeline::RequestTimeline()
+    : enabled(false),
+    sampleInterval(0),
+    numRequests(0),
+    nextSample(0)
+{}
+
+void RequestTimeline::Enable(bool enable, uint32_t interval)
+{
+    sampleInterval = interval;
+    enabled = enable;
+}
+
+void RequestTimeline::Reset()
+{
+    for (auto& s : stages) {
+        s.Reset();
+    }
+    std::lock_guard<Mutex> lock(mutex);
+    samples.clear();
+    nextSample = 0;
+    numRequests = 0;
+}
+
+static uint32_t Duration(uint64_t from, uint64_t to)
+{
+    if (!from || !to || (to < from)) {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(to - from, UINT32_MAX));
+}
+
+void RequestTimeline::Record(const AmsAddr& target, uint16_t port, uint16_t cmdId, long result, uint64_t start,
+                             const RequestTimestamps& timestamps, uint64_t woken)
+{
+    if (!start || !enabled) {
+        return;
+    }
+
+    AdsRequestTiming timing {target, port, cmdId, timestamps.invokeId, result, start, {}};
+    timing.stages[ADS_STAGE_QUEUE] = Duration(start, timestamps.reserved);
+    timing.stages[ADS_STAGE_SEND] = Duration(timestamps.reserved, timestamps.sent);
+    timing.stages[ADS_STAGE_WIRE] = Duration(timestamps.sent, timestamps.received);
+    timing.stages[ADS_STAGE_PARSE] = Duration(timestamps.received, timestamps.parsed);
+    timing.stages[ADS_STAGE_WAKE] = Duration(timestamps.parsed, woken);
+
+    if (woken) {
+        for (size_t i = 0; i < ADS_STAGE_COUNT; ++i) {
+            stages[i].Add(timing.stages[i]);
+        }
+    }
+
+    const auto interval = sampleInterval.load();
+    if (!interval || (numRequests++ % interval)) {
+        return;
+    }
+
+    std::lock_guard<Mutex> lock(mutex);
+    if (samples.size() < NUM_SAMPLES_MAX) {
+        samples.push_back(timing);
+    } else {
+        samples[nextSample] = timing;
+    }
+    nextSample = (nextSample + 1) % NUM_SAMPLES_MAX;
+}
+
+void RequestTimeline::GetHistogram(AdsRequestStage stage, AdsHistogram& histogram) const
+{
+    stages[stage].Get(histogram);
+}
+
+uint32_t RequestTimeline::GetSamples(AdsRequestTiming* timings, uint32_t capacity)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    const auto oldest = (samples.size() < NUM_SAMPLES_MAX) ? 0 : nextSample;
+    const auto num = std::min<size_t>(capacity, samples.size());
+    const auto first = samples.size() - num;
+    for (size_t i = 0; i < num; ++i) {
+        timings[i] = samples[(oldest + first + i) % samples.size()];
+    }
+    return num;
+}
+
+RequestTimeline& GetRequestTimeline()
+{
+    static RequestTimeline timeline;
+    return timeline;
+}
@@ -0,0 +1,95 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _REQUEST_TIMELINE_H_
+#define _REQUEST_TIMELINE_H_
+
+#include "AdsLib.h"
+#include "LockPolicy.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+struct Histogram {
+    Histogram();
+    void Add(uint64_t value);
+    void Get(AdsHistogram& histogram) const;
+    void Reset();
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::array<std::atomic<uint64_t>, ADS_HISTOGRAM_BUCKETS> buckets;
+};
+
+/**
+ * Timestamps collected while a request is in flight, 0 if a stage wasn't reached
+ */
+struct RequestTimestamps {
+    uint32_t invokeId = 0;
+    uint64_t reserved = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t parsed = 0;
+};
+
+struct RequestTimeline {
+    static const size_t NUM_SAMPLES_MAX = 1024;
+
+    RequestTimeline();
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @return current time, if the timeline is enabled, otherwise 0
+     */
+    uint64_t Start() const
+    {
+        return enabled ? Now() : 0;
+    }
+
+    void Enable(bool enable, uint32_t sampleInterval);
+    void Reset();
+    void Record(const AmsAddr& target, uint16_t port, uint16_t cmdId, long result, uint64_t start,
+                const RequestTimestamps& timestamps, uint64_t woken);
+    void GetHistogram(AdsRequestStage stage, AdsHistogram& histogram) const;
+    uint32_t GetSamples(AdsRequestTiming* timings, uint32_t capacity);
+
+    std::atomic<bool> enabled;
+private:
+    std::atomic<uint32_t> sampleInterval;
+    std::atomic<uint64_t> numRequests;
+    std::array<Histogram, ADS_STAGE_COUNT> stages;
+    Mutex mutex {"RequestTimeline::mutex"};
+    std::vector<AdsRequestTiming> samples;
+    size_t nextSample;
+};
+
+RequestTimeline& GetRequestTimeline();
+
+#endif /* #ifndef _REQUEST_TIMELINE_H_ */
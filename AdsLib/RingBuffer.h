@@ -23,10 +23,18 @@
 #ifndef _RING_BUFFER_H_
 #define _RING_BUFFER_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 
+/**
+ * Single producer, single consumer ring. The producer publishes data by storing
+ * write with release semantics, the consumer releases space by storing read the
+ * same way. Both sides load the pointer of the other side with acquire semantics.
+ */
 struct RingBuffer {
     RingBuffer(size_t N)
         : dataSize(N + 1),
@@ -37,7 +45,9 @@ struct RingBuffer {
 
     size_t BytesFree() const
     {
-        return (write < read) ? read - write - 1 : dataSize - 1 - (write - read);
+        const uint8_t* const w = write.load(std::memory_order_acquire);
+        const uint8_t* const r = read.load(std::memory_order_acquire);
+        return (w < r) ? r - w - 1 : dataSize - 1 - (w - r);
     }
 
     size_t BytesAvailable() const
@@ -47,41 +57,122 @@ struct RingBuffer {
 
     size_t WriteChunk() const
     {
-        return (write < read) ? read - write - 1 : data.get() + dataSize - write - (data.get() == read);
+        const uint8_t* const w = write.load(std::memory_order_acquire);
+        const uint8_t* const r = read.load(std::memory_order_acquire);
+        return (w < r) ? r - w - 1 : data.get() + dataSize - w - (data.get() == r);
     }
 
     void Write(size_t n)
     {
         assert(n <= BytesFree());
-        write = Increment(write, n);
+        write.store(Increment(write.load(std::memory_order_relaxed), n), std::memory_order_release);
     }
 
     template<class T> T ReadFromLittleEndian()
     {
+        const auto result = PeekFromLittleEndian<T>(read.load(std::memory_order_relaxed));
+        Read(sizeof(T));
+        return result;
+    }
+
+    void Read(size_t n)
+    {
+        assert(n <= BytesAvailable());
+        read.store(Increment(read.load(std::memory_order_relaxed), n), std::memory_order_release);
+    }
+
+    /**
+     * Position n bytes behind ptr, wrapped around the end of the buffer
+     */
+    uint8_t* Next(const uint8_t* ptr, size_t n) const
+    {
+        return Increment(ptr, n);
+    }
+
+    /**
+     * Number of bytes between ptr and the end of the buffer
+     */
+    size_t Contiguous(const uint8_t* ptr) const
+    {
+        return data.get() + dataSize - ptr;
+    }
+
+    /**
+     * Copy n bytes starting at ptr, wrapped around the end of the buffer
+     */
+    void Copy(void* dest, const uint8_t* ptr, size_t n) const
+    {
+        const auto first = std::min(n, Contiguous(ptr));
+        memcpy(dest, ptr, first);
+        memcpy(static_cast<uint8_t*>(dest) + first, data.get(), n - first);
+    }
+
+    template<class T> T PeekFromLittleEndian(const uint8_t* ptr) const
+    {
+        uint8_t bytes[sizeof(T)];
+        Copy(bytes, ptr, sizeof(bytes));
         T result = 0;
         for (size_t i = 0; i < sizeof(T); ++i) {
-            result += (((T)(*read)) << (8 * i));
-            read = Increment(read, 1);
+            result += (((T)bytes[i]) << (8 * i));
         }
         return result;
     }
 
-    void Read(size_t n)
+    /**
+     * Records are a uint32_t length followed by that many bytes. The writer stores
+     * the payload at RecordPayload(write) first and then commits the whole record
+     * at once, so a reader never sees a partial record.
+     */
+    static const size_t RECORD_HEADER_SIZE = sizeof(uint32_t);
+
+    bool RecordFits(size_t length) const
     {
-        assert(n <= BytesAvailable());
-        read = Increment(read, n);
+        return RECORD_HEADER_SIZE + length <= BytesFree();
+    }
+
+    uint8_t* RecordPayload(const uint8_t* record) const
+    {
+        return Increment(record, RECORD_HEADER_SIZE);
+    }
+
+    /**
+     * Producer only: publish the record at write, including its payload
+     */
+    void CommitRecord(uint32_t length)
+    {
+        const auto record = write.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < RECORD_HEADER_SIZE; ++i) {
+            *Increment(record, i) = static_cast<uint8_t>(length >> (8 * i));
+        }
+        Write(RECORD_HEADER_SIZE + length);
+    }
+
+    /**
+     * Consumer only: length of the record at read
+     */
+    uint32_t RecordLength() const
+    {
+        return PeekFromLittleEndian<uint32_t>(read.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * Drop the record at read, no matter how much of its payload was consumed
+     */
+    void ReadRecord()
+    {
+        Read(RECORD_HEADER_SIZE + RecordLength());
     }
 
 private:
     const size_t dataSize;
     const std::unique_ptr<uint8_t[]> data;
 
-    inline uint8_t* Increment(const uint8_t* ptr, size_t n)
+    inline uint8_t* Increment(const uint8_t* ptr, size_t n) const
     {
         return data.get() + ((ptr - data.get() + n) % dataSize);
     }
 public:
-    uint8_t* write;
-    const uint8_t* read;
+    std::atomic<uint8_t*> write;
+    std::atomic<const uint8_t*> read;
 };
 #endif /* #ifndef _RING_BUFFER_H_ */
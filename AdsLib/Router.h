@@ -31,5 +31,11 @@ struct Router {
     static_assert(NUM_PORTS_MAX + PORT_BASE <= UINT16_MAX, "Port limit is out of range");
 
     virtual long GetLocalAddress(uint16_t port, AmsAddr* pAddr) = 0;
+
+    /**
+     * Polling mode only: a connection was opened or closed, so the set of
+     * file descriptors returned by AmsRouter::GetPollFds() changed.
+     */
+    virtual void PollFdsChanged() = 0;
 };
 #endif /* #ifndef _ROUTER_H_ */
@@ -23,13 +23,12 @@
 #ifndef _SEMAPHORE_H_
 #define _SEMAPHORE_H_
 
-#include <condition_variable>
-#include <mutex>
+#include "LockPolicy.h"
 
 struct Semaphore {
     void Post()
     {
-        std::unique_lock<std::mutex> lock(mutex);
+        std::unique_lock<SignalMutex> lock(mutex);
         ++count;
         cv.notify_one();
     }
@@ -42,7 +41,7 @@ struct Semaphore {
 
     bool Wait()
     {
-        std::unique_lock<std::mutex> lock(mutex);
+        std::unique_lock<SignalMutex> lock(mutex);
         cv.wait(lock, [&](){return count > 0; });
         --count;
         return isOpen;
@@ -51,7 +50,7 @@ struct Semaphore {
 private:
     bool isOpen = true;
     int count = 0;
-    std::mutex mutex;
-    std::condition_variable cv;
+    SignalMutex mutex;
+    ConditionVariable cv;
 };
 #endif /* #ifndef _SEMAPHORE_H_ */
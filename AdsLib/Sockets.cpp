@@ -47,6 +47,12 @@ bool IpV4::operator==(const IpV4& ref) const
     return value == ref.value;
 }
 
+std::ostream& operator<<(std::ostream& os, const IpV4& ip)
+{
+    return os << std::dec << (ip.value >> 24) << '.' << ((ip.value >> 16) & 0xff) << '.' <<
+           ((ip.value >> 8) & 0xff) << '.' << (ip.value & 0xff);
+}
+
 Socket::Socket(IpV4 ip, uint16_t port, int type)
     : m_WSAInitialized(!InitSocketLibrary()),
     m_Socket(socket(AF_INET, type, 0)),
@@ -76,6 +82,11 @@ void Socket::Shutdown()
     shutdown(m_Socket, SHUT_RDWR);
 }
 
+SOCKET Socket::NativeHandle() const
+{
+    return m_Socket;
+}
+
 size_t Socket::read(uint8_t* buffer, size_t maxBytes, timeval* timeout) const
 {
     if (!Select(timeout)) {
@@ -107,6 +118,40 @@ Frame& Socket::read(Frame& frame, timeval* timeout) const
 
 bool Socket::Select(timeval* timeout) const
 {
+    /* a zero timeout only checks for pending data, so don't complain about it */
+    const bool isPoll = timeout && !timeout->tv_sec && !timeout->tv_usec;
+
+#ifdef NATIVE_POLL
+    /* unlike FD_SET(), poll() works for descriptors above FD_SETSIZE, which processes with many routes reach */
+    pollfd readSocket = { m_Socket, POLLIN, 0 };
+    int timeoutMs = -1;
+    if (timeout) {
+        /* round up, so a short timeout doesn't turn into a busy loop */
+        const auto ms = static_cast<int64_t>(timeout->tv_sec) * 1000 + (timeout->tv_usec + 999) / 1000;
+        timeoutMs = static_cast<int>(std::min<int64_t>(INT_MAX, ms));
+    }
+
+    /* wait for receive data */
+    const int state = NATIVE_POLL(&readSocket, 1, timeoutMs);
+    if (0 == state) {
+        if (!isPoll) {
+            LOG_ERROR("poll() timeout");
+        }
+        return false;
+    }
+
+    if (readSocket.revents & POLLNVAL) {
+        throw std::runtime_error("connection closed");
+    }
+
+    /* hangups and errors are reported by the following recv() */
+    if ((1 != state) || !(readSocket.revents & (POLLIN | POLLHUP | POLLERR))) {
+        LOG_ERROR("something strange happen while waiting for socket... with error: " << WSAGetLastError() <<
+                  " state: " << state);
+        return false;
+    }
+    return true;
+#else
     /* prepare socket set for select() */
     fd_set readSockets;
     FD_ZERO(&readSockets);
@@ -115,7 +160,9 @@ bool Socket::Select(timeval* timeout) const
     /* wait for receive data */
     const int state = NATIVE_SELECT(m_Socket + 1, &readSockets, nullptr, nullptr, timeout);
     if (0 == state) {
-        LOG_ERROR("select() timeout");
+        if (!isPoll) {
+            LOG_ERROR("select() timeout");
+        }
         return false;
     }
 
@@ -131,6 +178,7 @@ bool Socket::Select(timeval* timeout) const
         return false;
     }
     return true;
+#endif
 }
 
 size_t Socket::write(const Frame& frame) const
@@ -25,6 +25,7 @@
 
 #include "Frame.h"
 #include "wrap_socket.h"
+#include <ostream>
 #include <string>
 
 struct IpV4 {
@@ -34,12 +35,14 @@ struct IpV4 {
     bool operator<(const IpV4& ref) const;
     bool operator==(const IpV4& ref) const;
 };
+std::ostream& operator<<(std::ostream& os, const IpV4& ip);
 
 struct Socket {
     Frame& read(Frame& frame, timeval* timeout) const;
     size_t read(uint8_t* buffer, size_t maxBytes, timeval* timeout) const;
     size_t write(const Frame& frame) const;
     void Shutdown();
+    SOCKET NativeHandle() const;
 
 protected:
     int m_WSAInitialized;
@@ -0,0 +1,262 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+Tracer::Tracer()
+    : enabled(false),
+    capacity(DEFAULT_CAPACITY),
+    next(0),
+    session(0),
+    exitHandlerInstalled(false)
+{}
+
+static void DumpAtExit()
+{
+    GetTracer().Stop();
+}
+
+void Tracer::Start(size_t __capacity, const std::string& __exitPath)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    capacity = __capacity ? __capacity : DEFAULT_CAPACITY;
+    events.clear();
+    events.reserve(capacity);
+    next = 0;
+    // threads still running register their names again with their next event
+    threadNames.clear();
+    ++session;
+    exitPath = __exitPath;
+    if (!exitPath.empty() && !exitHandlerInstalled) {
+        exitHandlerInstalled = !std::atexit(DumpAtExit);
+    }
+    enabled = true;
+}
+
+void Tracer::Stop()
+{
+    enabled = false;
+    std::string path;
+    {
+        std::lock_guard<Mutex> lock(mutex);
+        path.swap(exitPath);
+    }
+    if (!path.empty()) {
+        Dump(path);
+    }
+}
+
+/**
+ * Trace id and name of a thread. session is the trace session, in which the name
+ * was registered, 0 if never.
+ */
+struct Tracer::ThreadState {
+    const uint32_t id;
+    std::string name;
+    uint64_t session;
+
+    ThreadState()
+        : id(NextId()),
+        session(0)
+    {}
+
+    ~ThreadState()
+    {
+        if (session) {
+            GetTracer().ThreadExit(*this);
+        }
+    }
+
+    static uint32_t NextId()
+    {
+        static std::atomic<uint32_t> nextId {1};
+        return nextId++;
+    }
+};
+
+Tracer::ThreadState& Tracer::Self()
+{
+    thread_local ThreadState self;
+    return self;
+}
+
+uint32_t Tracer::ThreadId()
+{
+    return Self().id;
+}
+
+void Tracer::Add(TraceEvent&& event)
+{
+    auto& self = Self();
+    std::lock_guard<Mutex> lock(mutex);
+    if ((self.session != session) && !self.name.empty()) {
+        threadNames[self.id] = self.name;
+        self.session = session;
+    }
+    if (events.size() < capacity) {
+        events.push_back(std::move(event));
+    } else {
+        events[next] = std::move(event);
+    }
+    next = (next + 1) % capacity;
+}
+
+void Tracer::Complete(const char* category, const char* name, uint64_t start, uint32_t id, long result,
+                      const std::string& text)
+{
+    if (start) {
+        Complete(category, name, start, RequestTimeline::Now(), id, result, text);
+    }
+}
+
+void Tracer::Complete(const char* category, const char* name, uint64_t start, uint64_t end, uint32_t id,
+                      long result, const std::string& text)
+{
+    if (!enabled || !start) {
+        return;
+    }
+    Add(TraceEvent {category, name, 'X', ThreadId(), start, (end > start) ? end - start : 0, id, result, text});
+}
+
+void Tracer::Instant(const char* category, const char* name, const std::string& text)
+{
+    if (!enabled) {
+        return;
+    }
+    Add(TraceEvent {category, name, 'i', ThreadId(), RequestTimeline::Now(), 0, 0, 0, text});
+}
+
+void Tracer::SetThreadName(const std::string& name)
+{
+    auto& self = Self();
+    std::lock_guard<Mutex> lock(mutex);
+    self.name = name;
+    if (self.session && (self.session == session)) {
+        threadNames[self.id] = name;
+    }
+}
+
+void Tracer::ThreadExit(const ThreadState& self)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    if (self.session != session) {
+        return;
+    }
+    // the name is still needed to dump events of the thread
+    for (const auto& e : events) {
+        if (e.tid == self.id) {
+            return;
+        }
+    }
+    threadNames.erase(self.id);
+}
+
+static void WriteJsonString(std::ostream& os, const std::string& text)
+{
+    os << '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            os << "\\\"";
+            break;
+
+        case '\\':
+            os << "\\\\";
+            break;
+
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                os << escaped;
+            } else {
+                os << c;
+            }
+        }
+    }
+    os << '"';
+}
+
+static void WriteMicroseconds(std::ostream& os, uint64_t ns)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llu.%03u", static_cast<unsigned long long>(ns / 1000),
+             static_cast<unsigned>(ns % 1000));
+    os << buffer;
+}
+
+void Tracer::Dump(std::ostream& os)
+{
+    std::lock_guard<Mutex> lock(mutex);
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& thread : threadNames) {
+        os << (first ? "\n" : ",\n");
+        first = false;
+        os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first << ",\"args\":{\"name\":";
+        WriteJsonString(os, thread.second);
+        os << "}}";
+    }
+
+    const auto oldest = (events.size() < capacity) ? 0 : next;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const auto& e = events[(oldest + i) % events.size()];
+        os << (first ? "\n" : ",\n");
+        first = false;
+        os << "{\"cat\":\"" << e.category << "\",\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+           << "\",\"pid\":1,\"tid\":" << e.tid << ",\"ts\":";
+        WriteMicroseconds(os, e.start);
+        if ('X' == e.phase) {
+            os << ",\"dur\":";
+            WriteMicroseconds(os, e.duration);
+        } else {
+            os << ",\"s\":\"t\"";
+        }
+        os << ",\"args\":{\"id\":" << e.id << ",\"result\":" << e.result;
+        if (!e.text.empty()) {
+            os << ",\"text\":";
+            WriteJsonString(os, e.text);
+        }
+        os << "}}";
+    }
+    os << "\n]}\n";
+}
+
+bool Tracer::Dump(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    Dump(file);
+    return static_cast<bool>(file);
+}
+
+Tracer& GetTracer()
+{
+    static Tracer* const tracer = new Tracer;
+    return *tracer;
+}
@@ -0,0 +1,115 @@
+/**
+   Copyright (c) 2015 Beckhoff Automation GmbH & Co. KG
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "LockPolicy.h"
+#include "RequestTimeline.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    char phase;
+    uint32_t tid;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t id;
+    long result;
+    std::string text;
+};
+
+/**
+ * Bounded in-memory record of library activity, which can be dumped in the
+ * Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+ */
+struct Tracer {
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    Tracer();
+
+    /**
+     * @return current time, if tracing is enabled, otherwise 0
+     */
+    uint64_t Begin() const
+    {
+        return enabled ? RequestTimeline::Now() : 0;
+    }
+
+    void Start(size_t capacity, const std::string& exitPath);
+    void Stop();
+
+    /**
+     * Record a span, which began at start and ends now. Nothing is recorded if start is 0.
+     */
+    void Complete(const char* category, const char* name, uint64_t start, uint32_t id = 0, long result = 0,
+                  const std::string& text = {});
+    void Complete(const char* category, const char* name, uint64_t start, uint64_t end, uint32_t id, long result,
+                  const std::string& text);
+    void Instant(const char* category, const char* name, const std::string& text);
+
+    /**
+     * Name the calling thread in the trace. The name is kept by the thread and only
+     * registered with the first event it records after Start(). Once the thread
+     * exits, the name is dropped together with its last event.
+     */
+    void SetThreadName(const std::string& name);
+    void Dump(std::ostream& os);
+    bool Dump(const std::string& path);
+
+    std::atomic<bool> enabled;
+private:
+    struct ThreadState;
+    static ThreadState& Self();
+    static uint32_t ThreadId();
+    void Add(TraceEvent&& event);
+    void ThreadExit(const ThreadState& self);
+
+    Mutex mutex {"Tracer::mutex"};
+    std::vector<TraceEvent> events;
+    size_t capacity;
+    size_t next;
+    uint64_t session;
+    std::map<uint32_t, std::string> threadNames;
+    std::string exitPath;
+    bool exitHandlerInstalled;
+};
+
+/**
+ * The tracer is never destroyed, so threads torn down at exit can still record.
+ */
+Tracer& GetTracer();
+
+/**
+ * @return current time, if request timing or tracing is enabled, otherwise 0
+ */
+inline uint64_t RequestTimestamp()
+{
+    return (GetRequestTimeline().enabled || GetTracer().enabled) ? RequestTimeline::Now() : 0;
+}
+
+#endif /* #ifndef _TRACE_H_ */
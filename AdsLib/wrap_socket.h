@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -45,8 +46,8 @@ inline int InitSocketLibrary(void)
 {
     return 0;
 }
-#define NATIVE_SELECT(SOCK, READFDS, WRITEFDS, EXCEPTFDS, TIMEOUT) \
-    ::select(SOCK, READFDS, WRITEFDS, EXCEPTFDS, TIMEOUT)
+#define NATIVE_POLL(FDS, NUM_FDS, TIMEOUT_MS) \
+    ::poll(FDS, NUM_FDS, TIMEOUT_MS)
 #else // defined(_WIN32) && !defined(__CYGWIN__)
 #define _WINSOCK_DEPRECATED_NO_WARNINGS 1
 #include <winsock2.h>
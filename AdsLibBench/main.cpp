@@ -0,0 +1,67 @@
+
+#include <AdsLib.h>
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+/**
+ * Measures the library overhead of calls, which only touch the internal state
+ * of the router. Build once with and once without SINGLE_THREADED=1 to compare
+ * the cost of the locks:
+ *   make clean && make bench
+ *   make clean && make bench SINGLE_THREADED=1
+ */
+static const size_t NUM_LOOPS = 1000000;
+
+template<class F>
+static void Measure(const char* name, F f)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < NUM_LOOPS; ++i) {
+        f();
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << std::setw(24) << std::left << name << std::fixed << std::setprecision(1) <<
+        (double)ns / NUM_LOOPS << " ns/call\n";
+}
+
+int main()
+{
+#ifdef CONFIG_ADSLIB_SINGLE_THREADED
+    std::cout << "lock policy: single threaded\n";
+#elif defined(CONFIG_ADSLIB_LOCK_STATS)
+    std::cout << "lock policy: profiled (" << (0 == AdsEnableLockStats(true) ? "enabled" : "disabled") << ")\n";
+#else
+    std::cout << "lock policy: thread safe\n";
+#endif
+
+    static const AmsNetId unknownNetId {192, 168, 0, 1, 1, 1};
+    static const AmsAddr unknown {unknownNetId, AMSPORT_R0_PLC_TC3};
+    const long port = AdsPortOpenEx();
+    if (!port) {
+        std::cerr << "Open ADS port failed\n";
+        return 1;
+    }
+
+    Measure("AdsSyncGetTimeoutEx", [&]() {
+        uint32_t timeout;
+        AdsSyncGetTimeoutEx(port, &timeout);
+    });
+    Measure("AdsGetLocalAddressEx", [&]() {
+        AmsAddr addr;
+        AdsGetLocalAddressEx(port, &addr);
+    });
+    Measure("AdsSyncReadStateReqEx", [&]() {
+        uint16_t adsState;
+        uint16_t devState;
+        AdsSyncReadStateReqEx(port, &unknown, &adsState, &devState);
+    });
+    Measure("AdsPortOpen/CloseEx", [&]() {
+        AdsPortCloseEx(AdsPortOpenEx());
+    });
+
+    AdsPortCloseEx(port);
+    return 0;
+}
@@ -0,0 +1,248 @@
+
+#include <AdsLib.h>
+#include "AdsSimulator/Simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Measures how the library scales with the number of routes. A child process
+ * serves up to <max> simulated devices on 127.10.x.y, so the threads, memory
+ * and CPU time reported for the benchmark process belong to the library only.
+ * The default of 2000 routes takes the socket descriptors past FD_SETSIZE.
+ * Linux only, as it reads /proc/self/status:
+ * A step is aborted on the first failed request or after STEP_TIMEOUT, and
+ * no larger steps are run after it.
+ *   make scale
+ *   ./AdsLibScale.bin [<max routes> [<requests per step> [<threads>]]]
+ */
+static const auto STEP_TIMEOUT = std::chrono::seconds(30);
+static const uint32_t REQUEST_TIMEOUT_MS = 1000;
+
+static std::string Ip(size_t i)
+{
+    return "127.10." + std::to_string(i / 200) + '.' + std::to_string(i % 200 + 1);
+}
+
+static AmsNetId NetId(size_t i)
+{
+    return AmsNetId {127, 10, static_cast<uint8_t>(i / 200), static_cast<uint8_t>(i % 200 + 1), 1, 1};
+}
+
+static long ReadStatus(const char* key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (!line.compare(0, strlen(key), key)) {
+            return std::atol(line.c_str() + strlen(key));
+        }
+    }
+    return -1;
+}
+
+static double CpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void RaiseFileLimit()
+{
+    rlimit limit;
+    if (!getrlimit(RLIMIT_NOFILE, &limit)) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/**
+ * Child process: run the simulators until the parent closes its end of <control>
+ */
+static int Serve(size_t maxRoutes, int ready, int control)
+{
+    std::vector<std::unique_ptr<Simulator> > simulators;
+    try {
+        for (size_t i = 0; i < maxRoutes; ++i) {
+            simulators.emplace_back(new Simulator {SimScript {}, IpV4 {Ip(i)}});
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Start simulator " << Ip(simulators.size()) << " failed: " << e.what() << '\n';
+        return 1;
+    }
+    const char ok = 1;
+    if (write(ready, &ok, sizeof(ok)) != sizeof(ok)) {
+        return 1;
+    }
+    char dummy;
+    while (read(control, &dummy, sizeof(dummy)) > 0) {}
+    return 0;
+}
+
+struct StepAbort {
+    const std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> aborted;
+
+    StepAbort()
+        : deadline(std::chrono::steady_clock::now() + STEP_TIMEOUT),
+        aborted(false)
+    {}
+
+    bool operator()()
+    {
+        if (std::chrono::steady_clock::now() > deadline) {
+            aborted = true;
+        }
+        return aborted;
+    }
+};
+
+static void Requests(long port, size_t first, size_t numRoutes, size_t numRequests, std::vector<uint64_t>& latencies,
+                     StepAbort& abort)
+{
+    for (size_t i = 0; (i < numRequests) && !abort(); ++i) {
+        const AmsAddr addr {NetId((first + i) % numRoutes), AMSPORT_R0_PLC_TC3};
+        uint16_t adsState;
+        uint16_t devState;
+        const auto start = std::chrono::steady_clock::now();
+        const auto status = AdsSyncReadStateReqEx(port, &addr, &adsState, &devState);
+        const auto end = std::chrono::steady_clock::now();
+        latencies.push_back(status ? UINT64_MAX : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                end - start).count());
+        if (status) {
+            abort.aborted = true;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t maxRoutes = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 2000;
+    const size_t numRequests = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 4000;
+    const size_t numThreads = std::max<size_t>(1, (argc > 3) ? std::strtoul(argv[3], nullptr, 0) : 4);
+    RaiseFileLimit();
+
+    int ready[2];
+    int control[2];
+    if (pipe(ready) || pipe(control)) {
+        std::cerr << "pipe() failed\n";
+        return 1;
+    }
+
+    // fork before the library starts any thread
+    const pid_t child = fork();
+    if (!child) {
+        close(ready[0]);
+        close(control[1]);
+        _exit(Serve(maxRoutes, ready[1], control[0]));
+    }
+    close(ready[1]);
+    close(control[0]);
+    char ok = 0;
+    if ((read(ready[0], &ok, sizeof(ok)) != sizeof(ok)) || !ok) {
+        std::cerr << "Simulators failed to start\n";
+        return 1;
+    }
+
+    std::vector<long> ports;
+    for (size_t i = 0; i < numThreads; ++i) {
+        ports.push_back(AdsPortOpenEx());
+        AdsSyncSetTimeoutEx(ports.back(), REQUEST_TIMEOUT_MS);
+    }
+
+    std::cout << "routes threads  rss[kB]  lib[kB] add[ms]    req/s  p50[us]  p99[us] cpu[us/req] errors\n";
+    const size_t steps[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+    size_t numRoutes = 0;
+    for (const auto step : steps) {
+        if (step > maxRoutes) {
+            break;
+        }
+
+        StepAbort abort;
+        const auto addBegin = std::chrono::steady_clock::now();
+        for ( ; (numRoutes < step) && !abort(); ++numRoutes) {
+            if (AdsAddRoute(NetId(numRoutes), Ip(numRoutes).c_str())) {
+                std::cerr << "Adding route to " << Ip(numRoutes) << " failed\n";
+                abort.aborted = true;
+            }
+        }
+        const auto addEnd = std::chrono::steady_clock::now();
+
+        // connect all routes before measuring
+        std::vector<uint64_t> warmup;
+        Requests(ports[0], 0, numRoutes, numRoutes, warmup, abort);
+        if (abort.aborted) {
+            std::cout << std::setw(6) << numRoutes << " aborted while adding and connecting routes\n";
+            break;
+        }
+
+        std::vector<std::vector<uint64_t> > latencies(numThreads);
+        std::vector<std::thread> threads;
+        const auto cpuBegin = CpuSeconds();
+        const auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back(&Requests, ports[i], i * numRoutes / numThreads, numRoutes,
+                                 numRequests / numThreads, std::ref(latencies[i]), std::ref(abort));
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const auto cpu = CpuSeconds() - cpuBegin;
+
+        std::vector<uint64_t> all;
+        for (const auto& l : latencies) {
+            all.insert(all.end(), l.begin(), l.end());
+        }
+        if (all.empty()) {
+            std::cout << std::setw(6) << numRoutes << " aborted before the first request\n";
+            break;
+        }
+        std::sort(all.begin(), all.end());
+        const auto numErrors = all.end() - std::find(all.begin(), all.end(), UINT64_MAX);
+        const auto seconds = std::chrono::duration<double>(end - begin).count();
+        AdsMemoryUsage memory;
+        AdsGetMemoryUsage(nullptr, &memory);
+
+        std::cout << std::fixed << std::setprecision(1) <<
+            std::setw(6) << numRoutes <<
+            std::setw(8) << ReadStatus("Threads:") <<
+            std::setw(9) << ReadStatus("VmRSS:") <<
+            std::setw(9) << memory.total / 1024 <<
+            std::setw(8) << std::chrono::duration<double, std::milli>(addEnd - addBegin).count() <<
+            std::setw(9) << std::setprecision(0) << all.size() / seconds << std::setprecision(1) <<
+            std::setw(9) << all[all.size() / 2] / 1000.0 <<
+            std::setw(9) << all[all.size() * 99 / 100] / 1000.0 <<
+            std::setw(12) << 1e6 * cpu / all.size() <<
+            std::setw(7) << numErrors <<
+            (abort.aborted ? " aborted" : "") << std::endl;
+        if (abort.aborted) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < numRoutes; ++i) {
+        AdsDelRoute(NetId(i));
+    }
+    for (const auto port : ports) {
+        AdsPortCloseEx(port);
+    }
+    close(control[1]);
+    waitpid(child, nullptr, 0);
+    return 0;
+}
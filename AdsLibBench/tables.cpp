@@ -0,0 +1,90 @@
+
+#include "FlatMap.h"
+#include "AmsPort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+/**
+ * Compares the lookup cost of the router and dispatcher tables with the node
+ * based containers they replaced, at 10k routes and 100k notification handles:
+ *   make tables
+ */
+static const size_t NUM_LOOKUPS = 10000000;
+
+template<class Key>
+struct MapLess {
+    bool operator()(const Key& lhs, const Key& rhs) const { return lhs < rhs; }
+};
+
+template<>
+struct MapLess<NotifyKey> {
+    bool operator()(const NotifyKey& lhs, const NotifyKey& rhs) const
+    {
+        return (lhs.first < rhs.first) || ((lhs.first == rhs.first) && (lhs.second < rhs.second));
+    }
+};
+
+template<class Table, class Key>
+static double Lookup(const Table& table, const std::vector<Key>& keys)
+{
+    size_t numFound = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_LOOKUPS; ++i) {
+        numFound += (table.find(keys[i % keys.size()]) != table.end());
+    }
+    const auto end = std::chrono::steady_clock::now();
+    if (numFound != NUM_LOOKUPS) {
+        std::cerr << "lookup failed\n";
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / NUM_LOOKUPS;
+}
+
+template<class Key>
+static void Compare(const char* name, std::vector<Key> keys)
+{
+    std::map<Key, size_t, MapLess<Key> > tree;
+    FlatMap<Key, size_t> flat;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        tree.emplace(keys[i], i);
+        flat.emplace(keys[i], i);
+    }
+
+    // look up in random order, so the caches don't benefit from insertion order
+    std::shuffle(keys.begin(), keys.end(), std::mt19937 {7});
+    std::cout << std::setw(28) << std::left << name << std::right << std::setw(8) << keys.size() <<
+        std::fixed << std::setprecision(1) <<
+        std::setw(12) << Lookup(tree, keys) <<
+        std::setw(12) << Lookup(flat, keys) << '\n';
+}
+
+int main()
+{
+    static const size_t NUM_ROUTES = 10000;
+    static const size_t NUM_HANDLES = 100000;
+
+    std::vector<AmsNetId> netIds;
+    for (size_t i = 0; i < NUM_ROUTES; ++i) {
+        netIds.push_back(AmsNetId {10, static_cast<uint8_t>(i >> 16), static_cast<uint8_t>(i >> 8),
+                                   static_cast<uint8_t>(i), 1, 1});
+    }
+
+    std::vector<uint32_t> handles;
+    std::vector<NotifyKey> notifyKeys;
+    for (size_t i = 0; i < NUM_HANDLES; ++i) {
+        const AmsAddr source {netIds[i % NUM_ROUTES], AMSPORT_R0_PLC_TC3};
+        handles.push_back(static_cast<uint32_t>(i + 1));
+        notifyKeys.push_back(NotifyKey {static_cast<uint32_t>(i / NUM_ROUTES + 1), source});
+    }
+
+    std::cout << "table                        entries std::map[ns] FlatMap[ns]\n";
+    Compare("route (AmsNetId)", netIds);
+    Compare("dispatcher (hNotify)", handles);
+    Compare("port (hNotify, AmsAddr)", notifyKeys);
+    return 0;
+}
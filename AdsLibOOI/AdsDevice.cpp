@@ -5,7 +5,8 @@
 DeviceInfo AdsDevice::__ReadDeviceInfo(const AdsRoute& route)
 {
     DeviceInfo info;
-    auto error = AdsSyncReadDeviceInfoReqEx(route.GetLocalPort(),
+    const auto port = route.LeasePort();
+    auto error = AdsSyncReadDeviceInfoReqEx(port,
                                             &route.m_SymbolPort,
                                             &info.name[0],
                                             &info.version);
@@ -26,7 +27,8 @@ AdsDeviceState AdsDevice::GetState() const
     AdsDeviceState state;
     static_assert(sizeof(state.ads) == sizeof(uint16_t), "size missmatch");
     static_assert(sizeof(state.device) == sizeof(uint16_t), "size missmatch");
-    auto error = AdsSyncReadStateReqEx(m_Route.GetLocalPort(),
+    const auto port = m_Route.LeasePort();
+    auto error = AdsSyncReadStateReqEx(port,
                                        &m_Route.m_SymbolPort,
                                        (uint16_t*)&state.ads,
                                        (uint16_t*)&state.device);
@@ -40,7 +42,8 @@ AdsDeviceState AdsDevice::GetState() const
 
 void AdsDevice::SetState(const ADSSTATE AdsState, const ADSSTATE DeviceState) const
 {
-    auto error = AdsSyncWriteControlReqEx(m_Route.GetLocalPort(),
+    const auto port = m_Route.LeasePort();
+    auto error = AdsSyncWriteControlReqEx(port,
                                           &m_Route.m_SymbolPort,
                                           AdsState,
                                           DeviceState,
@@ -0,0 +1,59 @@
+#include "AdsPortPool.h"
+#include "AdsException.h"
+#include "AdsLib/AdsLib.h"
+
+AdsPortPool::AdsPortPool(size_t maxPorts)
+    : m_MaxPorts(maxPorts ? maxPorts : 1),
+    m_Timeout(0)
+{}
+
+AdsPortPool::~AdsPortPool()
+{
+    for (const auto port : m_All) {
+        AdsPortCloseEx(port);
+    }
+}
+
+long AdsPortPool::Acquire()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (m_Free.empty() && (m_All.size() < m_MaxPorts)) {
+        const auto port = AdsPortOpenEx();
+        if (!port) {
+            throw AdsException(ADSERR_CLIENT_PORTNOTOPEN);
+        }
+        if (m_Timeout) {
+            AdsSyncSetTimeoutEx(port, m_Timeout);
+        }
+        m_All.push_back(port);
+        return port;
+    }
+
+    m_Released.wait(lock, [&]() {
+        return !m_Free.empty();
+    });
+    const auto port = m_Free.back();
+    m_Free.pop_back();
+    return port;
+}
+
+void AdsPortPool::Release(long port)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Free.push_back(port);
+    }
+    m_Released.notify_one();
+}
+
+void AdsPortPool::SetTimeout(uint32_t timeout)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const auto port : m_All) {
+        const auto error = AdsSyncSetTimeoutEx(port, timeout);
+        if (error) {
+            throw AdsException(error);
+        }
+    }
+    m_Timeout = timeout;
+}
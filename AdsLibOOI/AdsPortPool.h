@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * A set of local ports, each used by one thread at a time. Ports are
+ * opened on demand up to <maxPorts>; if all of them are in use, Acquire()
+ * blocks until a port is released.
+ */
+struct AdsPortPool {
+    AdsPortPool(size_t maxPorts);
+    ~AdsPortPool();
+
+    long Acquire();
+    void Release(long port);
+    void SetTimeout(uint32_t timeout);
+private:
+    const size_t m_MaxPorts;
+    uint32_t m_Timeout;
+    std::vector<long> m_Free;
+    std::vector<long> m_All;
+    std::mutex m_Mutex;
+    std::condition_variable m_Released;
+};
+
+/**
+ * RAII wrapper around AdsPortPool::Acquire() and AdsPortPool::Release()
+ */
+struct AdsPortLease {
+    AdsPortLease(AdsPortPool& pool)
+        : m_Pool(&pool),
+        m_Port(pool.Acquire())
+    {}
+
+    AdsPortLease(AdsPortLease&& ref)
+        : m_Pool(ref.m_Pool),
+        m_Port(ref.m_Port)
+    {
+        ref.m_Pool = nullptr;
+    }
+
+    ~AdsPortLease()
+    {
+        if (m_Pool) {
+            m_Pool->Release(m_Port);
+        }
+    }
+
+    operator long() const
+    {
+        return m_Port;
+    }
+private:
+    AdsPortPool* m_Pool;
+    const long m_Port;
+};
@@ -23,11 +23,13 @@ static AmsNetId* AddRoute(AmsNetId ams, const char* ip)
     return new AmsNetId {ams};
 }
 
-AdsRoute::AdsRoute(const std::string& ipV4, AmsNetId netId, uint16_t taskPort, uint16_t symbolPort)
+AdsRoute::AdsRoute(const std::string& ipV4, AmsNetId netId, uint16_t taskPort, uint16_t symbolPort,
+                   size_t maxPorts)
     : m_NetId(AddRoute(netId, ipV4.c_str()), DeleteRoute),
     m_TaskPort({netId, taskPort}),
     m_SymbolPort({netId, symbolPort}),
-    m_LocalPort(new long { AdsPortOpenEx() }, CloseLocalPort)
+    m_LocalPort(new long { AdsPortOpenEx() }, CloseLocalPort),
+    m_PortPool(std::make_shared<AdsPortPool>(maxPorts))
 {}
 
 long AdsRoute::GetLocalPort() const
@@ -35,12 +37,18 @@ long AdsRoute::GetLocalPort() const
     return *m_LocalPort;
 }
 
+AdsPortLease AdsRoute::LeasePort() const
+{
+    return AdsPortLease {*m_PortPool};
+}
+
 void AdsRoute::SetTimeout(const uint32_t timeout) const
 {
     const auto error = AdsSyncSetTimeoutEx(GetLocalPort(), timeout);
     if (error) {
         throw AdsException(error);
     }
+    m_PortPool->SetTimeout(timeout);
 }
 
 uint32_t AdsRoute::GetTimeout() const
@@ -1,11 +1,24 @@
 #pragma once
 #include "AdsLib/AdsDef.h"
+#include "AdsPortPool.h"
 #include <memory>
 
 struct AdsRoute {
-    AdsRoute(const std::string& ipV4, AmsNetId netId, uint16_t taskPort, uint16_t symbolPort);
+    /**
+     * @param maxPorts maximum number of additional local ports opened on demand
+     *        by LeasePort(), so that copies of this route can be used concurrently
+     */
+    AdsRoute(const std::string& ipV4, AmsNetId netId, uint16_t taskPort, uint16_t symbolPort, size_t maxPorts = 8);
 
+    /**
+     * The primary local port, used for symbol handles and notifications
+     */
     long GetLocalPort() const;
+
+    /**
+     * Lease a local port from the pool, for exclusive use until the lease is destroyed
+     */
+    AdsPortLease LeasePort() const;
     void SetTimeout(const uint32_t timeout) const;
     uint32_t GetTimeout() const;
 
@@ -14,4 +27,5 @@ struct AdsRoute {
     const AmsAddr m_SymbolPort;
 private:
     std::shared_ptr<long> m_LocalPort;
+    std::shared_ptr<AdsPortPool> m_PortPool;
 };
@@ -0,0 +1,185 @@
+#include "AdsStateWatcher.h"
+#include "AdsLib/AdsLib.h"
+#include "AdsLib/wrap_endian.h"
+
+#include <map>
+
+static const AdsDeviceState UNREACHABLE {ADSSTATE_INVALID, ADSSTATE_INVALID};
+
+static bool operator!=(const AdsDeviceState& lhs, const AdsDeviceState& rhs)
+{
+    return (lhs.ads != rhs.ads) || (lhs.device != rhs.device);
+}
+
+/**
+ * Notification callbacks only get a uint32_t hUser, so watchers register here.
+ * A watcher is removed before it is destroyed, while holding g_WatchersMutex.
+ */
+static std::mutex g_WatchersMutex;
+static std::map<uint32_t, AdsStateWatcher*> g_Watchers;
+static uint32_t g_NextId = 1;
+
+static uint32_t Register(AdsStateWatcher* watcher)
+{
+    std::lock_guard<std::mutex> lock(g_WatchersMutex);
+    const auto id = g_NextId++;
+    g_Watchers[id] = watcher;
+    return id;
+}
+
+AdsStateWatcher::AdsStateWatcher(const AdsRoute& route, Callback callback, std::chrono::milliseconds pollPeriod)
+    : m_Route(route),
+    m_Callback(std::move(callback)),
+    m_PollPeriod(pollPeriod),
+    m_Id(Register(this)),
+    m_NumPushed(0),
+    m_State(UNREACHABLE),
+    m_hNotify(0),
+    m_Running(true),
+    m_Thread(&AdsStateWatcher::Run, this)
+{}
+
+AdsStateWatcher::~AdsStateWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_WatchersMutex);
+        g_Watchers.erase(m_Id);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Running = false;
+    }
+    m_Wakeup.notify_all();
+    m_Thread.join();
+    Unsubscribe();
+}
+
+AdsDeviceState AdsStateWatcher::GetState() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_State;
+}
+
+bool AdsStateWatcher::IsSubscribed() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return 0 != m_hNotify;
+}
+
+void AdsStateWatcher::Notify(const AmsAddr*, const AdsNotificationHeader* pNotification, uint32_t hUser)
+{
+    if (pNotification->cbSampleSize < 2 * sizeof(uint16_t)) {
+        return;
+    }
+    const auto data = reinterpret_cast<const uint8_t*>(pNotification + 1);
+    const AdsDeviceState state {
+        static_cast<ADSSTATE>(qFromLittleEndian<uint16_t>(data)),
+        static_cast<ADSSTATE>(qFromLittleEndian<uint16_t>(data + sizeof(uint16_t)))
+    };
+
+    std::lock_guard<std::mutex> lock(g_WatchersMutex);
+    const auto it = g_Watchers.find(hUser);
+    if (it == g_Watchers.end()) {
+        return;
+    }
+    auto& watcher = *it->second;
+    {
+        std::lock_guard<std::mutex> watcherLock(watcher.m_Mutex);
+        watcher.m_Pushed.push_back(state);
+        ++watcher.m_NumPushed;
+    }
+    watcher.m_Wakeup.notify_all();
+}
+
+void AdsStateWatcher::Subscribe()
+{
+    static const AdsNotificationAttrib attrib {2 * sizeof(uint16_t), ADSTRANS_SERVERONCHA, 0, {0}};
+    uint32_t hNotify = 0;
+    const auto error = AdsSyncAddDeviceNotificationReqEx(m_Route.GetLocalPort(),
+                                                         &m_Route.m_SymbolPort,
+                                                         ADSIGRP_DEVICE_DATA,
+                                                         ADSIOFFS_DEVDATA_ADSSTATE,
+                                                         &attrib,
+                                                         &AdsStateWatcher::Notify,
+                                                         m_Id,
+                                                         &hNotify);
+    if (!error) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_hNotify = hNotify;
+    }
+}
+
+void AdsStateWatcher::Unsubscribe()
+{
+    uint32_t hNotify;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        hNotify = m_hNotify;
+        m_hNotify = 0;
+    }
+    if (hNotify) {
+        // the connection might be gone already, the handle is released anyway
+        AdsSyncDelDeviceNotificationReqEx(m_Route.GetLocalPort(), &m_Route.m_SymbolPort, hNotify);
+    }
+}
+
+void AdsStateWatcher::Report(const AdsDeviceState& state, std::unique_lock<std::mutex>& lock)
+{
+    if (state != m_State) {
+        m_State = state;
+        lock.unlock();
+        m_Callback(state);
+        lock.lock();
+    }
+}
+
+void AdsStateWatcher::ReportPushed(std::unique_lock<std::mutex>& lock)
+{
+    while (m_Running && !m_Pushed.empty()) {
+        const auto state = m_Pushed.front();
+        m_Pushed.pop_front();
+        Report(state, lock);
+    }
+}
+
+void AdsStateWatcher::Run()
+{
+    auto nextPoll = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (m_Running) {
+        if (m_Wakeup.wait_until(lock, nextPoll, [this] { return !m_Running || !m_Pushed.empty(); })) {
+            ReportPushed(lock);
+            continue;
+        }
+
+        const auto numPushed = m_NumPushed;
+        const bool subscribed = m_hNotify;
+        lock.unlock();
+        AdsDeviceState state;
+        const auto error = AdsSyncReadStateReqEx(m_Route.LeasePort(),
+                                                 &m_Route.m_SymbolPort,
+                                                 reinterpret_cast<uint16_t*>(&state.ads),
+                                                 reinterpret_cast<uint16_t*>(&state.device));
+        if (error) {
+            state = UNREACHABLE;
+            Unsubscribe();
+        } else if (!subscribed) {
+            Subscribe();
+        }
+        lock.lock();
+
+        if (subscribed && !error && (numPushed == m_NumPushed) && (state != m_State)) {
+            // the device missed to push a transition, e.g. after a reconnect
+            lock.unlock();
+            Unsubscribe();
+            Subscribe();
+            lock.lock();
+        }
+        ReportPushed(lock);
+        // a notification received during the request is more recent than its response
+        if (error || (numPushed == m_NumPushed)) {
+            Report(state, lock);
+        }
+        nextPoll = std::chrono::steady_clock::now() + m_PollPeriod;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "AdsDevice.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Watches the state of a device and reports every transition to a callback.
+ *
+ * The state is pushed by an on change notification on ADSIGRP_DEVICE_DATA.
+ * A READ_STATE request every pollPeriod verifies the connection. If a device
+ * closes the connection (e.g. entering config mode) or does not support the
+ * notification, the watcher continues with polling at that rate and subscribes
+ * again as soon as the device is reachable. While the device is unreachable the
+ * state is reported as {ADSSTATE_INVALID, ADSSTATE_INVALID}.
+ *
+ * The callback is invoked from a thread owned by the watcher, never concurrently.
+ */
+struct AdsStateWatcher {
+    using Callback = std::function<void (const AdsDeviceState& state)>;
+
+    AdsStateWatcher(const AdsRoute& route, Callback callback,
+                    std::chrono::milliseconds pollPeriod = std::chrono::milliseconds(1000));
+    ~AdsStateWatcher();
+    AdsStateWatcher(const AdsStateWatcher&) = delete;
+    AdsStateWatcher& operator=(const AdsStateWatcher&) = delete;
+
+    /**
+     * The state most recently reported to the callback
+     */
+    AdsDeviceState GetState() const;
+
+    /**
+     * true while state changes are pushed by the device, false while polling
+     */
+    bool IsSubscribed() const;
+
+private:
+    static void Notify(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification, uint32_t hUser);
+    void Run();
+    void Subscribe();
+    void Unsubscribe();
+    void Report(const AdsDeviceState& state, std::unique_lock<std::mutex>& lock);
+    void ReportPushed(std::unique_lock<std::mutex>& lock);
+
+    const AdsRoute m_Route;
+    const Callback m_Callback;
+    const std::chrono::milliseconds m_PollPeriod;
+    const uint32_t m_Id;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Wakeup;
+    std::deque<AdsDeviceState> m_Pushed;
+    size_t m_NumPushed;
+    AdsDeviceState m_State;
+    uint32_t m_hNotify;
+    bool m_Running;
+    std::thread m_Thread;
+};
@@ -48,7 +48,8 @@ struct AdsVariable {
     void Read(const size_t size, void* data) const
     {
         uint32_t bytesRead = 0;
-        auto error = AdsSyncReadReqEx2(m_Route.GetLocalPort(),
+        const auto port = m_Route.LeasePort();
+        auto error = AdsSyncReadReqEx2(port,
                                        &m_AmsAddr,
                                        m_IndexGroup,
                                        m_Handle,
@@ -63,7 +64,8 @@ struct AdsVariable {
 
     void Write(const size_t size, const void* data) const
     {
-        auto error = AdsSyncWriteReqEx(m_Route.GetLocalPort(),
+        const auto port = m_Route.LeasePort();
+        auto error = AdsSyncWriteReqEx(port,
                                        &m_AmsAddr,
                                        m_IndexGroup,
                                        m_Handle,
@@ -75,6 +77,35 @@ struct AdsVariable {
         }
     }
 
+    /**
+     * Write <value> and read it back within a single round trip
+     * @param readBack receives the value read back from the ADS server
+     * @return true if <readBack> matches <value>
+     */
+    bool WriteVerify(const T& value, T& readBack) const
+    {
+        return WriteVerify(sizeof(T), &value, &readBack);
+    }
+
+    bool WriteVerify(const size_t size, const void* data, void* readBack) const
+    {
+        bool mismatch = true;
+        const auto port = m_Route.LeasePort();
+        auto error = AdsSyncWriteVerifyReqEx(port,
+                                             &m_AmsAddr,
+                                             m_IndexGroup,
+                                             m_Handle,
+                                             size,
+                                             data,
+                                             readBack,
+                                             &mismatch);
+
+        if (error) {
+            throw AdsException(error);
+        }
+        return !mismatch;
+    }
+
     const AdsRoute GetRoute() const
     {
         return m_Route;
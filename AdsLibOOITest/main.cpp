@@ -2,11 +2,13 @@
 #include "AdsLibOOI/AdsLibOOI.h"
 #include "AdsLibOOI/AdsDevice.h"
 #include "AdsLibOOI/AdsNotification.h"
+#include "AdsLibOOI/AdsStateWatcher.h"
 #include "AdsLib/AdsDef.h"
 
 #include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 #include <thread>
 
 #include <fructose/fructose.h>
@@ -346,6 +348,22 @@ struct TestAds : test_base<TestAds> {
         }
     }
 
+    void testAdsWriteVerify(const std::string&)
+    {
+        AdsRoute route {"192.168.0.232", serverNetId, AMSPORT_R0_PLC_TC3, AMSPORT_R0_PLC_TC3};
+        fructose_assert(0 != route.GetLocalPort());
+
+        uint32_t outBuffer = 0xDEADBEEF;
+        AdsVariable<uint32_t> buffer {route, 0x4020, 0};
+        for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+            uint32_t readBack = ~outBuffer;
+            fructose_loop_assert(i, buffer.WriteVerify(outBuffer, readBack));
+            fructose_loop_assert(i, outBuffer == readBack);
+            outBuffer = ~outBuffer;
+        }
+        buffer = 0x0; /* restore default value */
+    }
+
     void testAdsWriteControlReqEx(const std::string&)
     {
         AdsRoute route {"192.168.0.232", serverNetId, AMSPORT_R0_PLC_TC3, AMSPORT_R0_PLC_TC3};
@@ -400,6 +418,34 @@ struct TestAds : test_base<TestAds> {
         /* not possible with OOI */
     }
 
+    void testAdsStateWatcher(const std::string&)
+    {
+        AdsRoute route {"192.168.0.232", serverNetId, AMSPORT_R0_PLC_TC3, AMSPORT_R0_PLC_TC3};
+        AdsDevice device {route};
+        std::mutex mutex;
+        std::vector<ADSSTATE> transitions;
+        AdsStateWatcher watcher {route, [&](const AdsDeviceState& state) {
+                                     std::lock_guard<std::mutex> lock(mutex);
+                                     transitions.push_back(state.ads);
+                                 }};
+
+        // the initial state is polled, before the watcher subscribes
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fructose_assert(ADSSTATE_RUN == watcher.GetState().ads);
+        fructose_assert(watcher.IsSubscribed());
+
+        // transitions are pushed long before the next poll
+        device.SetState(ADSSTATE_STOP, ADSSTATE_INVALID);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fructose_assert(ADSSTATE_STOP == watcher.GetState().ads);
+        device.SetState(ADSSTATE_RUN, ADSSTATE_INVALID);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fructose_assert(ADSSTATE_RUN == watcher.GetState().ads);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        fructose_assert_eq(std::vector<ADSSTATE>({ADSSTATE_RUN, ADSSTATE_STOP, ADSSTATE_RUN}), transitions);
+    }
+
     void testAdsNotification(const std::string&)
     {
         static const uint32_t NOTIFY_CYCLE_100NS = 1000000;
@@ -544,6 +590,27 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
         out << testname << " took " << tmms << "ms\n";
     }
 
+    void testParallelSharedRoute(const std::string& testname)
+    {
+        const AdsRoute route("192.168.0.232", serverNetId, AMSPORT_R0_PLC_TC3, AMSPORT_R0_PLC_TC3);
+        const AdsVariable<uint32_t> simpleVar {route, "MAIN.byByte"};
+        std::thread threads[8];
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (auto& t : threads) {
+            t = std::thread([&]() {
+                for (size_t i = 0; i < 1024; ++i) {
+                    (void)(uint32_t)simpleVar;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto tmms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        out << testname << " took " << tmms << "ms\n";
+    }
+
     void testEndurance(const std::string& testname)
     {
         static const size_t numNotifications = 1024;
@@ -626,7 +693,9 @@ int main()
     adsTest.add_test("testAdsReadStateReqEx", &TestAds::testAdsReadStateReqEx);
     adsTest.add_test("testAdsReadWriteReqEx2", &TestAds::testAdsReadWriteReqEx2);
     adsTest.add_test("testAdsWriteReqEx", &TestAds::testAdsWriteReqEx);
+    adsTest.add_test("testAdsWriteVerify", &TestAds::testAdsWriteVerify);
     adsTest.add_test("testAdsWriteControlReqEx", &TestAds::testAdsWriteControlReqEx);
+    adsTest.add_test("testAdsStateWatcher", &TestAds::testAdsStateWatcher);
     adsTest.add_test("testAdsNotification", &TestAds::testAdsNotification);
     adsTest.add_test("testAdsTimeout", &TestAds::testAdsTimeout);
     adsTest.run();
@@ -634,6 +703,7 @@ int main()
     TestAdsPerformance performance(errorstream);
     performance.add_test("testManyNotifications", &TestAdsPerformance::testManyNotifications);
     performance.add_test("testParallelReadAndWrite", &TestAdsPerformance::testParallelReadAndWrite);
+    performance.add_test("testParallelSharedRoute", &TestAdsPerformance::testParallelSharedRoute);
     performance.add_test("testEndurance", &TestAdsPerformance::testEndurance);
     performance.run();
 
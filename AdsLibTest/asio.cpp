@@ -0,0 +1,117 @@
+#include "AdsAsio.h"
+#include "AdsSimulator/Simulator.h"
+
+#include <iostream>
+
+#include <fructose/fructose.h>
+using namespace fructose;
+
+/**
+ * Runs the polling mode on a boost::asio::io_context against the simulator. The
+ * polling mode applies to the whole process, so the adapter gets a test binary
+ * of its own. Skipped, if boost::asio is not installed:
+ *   make testAsio
+ */
+static const AmsNetId simNetId {127, 0, 0, 3, 1, 1};
+static const AmsAddr sim {simNetId, AMSPORT_R0_PLC_TC3};
+
+static size_t g_NumNotifications = 0;
+static void NotifyCallback(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    ++g_NumNotifications;
+}
+
+struct TestAdsAsio : test_base<TestAdsAsio> {
+    std::ostream& out;
+    boost::asio::io_context io;
+    std::unique_ptr<AdsAsioLoop> loop;
+    long port;
+
+    TestAdsAsio(std::ostream& outstream)
+        : out(outstream),
+        loop(new AdsAsioLoop {io}),
+        port(0)
+    {}
+
+    /**
+     * Run <f> as handler of the io_context, like an application would issue requests
+     */
+    template<class F> void RunInLoop(F f)
+    {
+        boost::asio::post(io, [&]() {
+            f();
+            io.stop();
+        });
+        io.restart();
+        io.run_for(std::chrono::seconds(5));
+    }
+
+    void testAsioStart(const std::string&)
+    {
+        fructose_assert(0 == loop->Start());
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.3"));
+        port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+    }
+
+    void testAsioRequest(const std::string&)
+    {
+        long status = -1;
+        uint16_t adsState = 0;
+        uint16_t devState;
+        RunInLoop([&]() {
+            status = AdsSyncReadStateReqEx(port, &sim, &adsState, &devState);
+        });
+        fructose_assert(0 == status);
+        fructose_assert(ADSSTATE_RUN == adsState);
+    }
+
+    void testAsioNotifications(const std::string& testname)
+    {
+        // 1ms cycle
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {10000} };
+        uint32_t hNotify;
+        long status = -1;
+        g_NumNotifications = 0;
+        RunInLoop([&]() {
+            status = AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 0, &attrib, &NotifyCallback, 0, &hNotify);
+        });
+        fructose_assert(0 == status);
+        io.restart();
+        io.run_for(std::chrono::milliseconds(500));
+        out << testname << " received " << g_NumNotifications << " notifications in 500ms\n";
+        fructose_assert(10 < g_NumNotifications);
+
+        // handlers still queued in the io_context must not touch the destroyed loop
+        loop.reset();
+        const auto numReceived = g_NumNotifications;
+        io.restart();
+        io.run_for(std::chrono::milliseconds(100));
+        fructose_assert(numReceived == g_NumNotifications);
+
+        loop.reset(new AdsAsioLoop {io});
+        fructose_assert(0 == loop->Start());
+        RunInLoop([&]() {
+            status = AdsSyncDelDeviceNotificationReqEx(port, &sim, hNotify);
+        });
+        fructose_assert(0 == status);
+    }
+
+    void testAsioStop(const std::string&)
+    {
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+        loop->Stop();
+    }
+};
+
+int main()
+{
+    Simulator simulator {SimScript {}, IpV4 {"127.0.0.3"}};
+    TestAdsAsio asioTest(std::cout);
+    asioTest.add_test("testAsioStart", &TestAdsAsio::testAsioStart);
+    asioTest.add_test("testAsioRequest", &TestAdsAsio::testAsioRequest);
+    asioTest.add_test("testAsioNotifications", &TestAdsAsio::testAsioNotifications);
+    asioTest.add_test("testAsioStop", &TestAdsAsio::testAsioStop);
+    return asioTest.run();
+}
@@ -2,9 +2,17 @@
 #include <AdsLib.h>
 
 #include "AmsRouter.h"
+#include "Trace.h"
+#include "AdsSimulator/Simulator.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
 
 #include <fructose/fructose.h>
 using namespace fructose;
@@ -13,7 +21,7 @@ static const AmsNetId serverNetId {192, 168, 0, 231, 1, 1};
 static const AmsAddr server {serverNetId, AMSPORT_R0_PLC_TC3};
 static const AmsAddr serverBadPort {serverNetId, 1000};
 
-static size_t g_NumNotifications = 0;
+static std::atomic<size_t> g_NumNotifications {0};
 static void NotifyCallback(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification, uint32_t hUser)
 {
     ++g_NumNotifications;
@@ -26,6 +34,51 @@ static void NotifyCallback(const AmsAddr* pAddr, const AdsNotificationHeader* pN
 #endif
 }
 
+static void SlowCallback(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+static std::map<std::string, long> g_RouteStatus;
+static void RouteStatusCallback(const AmsNetId*, const char* ip, long status, uint32_t)
+{
+    g_RouteStatus[ip] = status;
+}
+
+/**
+ * Start a simulator on <ip> only after <delayMs>, so a connect which is made
+ * up front is refused, while one made after a slow connect succeeds.
+ */
+static std::thread StartLate(std::unique_ptr<Simulator>& late, IpV4 ip, uint32_t delayMs)
+{
+    return std::thread([&late, ip, delayMs]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        late.reset(new Simulator {SimScript {}, ip});
+    });
+}
+
+static std::vector<AdsFileEntry> g_FileEntries;
+static void FileEntryCallback(const AdsFileEntry* entry, uint32_t)
+{
+    g_FileEntries.push_back(*entry);
+}
+
+static std::atomic<bool> g_InBlockingCallback {false};
+static std::atomic<bool> g_ReleaseCallback {false};
+static void BlockingCallback(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    g_InBlockingCallback = true;
+    for (size_t i = 0; (i < 100) && !g_ReleaseCallback; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+static std::atomic<size_t> g_NumSlowCallbacks {0};
+static void DispatcherEvent(const AmsAddr*, uint16_t, AdsDispatcherEvent event, uint32_t, uint64_t, uint32_t)
+{
+    g_NumSlowCallbacks += (ADS_EVENT_SLOW_CALLBACK == event);
+}
+
 void print(const AmsAddr& addr, std::ostream& out)
 {
     out << "AmsAddr: " << std::dec <<
@@ -138,6 +191,162 @@ struct TestAmsRouter : test_base<TestAmsRouter> {
         fructose_assert(testee.GetConnection(netId_2));
     }
 
+    void testAmsRouterAddRouteLazy(const std::string&)
+    {
+        static const AmsNetId netId_1 { 192, 168, 0, 231, 1, 1 };
+        static const AmsNetId netId_2 { 127, 0, 0, 3, 1, 1 };
+        static const IpV4 ip_remote("127.0.0.2");
+        static const IpV4 ip_refused("127.0.0.3");
+        Simulator remote {SimScript {}, ip_remote};
+        AmsRouter testee;
+
+        // lazy route is connected on first use
+        fructose_assert(0 == testee.AddRoute(netId_1, ip_remote, true));
+        fructose_assert(testee.GetConnection(netId_1));
+        fructose_assert(!testee.GetConnection(netId_1)->ownIp);
+        fructose_assert(testee.GetConnection(netId_1)->Connect());
+        fructose_assert(testee.GetConnection(netId_1)->ownIp);
+
+        // idle connection is closed and reestablished on demand
+        testee.SetIdleTimeout(100);
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        fructose_assert(!testee.GetConnection(netId_1)->ownIp);
+        fructose_assert(testee.GetConnection(netId_1)->Connect());
+
+        // a refused connect keeps the route for the next attempt
+        fructose_assert(0 == testee.AddRoute(netId_2, ip_refused, true));
+        fructose_assert(!testee.GetConnection(netId_2)->Connect());
+        fructose_assert(testee.GetConnection(netId_2));
+        fructose_assert(!testee.GetConnection(netId_2)->ownIp);
+        {
+            Simulator late {SimScript {}, ip_refused};
+            fructose_assert(testee.GetConnection(netId_2)->Connect());
+        }
+    }
+
+    void testAmsRouterAddRoutes(const std::string&)
+    {
+        static const AmsNetId netId_1 { 192, 168, 0, 231, 1, 1 };
+        static const AmsNetId netId_2 { 127, 0, 0, 1, 2, 1 };
+        static const IpV4 ip_local("127.0.0.1");
+        static const IpV4 ip_remote("127.0.0.2");
+        Simulator remote {SimScript {}, ip_remote};
+        AmsRouter testee;
+        long results[6];
+
+        // lazy routes are added without connecting
+        const std::vector<AmsRoute> routes {
+            AmsRoute {netId_1, ip_remote},
+            AmsRoute {netId_2, ip_local},
+            AmsRoute {AmsNetId {}, ip_local},
+            AmsRoute {netId_2, IpV4 {"no.ip"}},
+        };
+        testee.AddRoutes(routes, results, true);
+        fructose_assert_eq(0, results[0]);
+        fructose_assert_eq(0, results[1]);
+        fructose_assert_eq(ADSERR_CLIENT_INVALIDPARM, results[2]);
+        fructose_assert_eq(ADSERR_CLIENT_INVALIDPARM, results[3]);
+        fructose_assert(ip_remote == testee.GetConnection(netId_1)->destIp);
+        fructose_assert(!testee.GetConnection(netId_1)->ownIp);
+        fructose_assert(ip_local == testee.GetConnection(netId_2)->destIp);
+        fructose_assert(!testee.GetConnection(netId_2)->ownIp);
+
+        // existent Ams with new Ip
+        testee.AddRoutes({AmsRoute {netId_1, ip_local}}, results, true);
+        fructose_assert_eq(ROUTERERR_PORTALREADYINUSE, results[0]);
+        fructose_assert(ip_remote == testee.GetConnection(netId_1)->destIp);
+
+        // eager routes are connected concurrently: .3 takes about a second to connect, .5 refuses
+        // the connection and .6 only starts listening halfway through that second
+        Simulator slow {SimScript::Parse("accept_delay 200"), IpV4 {"127.0.0.3"}};
+        Simulator fast {SimScript {}, IpV4 {"127.0.0.4"}};
+        std::unique_ptr<Simulator> late;
+        const std::vector<AmsRoute> eager {
+            AmsRoute {AmsNetId {127, 0, 0, 3, 1, 1}, IpV4 {"127.0.0.3"}},
+            AmsRoute {netId_1, ip_remote},
+            AmsRoute {AmsNetId {127, 0, 0, 4, 1, 1}, IpV4 {"127.0.0.4"}},
+            AmsRoute {AmsNetId {127, 0, 0, 5, 1, 1}, IpV4 {"127.0.0.5"}},
+            AmsRoute {AmsNetId {127, 0, 0, 6, 1, 1}, IpV4 {"127.0.0.6"}},
+        };
+        auto starter = StartLate(late, IpV4 {"127.0.0.6"}, 500);
+        const auto start = std::chrono::steady_clock::now();
+        testee.AddRoutes(eager, results, false);
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        starter.join();
+        fructose_assert(ms < 1500);
+        fructose_assert_eq(0, results[0]);
+        fructose_assert_eq(0, results[1]);
+        fructose_assert_eq(0, results[2]);
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, results[3]);
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, results[4]);
+        for (size_t i = 0; i < 3; ++i) {
+            fructose_loop_assert(i, testee.GetConnection(eager[i].first)->ownIp);
+        }
+        fructose_assert(!testee.GetConnection(eager[3].first)->ownIp);
+        fructose_assert(!testee.GetConnection(eager[4].first)->ownIp);
+    }
+
+    void testAmsRouterPollingMode(const std::string&)
+    {
+        static const AmsNetId netId_1 { 192, 168, 0, 231, 1, 1 };
+        static const IpV4 ip_remote("127.0.0.2");
+        Simulator remote {SimScript {}, ip_remote};
+        std::unique_ptr<Simulator> closing {new Simulator {SimScript {}, IpV4 {"127.0.0.4"}}};
+        Simulator other {SimScript {}, IpV4 {"127.0.0.3"}};
+        AmsRouter testee;
+        int fds[8];
+        uint32_t numFds = 8;
+
+        fructose_assert_eq(ADSERR_DEVICE_SRVNOTSUPP, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(ADSERR_DEVICE_SRVNOTSUPP, testee.ProcessEvents());
+        fructose_assert_eq(0, testee.SetPollingMode(true));
+
+        // without connections only the wakeup descriptor is returned
+        fructose_assert_eq(0, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(1U, numFds);
+        numFds = 0;
+        fructose_assert_eq(ADSERR_DEVICE_INVALIDSIZE, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(1U, numFds);
+
+        // mode can't be changed while routes exist
+        fructose_assert(0 == testee.AddRoute(netId_1, ip_remote, true));
+        fructose_assert_eq(ADSERR_DEVICE_BUSY, testee.SetPollingMode(false));
+        fructose_assert_eq(0, testee.ProcessEvents());
+
+        // each connection adds its socket
+        fructose_assert(testee.GetConnection(netId_1)->Connect());
+        numFds = 8;
+        fructose_assert_eq(0, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(2U, numFds);
+
+        // eager routes are connected one after the other from the calling thread
+        const std::vector<AmsRoute> eager {
+            AmsRoute {AmsNetId {127, 0, 0, 3, 1, 1}, IpV4 {"127.0.0.3"}},
+            AmsRoute {AmsNetId {127, 0, 0, 4, 1, 1}, IpV4 {"127.0.0.4"}},
+            AmsRoute {AmsNetId {127, 0, 0, 5, 1, 1}, IpV4 {"127.0.0.5"}},
+        };
+        long results[3];
+        testee.AddRoutes(eager, results, false);
+        fructose_assert_eq(0, results[0]);
+        fructose_assert_eq(0, results[1]);
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, results[2]);
+        numFds = 8;
+        fructose_assert_eq(0, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(4U, numFds);
+
+        // a connection closed by the remote side is dropped by ProcessEvents()
+        closing.reset();
+        for (size_t i = 0; (i < 100) && testee.GetConnection(eager[1].first)->ownIp; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            fructose_assert_eq(0, testee.ProcessEvents());
+        }
+        fructose_assert(!testee.GetConnection(eager[1].first)->ownIp);
+        numFds = 8;
+        fructose_assert_eq(0, testee.GetPollFds(fds, numFds));
+        fructose_assert_eq(3U, numFds);
+    }
+
     void testConcurrentRoutes(const std::string&)
     {
         std::thread threads[256];
@@ -213,7 +422,7 @@ struct TestRingBuffer : test_base<TestRingBuffer> {
     void testBytesFree(const std::string&)
     {
         RingBuffer testee { 1 };
-        const auto data = testee.write;
+        const uint8_t* const data = testee.write;
         fructose_assert(0 == testee.BytesAvailable());
         fructose_assert(1 == testee.BytesFree());
         fructose_assert(testee.write == testee.read);
@@ -248,8 +457,819 @@ struct TestRingBuffer : test_base<TestRingBuffer> {
             testee.ReadFromLittleEndian<uint8_t>();
         }
     }
+
+    static void Store(RingBuffer& ring, const std::vector<uint8_t>& frame)
+    {
+        auto pos = ring.RecordPayload(ring.write);
+        for (const auto byte : frame) {
+            *pos = byte;
+            pos = ring.Next(pos, 1);
+        }
+    }
+
+    void testRecords(const std::string&)
+    {
+        // one stamp with two samples: 0x11 -> {0xA5} and 0x22 -> {0x01, 0x02}
+        const std::vector<uint8_t> frame {
+            0, 0, 0, 0, 1, 0, 0, 0, 8, 7, 6, 5, 4, 3, 2, 1, 2, 0, 0, 0,
+            0x11, 0, 0, 0, 1, 0, 0, 0, 0xA5,
+            0x22, 0, 0, 0, 2, 0, 0, 0, 0x01, 0x02
+        };
+        const auto length = static_cast<uint32_t>(frame.size());
+        RingBuffer testee { 2 * (RingBuffer::RECORD_HEADER_SIZE + frame.size()) - 3 };
+
+        for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+            fructose_loop_assert(i, testee.RecordFits(length));
+            Store(testee, frame);
+            fructose_loop_assert(i, NotificationDispatcher::IsValidFrame(testee, testee.RecordPayload(testee.write),
+                                                                         length));
+            testee.CommitRecord(length);
+            fructose_loop_assert(i, !testee.RecordFits(length));
+            fructose_loop_assert(i, length == testee.RecordLength());
+
+            const auto payload = testee.RecordPayload(testee.read);
+            const auto sample = testee.Next(payload, frame.size() - 2);
+            fructose_loop_assert(i, 0x0102030405060708 == testee.PeekFromLittleEndian<uint64_t>(testee.Next(payload, 8)));
+            fructose_loop_assert(i, 0x0201 == testee.PeekFromLittleEndian<uint16_t>(sample));
+            testee.ReadRecord();
+            fructose_loop_assert(i, 0 == testee.BytesAvailable());
+        }
+
+        // truncated sample data and an excessive number of stamps are rejected without committing
+        Store(testee, frame);
+        const auto payload = testee.RecordPayload(testee.write);
+        fructose_assert(!NotificationDispatcher::IsValidFrame(testee, payload, length - 1));
+        *testee.Next(payload, 4) = 2;
+        fructose_assert(!NotificationDispatcher::IsValidFrame(testee, payload, length));
+        fructose_assert(!NotificationDispatcher::IsValidFrame(testee, payload, 4));
+        fructose_assert(0 == testee.BytesAvailable());
+    }
+};
+
+struct TestTracer : test_base<TestTracer> {
+    TestTracer(std::ostream& outstream) : out(outstream) {}
+
+    static std::string Dump()
+    {
+        std::stringstream dump;
+        GetTracer().Dump(dump);
+        return dump.str();
+    }
+
+    void testThreadNames(const std::string&)
+    {
+        auto& tracer = GetTracer();
+        std::thread([&]() {
+            tracer.SetThreadName("TestTracer disabled");
+        }).join();
+        std::string late = "TestTracer late";
+        std::thread runningLong;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool started = false;
+        bool record = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            runningLong = std::thread([&]() {
+                tracer.SetThreadName(late);
+                std::unique_lock<std::mutex> lock(mutex);
+                started = true;
+                cv.notify_all();
+                cv.wait(lock, [&]() { return record; });
+                tracer.Instant("test", "late", {});
+            });
+            cv.wait(lock, [&]() { return started; });
+        }
+
+        tracer.Start(0, {});
+        std::thread([&]() {
+            tracer.SetThreadName("TestTracer traced");
+            tracer.Instant("test", "traced", {});
+        }).join();
+        std::thread([&]() {
+            tracer.SetThreadName("TestTracer idle");
+        }).join();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            record = true;
+        }
+        cv.notify_all();
+        runningLong.join();
+        tracer.Stop();
+
+        // only threads with events in the trace are named, also if named before the trace started
+        const auto dump = Dump();
+        fructose_assert(std::string::npos == dump.find("TestTracer disabled"));
+        fructose_assert(std::string::npos != dump.find("TestTracer traced"));
+        fructose_assert(std::string::npos == dump.find("TestTracer idle"));
+        fructose_assert(std::string::npos != dump.find(late));
+
+        // a new trace forgets the names of exited threads
+        tracer.Start(0, {});
+        tracer.Stop();
+        fructose_assert(std::string::npos == Dump().find("TestTracer"));
+    }
+private:
+    std::ostream& out;
 };
 
+struct TestFlatMap : test_base<TestFlatMap> {
+    std::ostream& out;
+
+    TestFlatMap(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    void testCompareWithMap(const std::string&)
+    {
+        FlatMap<uint32_t, std::unique_ptr<uint32_t> > testee;
+        std::map<uint32_t, uint32_t> reference;
+        std::mt19937 random(42);
+        for (int i = 0; i < 100000; ++i) {
+            const uint32_t key = random() % 5000;
+            if (random() % 3) {
+                const auto inserted = testee.emplace(key, std::unique_ptr<uint32_t>(new uint32_t {key}));
+                fructose_loop_assert(i, inserted.second == reference.emplace(key, key).second);
+                fructose_loop_assert(i, key == *inserted.first->second);
+            } else {
+                fructose_loop_assert(i, testee.erase(key) == reference.erase(key));
+            }
+            fructose_loop_assert(i, testee.size() == reference.size());
+        }
+
+        for (const auto& r : reference) {
+            const auto it = testee.find(r.first);
+            fructose_loop_assert(r.first, it != testee.end() && (r.second == *it->second));
+        }
+
+        // erase while iterating, like AmsPort::Close()
+        size_t numVisited = 0;
+        auto it = testee.begin();
+        while (it != testee.end()) {
+            fructose_loop_assert(numVisited, reference.erase(it->first));
+            it = (numVisited++ % 2) ? testee.erase(it) : ++it;
+        }
+        fructose_assert(reference.empty());
+        fructose_assert(testee.size() == (numVisited + 1) / 2);
+    }
+
+    void testAdsKeys(const std::string&)
+    {
+        FlatMap<NotifyKey, int> testee;
+        const AmsAddr first {AmsNetId {192, 168, 0, 1, 1, 1}, AMSPORT_R0_PLC_TC3};
+        const AmsAddr second {AmsNetId {192, 168, 0, 2, 1, 1}, AMSPORT_R0_PLC_TC3};
+        fructose_assert(testee.emplace(NotifyKey {1, first}, 1).second);
+        fructose_assert(testee.emplace(NotifyKey {1, second}, 2).second);
+        fructose_assert(!testee.emplace(NotifyKey {1, first}, 3).second);
+        fructose_assert(1 == testee.find(NotifyKey {1, first})->second);
+        fructose_assert(2 == testee.find(NotifyKey {1, second})->second);
+        fructose_assert(testee.end() == testee.find(NotifyKey {2, first}));
+
+        FlatMap<AmsNetId, int> netIds;
+        netIds[first.netId] = 1;
+        netIds[second.netId] += 2;
+        fructose_assert(2 == netIds.size());
+        fructose_assert(2 == netIds[AmsNetId {"192.168.0.2.1.1"}]);
+    }
+};
+
+struct TestAdsSimulator : test_base<TestAdsSimulator> {
+    static const AmsNetId simNetId;
+    static const AmsAddr sim;
+    std::ostream& out;
+
+    TestAdsSimulator(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    void testSimulatorScript(const std::string&)
+    {
+        const auto script = SimScript::Parse("seed 7 # comment\n"
+                                             "latency * uniform 200 100\n"
+                                             "drop read 0.5\n"
+                                             "error write 1 0x706\n"
+                                             "oversize read_state 0.25 128\n"
+                                             "at 3 burst 10\n");
+        fructose_assert(7 == script.seed);
+        fructose_assert(SimLatency::UNIFORM == script.commands[AoEHeader::WRITE].latency.distribution);
+        fructose_assert(100 == script.commands[AoEHeader::WRITE].latency.a);
+        fructose_assert(200 == script.commands[AoEHeader::WRITE].latency.b);
+        fructose_assert(0.5 == script.commands[AoEHeader::READ].drop);
+        fructose_assert(0 == script.commands[AoEHeader::WRITE].drop);
+        fructose_assert(ADSERR_DEVICE_INVALIDDATA == script.commands[AoEHeader::WRITE].errorCode);
+        fructose_assert(128 == script.oversizeBytes);
+        fructose_assert(1 == script.events.count(3));
+
+        // provide bad scripts
+        fructose_assert_exception(SimScript::Parse("drop read 2"), std::invalid_argument);
+        fructose_assert_exception(SimScript::Parse("drop readx 1"), std::invalid_argument);
+        fructose_assert_exception(SimScript::Parse("latency read normal 5"), std::invalid_argument);
+        fructose_assert_exception(SimScript::Parse("seed 1 2"), std::invalid_argument);
+        fructose_assert_exception(SimScript::Parse("at 1 explode"), std::invalid_argument);
+    }
+
+    void testSimulatorFaults(const std::string&)
+    {
+        Simulator simulator {SimScript::Parse("at 2 drop\n"
+                                              "at 3 error 0x706\n"
+                                              "at 4 oversize\n"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+
+        uint32_t value = 0xDEADBEEF;
+        uint32_t bytesRead;
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &sim, 0x4020, 0, sizeof(value), &value));
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT ==
+                        AdsSyncReadReqEx2(port, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead));
+        fructose_assert(ADSERR_DEVICE_INVALIDDATA ==
+                        AdsSyncReadReqEx2(port, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead));
+        fructose_assert(ADSERR_DEVICE_INVALIDSIZE ==
+                        AdsSyncReadReqEx2(port, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead));
+        value = 0;
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead));
+        fructose_assert(sizeof(value) == bytesRead);
+        fructose_assert(0xDEADBEEF == value);
+
+        const auto stats = simulator.GetStats();
+        fructose_assert(5 == stats.numRequests);
+        fructose_assert(4 == stats.numResponses);
+        fructose_assert(1 == stats.numDropped);
+        fructose_assert(1 == stats.numErrors);
+        fructose_assert(1 == stats.numOversized);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorRecovery(const std::string& testname)
+    {
+        Simulator simulator {SimScript::Parse("at 2 reset"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+
+        uint16_t adsState;
+        uint16_t devState;
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &sim, &adsState, &devState));
+        fructose_assert(ADSSTATE_RUN == adsState);
+
+        const auto start = std::chrono::steady_clock::now();
+        size_t numFailed = 0;
+        while (AdsSyncReadStateReqEx(port, &sim, &adsState, &devState)) {
+            ++numFailed;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        out << testname << " recovered after " << numFailed << " failed requests in " << ms << "ms\n";
+
+        const auto stats = simulator.GetStats();
+        fructose_assert(1 == stats.numResets);
+        fructose_assert(2 == stats.numConnections);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorTimeout(const std::string& testname)
+    {
+        Simulator simulator {SimScript::Parse("at 2 delay 300000"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+
+        uint16_t adsState;
+        uint16_t devState;
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &sim, &adsState, &devState));
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == AdsSyncReadStateReqEx(port, &sim, &adsState, &devState));
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        out << testname << " timed out after " << ms << "ms\n";
+        fructose_assert(100 <= ms);
+        fructose_assert(300 > ms);
+
+        // the late response must not be taken for the response of a later request
+        uint32_t value = 0xDEADBEEF;
+        uint32_t bytesRead;
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &sim, 0x4020, 0, sizeof(value), &value));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        value = 0;
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead));
+        fructose_assert(sizeof(value) == bytesRead);
+        fructose_assert(0xDEADBEEF == value);
+        fructose_assert(1 == simulator.GetStats().numDelayed);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorLargeFrames(const std::string&)
+    {
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // requests are not limited in size
+        std::vector<uint8_t> image(60 * 1024);
+        for (size_t i = 0; i < image.size(); ++i) {
+            image[i] = static_cast<uint8_t>(i * 7);
+        }
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &sim, 0x4020, 0, image.size(), image.data()));
+
+        // responses have to fit into the frame of the port
+        static const uint32_t CHUNK_SIZE = 2048;
+        std::vector<uint8_t> buffer(image.size());
+        uint32_t bytesRead;
+        for (uint32_t offset = 0; offset < image.size(); offset += CHUNK_SIZE) {
+            fructose_loop_assert(offset, 0 == AdsSyncReadReqEx2(port, &sim, 0x4020, offset, CHUNK_SIZE,
+                                                                buffer.data() + offset, &bytesRead));
+            fructose_loop_assert(offset, CHUNK_SIZE == bytesRead);
+        }
+        fructose_assert(image == buffer);
+
+        // larger responses are skipped and the connection stays usable
+        fructose_assert(ADSERR_DEVICE_INVALIDSIZE ==
+                        AdsSyncReadReqEx2(port, &sim, 0x4020, 0, buffer.size(), buffer.data(), &bytesRead));
+        fructose_assert(0 == bytesRead);
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &sim, 0x4020, 0, CHUNK_SIZE, buffer.data(), &bytesRead));
+        fructose_assert(CHUNK_SIZE == bytesRead);
+        fructose_assert(1 == simulator.GetStats().numConnections);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorEndurance(const std::string& testname)
+    {
+        static const size_t NUM_NOTIFICATIONS = 1024;
+        static const auto DURATION = std::chrono::seconds(2);
+        Simulator simulator {SimScript::Parse("latency read uniform 0 500"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // 100ms cycle
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {1000000} };
+        std::vector<uint32_t> handles(NUM_NOTIFICATIONS);
+        for (size_t i = 0; i < handles.size(); ++i) {
+            fructose_loop_assert(i, 0 == AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 4 * i, &attrib,
+                                                                           &NotifyCallback, i, &handles[i]));
+        }
+
+        std::atomic<bool> running {true};
+        size_t numReads = 0;
+        size_t numFailed = 0;
+        std::thread reader([&]() {
+            const long readPort = AdsPortOpenEx();
+            uint32_t value;
+            uint32_t bytesRead;
+            while (running) {
+                numFailed += !!AdsSyncReadReqEx2(readPort, &sim, 0x4020, 0, sizeof(value), &value, &bytesRead);
+                ++numReads;
+            }
+            AdsPortCloseEx(readPort);
+        });
+
+        g_NumNotifications = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(DURATION);
+        running = false;
+        reader.join();
+        const size_t numNotifications = g_NumNotifications;
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        for (size_t i = 0; i < handles.size(); ++i) {
+            fructose_loop_assert(i, 0 == AdsSyncDelDeviceNotificationReqEx(port, &sim, handles[i]));
+        }
+
+        // let the dispatcher drain its backlog, so it doesn't delay the callbacks of the next test
+        for (size_t last = 0; last != g_NumNotifications; ) {
+            last = g_NumNotifications;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        out << testname << ' ' << 1000 * numNotifications / ms << " notifications/s, " << 1000 * numReads / ms <<
+            " reads/s (" << numNotifications << '/' << numReads << '/' << ms << "ms)\n";
+        fructose_assert(0 == numFailed);
+        fructose_assert(NUM_NOTIFICATIONS < numNotifications);
+        fructose_assert(0 < numReads);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorReqMulti(const std::string& testname)
+    {
+        static const size_t NUM_TARGETS = 32;
+        static const uint32_t TIMEOUT = 200;
+        // the first and the last target never answer
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        Simulator deadFirst {SimScript::Parse("drop read_state 1"), IpV4 {"127.0.0.3"}};
+        Simulator deadLast {SimScript::Parse("drop read_state 1"), IpV4 {"127.0.0.4"}};
+        const AmsNetId firstNetId {127, 0, 0, 3, 1, 1};
+        const AmsNetId lastNetId {127, 0, 0, 4, 1, 1};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        fructose_assert(0 == AdsAddRoute(firstNetId, "127.0.0.3"));
+        fructose_assert(0 == AdsAddRoute(lastNetId, "127.0.0.4"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, TIMEOUT));
+
+        std::vector<AmsAddr> targets(NUM_TARGETS, sim);
+        targets.front() = AmsAddr {firstNetId, AMSPORT_R0_PLC_TC3};
+        targets.back() = AmsAddr {lastNetId, AMSPORT_R0_PLC_TC3};
+        std::vector<uint16_t> adsStates(NUM_TARGETS);
+        std::vector<uint16_t> devStates(NUM_TARGETS);
+        std::vector<long> results(NUM_TARGETS);
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(0 == AdsSyncReadStateReqMulti(port, NUM_TARGETS, targets.data(), adsStates.data(),
+                                                      devStates.data(), results.data()));
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        out << testname << " finished after " << ms << "ms\n";
+
+        // the requests to the dead targets time out side by side, not one after the other
+        fructose_assert(ms < 2 * TIMEOUT);
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == results.front());
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == results.back());
+        for (size_t i = 1; i + 1 < NUM_TARGETS; ++i) {
+            fructose_loop_assert(i, 0 == results[i]);
+        }
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(lastNetId);
+        AdsDelRoute(firstNetId);
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorReqMultiConnect(const std::string& testname)
+    {
+        static const size_t NUM_TARGETS = 32;
+        // the first target takes about a second to connect, .5 refuses the connection and .4 only starts
+        // listening halfway through that second, which is too late for a connect made up front
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        Simulator slow {SimScript::Parse("accept_delay 200"), IpV4 {"127.0.0.3"}};
+        std::unique_ptr<Simulator> late;
+        const AmsNetId slowNetId {127, 0, 0, 3, 1, 1};
+        const AmsNetId lateNetId {127, 0, 0, 4, 1, 1};
+        const AmsNetId refusedNetId {127, 0, 0, 5, 1, 1};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        fructose_assert(0 == AdsAddRouteLazy(slowNetId, "127.0.0.3"));
+        fructose_assert(0 == AdsAddRouteLazy(lateNetId, "127.0.0.4"));
+        fructose_assert(0 == AdsAddRouteLazy(refusedNetId, "127.0.0.5"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        std::vector<AmsAddr> targets(NUM_TARGETS, sim);
+        targets[0] = AmsAddr {slowNetId, AMSPORT_R0_PLC_TC3};
+        targets[1] = AmsAddr {refusedNetId, AMSPORT_R0_PLC_TC3};
+        targets[NUM_TARGETS / 2] = AmsAddr {refusedNetId, AMSPORT_R0_PLC_TC3};
+        targets[NUM_TARGETS - 1] = AmsAddr {lateNetId, AMSPORT_R0_PLC_TC3};
+        std::vector<uint16_t> adsStates(NUM_TARGETS);
+        std::vector<uint16_t> devStates(NUM_TARGETS);
+        std::vector<long> results(NUM_TARGETS);
+        std::thread starter([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            late.reset(new Simulator {SimScript {}, IpV4 {"127.0.0.4"}});
+        });
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(0 == AdsSyncReadStateReqMulti(port, NUM_TARGETS, targets.data(), adsStates.data(),
+                                                      devStates.data(), results.data()));
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        starter.join();
+        out << testname << " finished after " << ms << "ms\n";
+
+        // all targets were connected side by side before the first request, each only once
+        fructose_assert(ms < 1500);
+        fructose_assert(1 == slow.GetStats().numRequests);
+        fructose_assert(0 == late->GetStats().numRequests);
+        for (size_t i = 0; i < NUM_TARGETS; ++i) {
+            const bool refused = FlatKey<AmsNetId>::Equal(targets[i].netId, refusedNetId) ||
+                                 FlatKey<AmsNetId>::Equal(targets[i].netId, lateNetId);
+            fructose_loop_assert(i, (refused ? GLOBALERR_MISSING_ROUTE : 0) == results[i]);
+        }
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(refusedNetId);
+        AdsDelRoute(lateNetId);
+        AdsDelRoute(slowNetId);
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorLoadRoutes(const std::string&)
+    {
+        static const char* const path = "testSimulatorLoadRoutes.txt";
+        Simulator first {SimScript {}, IpV4 {"127.0.0.2"}};
+        Simulator second {SimScript {}, IpV4 {"127.0.0.3"}};
+        Simulator third {SimScript {}, IpV4 {"127.0.0.4"}};
+        const AmsNetId netIds[] = {
+            AmsNetId {127, 0, 0, 2, 1, 1}, AmsNetId {127, 0, 0, 3, 1, 1}, AmsNetId {127, 0, 0, 4, 1, 1},
+            AmsNetId {127, 0, 0, 5, 1, 1}
+        };
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        uint16_t adsState;
+        uint16_t devState;
+
+        // each route is connected and reported, the refused one as the first error
+        std::ofstream(path) << "# simulators\n"
+                            << "127.0.0.2.1.1 127.0.0.2\n"
+                            << "\n"
+                            << "127.0.0.3.1.1  127.0.0.3\n"
+                            << "127.0.0.4.1.1\t127.0.0.4\n"
+                            << "127.0.0.5.1.1 127.0.0.5\n";
+        g_RouteStatus.clear();
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, AdsLoadRoutes(path, false, &RouteStatusCallback, 0));
+        fructose_assert_eq(size_t {4}, g_RouteStatus.size());
+        fructose_assert_eq(0, g_RouteStatus["127.0.0.2"]);
+        fructose_assert_eq(0, g_RouteStatus["127.0.0.3"]);
+        fructose_assert_eq(0, g_RouteStatus["127.0.0.4"]);
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, g_RouteStatus["127.0.0.5"]);
+        for (size_t i = 0; i < 3; ++i) {
+            const AmsAddr addr {netIds[i], AMSPORT_R0_PLC_TC3};
+            fructose_loop_assert(i, 0 == AdsSyncReadStateReqEx(port, &addr, &adsState, &devState));
+        }
+        for (const auto& netId : netIds) {
+            AdsDelRoute(netId);
+        }
+
+        // a malformed line rejects the whole file
+        std::ofstream(path) << "127.0.0.2.1.1 127.0.0.2\n"
+                            << "127.0.0.3.1.1\n";
+        g_RouteStatus.clear();
+        fructose_assert_eq(ADSERR_DEVICE_SYNTAX, AdsLoadRoutes(path, false, &RouteStatusCallback, 0));
+        fructose_assert(g_RouteStatus.empty());
+        const AmsAddr addr {netIds[0], AMSPORT_R0_PLC_TC3};
+        fructose_assert_eq(GLOBALERR_MISSING_ROUTE, AdsSyncReadStateReqEx(port, &addr, &adsState, &devState));
+
+        fructose_assert_eq(ADSERR_DEVICE_NOTFOUND, AdsLoadRoutes("missing/routes.txt", false, nullptr, 0));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        std::remove(path);
+    }
+
+    void testSimulatorIdleTimeout(const std::string&)
+    {
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        AdsSetIdleTimeout(20);
+
+        // pauses around the idle timeout let the reaper close the connection right before requests
+        uint16_t adsState;
+        uint16_t devState;
+        for (size_t i = 0; i < 20; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(15 + i % 3 * 5));
+            fructose_loop_assert(i, 0 == AdsSyncReadStateReqEx(port, &sim, &adsState, &devState));
+        }
+        AdsSetIdleTimeout(0);
+        fructose_assert(1 < simulator.GetStats().numConnections);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorNotificationBurst(const std::string&)
+    {
+        Simulator simulator {SimScript::Parse("at 2 burst 100"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // with a cycle time of 10s all notifications, except the initial one, come from the burst
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {100000000} };
+        uint32_t hNotify;
+        uint16_t adsState;
+        uint16_t devState;
+        g_NumNotifications = 0;
+        fructose_assert(0 == AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 0, &attrib, &NotifyCallback, 0,
+                                                               &hNotify));
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &sim, &adsState, &devState));
+        for (size_t i = 0; (i < 100) && (g_NumNotifications < 101); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        fructose_assert(101 == g_NumNotifications);
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &sim, hNotify));
+        fructose_assert(101 == simulator.GetStats().numNotifications);
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorCallbackStats(const std::string&)
+    {
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {100000000} };
+        uint32_t hNotify;
+        g_InBlockingCallback = false;
+        g_ReleaseCallback = false;
+        fructose_assert(0 == AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 0, &attrib, &BlockingCallback, 0,
+                                                               &hNotify));
+        for (size_t i = 0; (i < 100) && !g_InBlockingCallback; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        fructose_assert(g_InBlockingCallback);
+
+        // statistics are available while the callback still runs
+        AdsCallbackStats stats[2];
+        uint32_t numStats = 2;
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(0 == AdsGetCallbackStatsEx(port, stats, &numStats));
+        fructose_assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+        fructose_assert(1 == numStats);
+        fructose_assert(hNotify == stats[0].hNotify);
+        fructose_assert(0 == stats[0].numCalls);
+        g_ReleaseCallback = true;
+
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &sim, hNotify));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorNotificationTeardown(const std::string&)
+    {
+        static const size_t NUM_NOTIFICATIONS = 600;
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {100000000} };
+        const auto subscribe = [&](long port) {
+            for (size_t i = 0; i < NUM_NOTIFICATIONS; ++i) {
+                uint32_t hNotify;
+                fructose_loop_assert(i, 0 == AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 0, &attrib,
+                                                                                &NotifyCallback, 0, &hNotify));
+            }
+        };
+
+        {
+            Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+            fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+            long port = AdsPortOpenEx();
+            subscribe(port);
+            auto numRequests = simulator.GetStats().numRequests;
+            fructose_assert(0 == AdsPortCloseEx(port));
+            fructose_assert(2 == simulator.GetStats().numRequests - numRequests);
+
+            // deleting the route tears down its notifications, so closing the port sends nothing
+            port = AdsPortOpenEx();
+            subscribe(port);
+            numRequests = simulator.GetStats().numRequests;
+            AdsDelRoute(simNetId);
+            fructose_assert(2 == simulator.GetStats().numRequests - numRequests);
+            fructose_assert(0 == AdsPortCloseEx(port));
+            fructose_assert(2 == simulator.GetStats().numRequests - numRequests);
+        }
+
+        // an unresponsive device costs a single timeout
+        Simulator simulator {SimScript::Parse("drop read_write 1"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+        subscribe(port);
+        subscribe(port);
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(0 == AdsPortCloseEx(port));
+        const auto duration = std::chrono::steady_clock::now() - start;
+        fructose_assert(duration < std::chrono::milliseconds(200));
+        fructose_assert(1 == simulator.GetStats().numDropped);
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorBits(const std::string&)
+    {
+        static const uint32_t IMAGE_SIZE = 8192;
+        static const uint32_t CHUNK_SIZE = 2048;
+        Simulator simulator {SimScript {}, IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        std::vector<uint8_t> image(IMAGE_SIZE);
+        for (size_t i = 0; i < image.size(); ++i) {
+            image[i] = static_cast<uint8_t>(i * 7);
+        }
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &sim, ADSIGRP_IOIMAGE_RWOB, 0, IMAGE_SIZE, image.data()));
+
+        // every third bit of the image takes only a few sum up requests
+        std::vector<uint32_t> bits;
+        for (uint32_t bit = 0; bit < IMAGE_SIZE * 8; bit += 3) {
+            bits.push_back(bit);
+        }
+        std::vector<uint8_t> values((bits.size() + 7) / 8);
+        const auto numRequests = simulator.GetStats().numRequests;
+        fructose_assert(0 == AdsSyncReadBitsReqEx(port, &sim, ADSIGRP_IOIMAGE_RWOX, bits.size(), bits.data(),
+                                                  values.data()));
+        fructose_assert(simulator.GetStats().numRequests - numRequests <= 3);
+        for (size_t i = 0; i < bits.size(); ++i) {
+            const bool expected = image[bits[i] / 8] & (1 << (bits[i] % 8));
+            fructose_loop_assert(i, expected == !!(values[i / 8] & (1 << (i % 8))));
+        }
+
+        // invert the addressed bits, all others are preserved
+        for (auto& v : values) {
+            v = ~v;
+        }
+        fructose_assert(0 == AdsSyncWriteBitsReqEx(port, &sim, ADSIGRP_IOIMAGE_RWOX, bits.size(), bits.data(),
+                                                   values.data()));
+        for (const auto bit : bits) {
+            image[bit / 8] ^= 1 << (bit % 8);
+        }
+        std::vector<uint8_t> readBack(IMAGE_SIZE);
+        uint32_t bytesRead;
+        for (uint32_t offset = 0; offset < IMAGE_SIZE; offset += CHUNK_SIZE) {
+            fructose_assert(0 == AdsSyncReadReqEx2(port, &sim, ADSIGRP_IOIMAGE_RWOB, offset, CHUNK_SIZE,
+                                                   readBack.data() + offset, &bytesRead));
+        }
+        fructose_assert(image == readBack);
+
+        // scattered, unsorted and duplicate addresses
+        const uint32_t scattered[] = { 4000 * 8 + 7, 5, 13 * 8 + 1, 5 };
+        uint8_t scatteredValues = 0;
+        fructose_assert(0 == AdsSyncReadBitsReqEx(port, &sim, ADSIGRP_IOIMAGE_RWOX, 4, scattered, &scatteredValues));
+        for (size_t i = 0; i < 4; ++i) {
+            const bool expected = image[scattered[i] / 8] & (1 << (scattered[i] % 8));
+            fructose_loop_assert(i, expected == !!(scatteredValues & (1 << i)));
+        }
+
+        // provide byte addressed index group
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncReadBitsReqEx(port, &sim, ADSIGRP_IOIMAGE_RWOB, 4, scattered, &scatteredValues));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+
+    void testSimulatorFiles(const std::string& testname)
+    {
+        static const uint32_t FILE_SIZE = 300000;
+        static const char localPath[] = "AdsLibTest.download";
+        const AmsAddr sysServ {simNetId, AMSPORT_R3_SYSSERV};
+        Simulator simulator {SimScript::Parse("latency * fixed 5000"), IpV4 {"127.0.0.2"}};
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.2"));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        std::vector<uint8_t> data(FILE_SIZE);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>(i * 13);
+        }
+        uint32_t hFile;
+        fructose_assert(0 == AdsFileOpenEx(port, &sysServ, "C:\\Temp\\boot.bin", FOPEN_PATH_GENERIC | FOPEN_WRITE |
+                                           FOPEN_BINARY, &hFile));
+        fructose_assert(0 == AdsFileWriteEx(port, &sysServ, hFile, FILE_SIZE, data.data()));
+        fructose_assert(0 == AdsFileCloseEx(port, &sysServ, hFile));
+
+        // 74 chunks with 5ms latency each take 370ms one after another
+        std::vector<uint8_t> readBack(FILE_SIZE + 1000);
+        uint32_t bytesRead = 0;
+        fructose_assert(0 == AdsFileOpenEx(port, &sysServ, "C:\\Temp\\boot.bin", FOPEN_PATH_GENERIC | FOPEN_READ |
+                                           FOPEN_BINARY, &hFile));
+        const auto start = std::chrono::steady_clock::now();
+        fructose_assert(0 == AdsFileReadEx(port, &sysServ, hFile, readBack.size(), readBack.data(), &bytesRead));
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              start).count();
+        out << testname << " read " << bytesRead << " bytes in " << ms << "ms\n";
+        fructose_assert(ms < 185);
+        fructose_assert(FILE_SIZE == bytesRead);
+        readBack.resize(bytesRead);
+        fructose_assert(data == readBack);
+        fructose_assert(0 == AdsFileCloseEx(port, &sysServ, hFile));
+
+        uint64_t bytesCopied = 0;
+        fructose_assert(0 == AdsFileDownloadEx(port, &sysServ, "C:\\Temp\\boot.bin", FOPEN_PATH_GENERIC, localPath,
+                                               &bytesCopied));
+        fructose_assert(FILE_SIZE == bytesCopied);
+        {
+            std::ifstream file(localPath, std::ios::binary);
+            const std::vector<uint8_t> downloaded {std::istreambuf_iterator<char>(file),
+                                                   std::istreambuf_iterator<char>()};
+            fructose_assert(data == downloaded);
+        }
+        fructose_assert(0 == AdsFileUploadEx(port, &sysServ, localPath, "C:\\Temp\\copy.bin", FOPEN_PATH_GENERIC));
+        std::remove(localPath);
+
+        g_FileEntries.clear();
+        fructose_assert(0 == AdsFileFindEx(port, &sysServ, "C:\\Temp\\*.bin", FOPEN_PATH_GENERIC,
+                                           &FileEntryCallback, 0));
+        fructose_assert(2 == g_FileEntries.size());
+        for (const auto& entry : g_FileEntries) {
+            fructose_assert(FILE_SIZE == entry.size);
+        }
+        fructose_assert(std::string("C:\\Temp\\copy.bin") == g_FileEntries.back().name);
+
+        // provide unknown files
+        fructose_assert(ADSERR_DEVICE_NOTFOUND ==
+                        AdsFileOpenEx(port, &sysServ, "C:\\Temp\\none.bin", FOPEN_PATH_GENERIC | FOPEN_READ,
+                                      &hFile));
+        fructose_assert(ADSERR_DEVICE_NOTFOUND ==
+                        AdsFileUploadEx(port, &sysServ, localPath, "C:\\Temp\\none.bin", FOPEN_PATH_GENERIC));
+        g_FileEntries.clear();
+        fructose_assert(0 == AdsFileFindEx(port, &sysServ, "C:\\Temp\\*.log", FOPEN_PATH_GENERIC,
+                                           &FileEntryCallback, 0));
+        fructose_assert(g_FileEntries.empty());
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+    }
+};
+const AmsNetId TestAdsSimulator::simNetId {127, 0, 0, 2, 1, 1};
+const AmsAddr TestAdsSimulator::sim {TestAdsSimulator::simNetId, AMSPORT_R0_PLC_TC3};
+
 struct TestAds : test_base<TestAds> {
     static const int NUM_TEST_LOOPS = 10;
     std::ostream& out;
@@ -288,6 +1308,36 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsPortCloseEx(port[0]));
     }
 
+    void testAdsAutoPort(const std::string&)
+    {
+        AmsAddr first;
+        AmsAddr again;
+        AmsAddr second;
+
+        // the same port is used by all calls of one thread
+        fructose_assert(0 == AdsGetLocalAddressEx(ADSPORT_AUTO, &first));
+        fructose_assert(0 == AdsGetLocalAddressEx(ADSPORT_AUTO, &again));
+        fructose_assert(first.port == again.port);
+
+        // other threads use their own port, which is closed at thread exit
+        std::thread([&]() {
+            fructose_assert(0 == AdsGetLocalAddressEx(ADSPORT_AUTO, &second));
+        }).join();
+        fructose_assert(first.port != second.port);
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsPortCloseEx(second.port));
+
+        fructose_assert(0 == AdsPortCloseEx(ADSPORT_AUTO));
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsPortCloseEx(first.port));
+
+        // closing an unused automatic port doesn't open one
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsPortCloseEx(ADSPORT_AUTO));
+        std::thread([&]() {
+            fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsPortCloseEx(ADSPORT_AUTO));
+            fructose_assert(0 == AdsGetLocalAddressEx(ADSPORT_AUTO, &second));
+            fructose_assert(0 == AdsPortCloseEx(ADSPORT_AUTO));
+        }).join();
+    }
+
     void testAdsReadReqEx2(const std::string&)
     {
         const long port = AdsPortOpenEx();
@@ -423,6 +1473,124 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    void testAdsRequestTiming(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        AdsResetRequestTiming();
+        AdsEnableRequestTiming(true, 2);
+        uint16_t adsState;
+        uint16_t devState;
+        for (int i = 0; i < 4; ++i) {
+            fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+        }
+        AdsEnableRequestTiming(false, 0);
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+
+        // every stage saw each of the timed requests
+        AdsHistogram histogram;
+        for (int stage = ADS_STAGE_QUEUE; stage < ADS_STAGE_COUNT; ++stage) {
+            fructose_assert(0 == AdsGetRequestStageHistogram(static_cast<AdsRequestStage>(stage), &histogram));
+            fructose_assert(4 == histogram.count);
+        }
+
+        // only every second request was sampled
+        AdsRequestTiming timings[8];
+        uint32_t numTimings = 8;
+        fructose_assert(0 == AdsGetRequestTimeline(timings, &numTimings));
+        fructose_assert(2 == numTimings);
+        fructose_assert(0 == timings[0].result);
+        fructose_assert(ADSSRVID_READSTATE == timings[0].cmdId);
+        fructose_assert(timings[0].start <= timings[1].start);
+
+        // provide bad parameters
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetRequestStageHistogram(ADS_STAGE_COUNT, &histogram));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetRequestStageHistogram(ADS_STAGE_WIRE, nullptr));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetRequestTimeline(nullptr, &numTimings));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetRequestTimeline(timings, nullptr));
+
+        AdsResetRequestTiming();
+        numTimings = 8;
+        fructose_assert(0 == AdsGetRequestTimeline(timings, &numTimings));
+        fructose_assert(0 == numTimings);
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsTrace(const std::string&)
+    {
+        static const char* const path = "AdsLibTest_trace.json";
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        AdsTraceStart(0, nullptr);
+        uint16_t adsState;
+        uint16_t devState;
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+        AdsTraceStop();
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+
+        fructose_assert(0 == AdsTraceDump(path));
+        std::ifstream file(path);
+        std::stringstream trace;
+        trace << file.rdbuf();
+        fructose_assert(0 == trace.str().find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        const auto first = trace.str().find("\"name\":\"ReadState\"");
+        fructose_assert(std::string::npos != first);
+        fructose_assert(std::string::npos == trace.str().find("\"name\":\"ReadState\"", first + 1));
+        std::remove(path);
+
+        // provide bad parameters
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsTraceDump(nullptr));
+        fructose_assert(ADSERR_DEVICE_ACCESSDENIED == AdsTraceDump("nonexistent/trace.json"));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsReadStateReqMulti(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        static const uint32_t NUM_TARGETS = 4;
+        const AmsAddr unknown { { 1, 2, 3, 4, 5, 6 }, AMSPORT_R0_PLC_TC3 };
+        const AmsAddr targets[NUM_TARGETS] = { server, serverBadPort, unknown, server };
+        uint16_t adsState[NUM_TARGETS];
+        uint16_t devState[NUM_TARGETS];
+        long results[NUM_TARGETS];
+        fructose_assert(0 == AdsSyncReadStateReqMulti(port, NUM_TARGETS, targets, adsState, devState, results));
+        fructose_assert(0 == results[0]);
+        fructose_assert(ADSSTATE_RUN == adsState[0]);
+        fructose_assert(GLOBALERR_TARGET_PORT == results[1]);
+        fructose_assert(GLOBALERR_MISSING_ROUTE == results[2]);
+        fructose_assert(0 == results[3]);
+        fructose_assert(ADSSTATE_RUN == adsState[3]);
+
+        char devName[NUM_TARGETS * DEVICE_NAME_LENGTH];
+        AdsVersion version[NUM_TARGETS];
+        fructose_assert(0 == AdsSyncReadDeviceInfoReqMulti(port, NUM_TARGETS, targets, devName, version, results));
+        fructose_assert(0 == results[0]);
+        fructose_assert(0 == strncmp(devName, "Plc30 App", DEVICE_NAME_LENGTH));
+        fructose_assert(GLOBALERR_MISSING_ROUTE == results[2]);
+        fructose_assert(0 == results[3]);
+        fructose_assert(0 == strncmp(devName + 3 * DEVICE_NAME_LENGTH, "Plc30 App", DEVICE_NAME_LENGTH));
+
+        uint32_t buffer[NUM_TARGETS];
+        uint32_t bytesRead[NUM_TARGETS];
+        fructose_assert(0 ==
+                        AdsSyncReadReqMulti(port, NUM_TARGETS, targets, 0x4020, 0, sizeof(buffer[0]), buffer, bytesRead,
+                                            results));
+        fructose_assert(0 == results[0]);
+        fructose_assert(sizeof(buffer[0]) == bytesRead[0]);
+        fructose_assert(GLOBALERR_MISSING_ROUTE == results[2]);
+        fructose_assert(0 == results[3]);
+        fructose_assert(buffer[0] == buffer[3]);
+
+        // provide nullptr to results
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncReadStateReqMulti(port, NUM_TARGETS, targets, adsState, devState, nullptr));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
     void testAdsReadWriteReqEx2(const std::string&)
     {
         char handleName[] = "MAIN.byByte";
@@ -616,6 +1784,57 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    void testAdsWriteVerifyReqEx(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        print(server, out);
+
+        uint32_t readBack;
+        uint32_t outBuffer = 0xDEADBEEF;
+        bool mismatch;
+        for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+            readBack = ~outBuffer;
+            mismatch = true;
+            fructose_loop_assert(i, 0 == AdsSyncWriteVerifyReqEx(port,
+                                                                 &server,
+                                                                 0x4020,
+                                                                 0,
+                                                                 sizeof(outBuffer),
+                                                                 &outBuffer,
+                                                                 &readBack,
+                                                                 &mismatch));
+            fructose_loop_assert(i, !mismatch);
+            fructose_loop_assert(i, outBuffer == readBack);
+            outBuffer = ~outBuffer;
+        }
+
+        // provide out of range port
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN ==
+                        AdsSyncWriteVerifyReqEx(0, &server, 0x4020, 0, sizeof(outBuffer), &outBuffer, &readBack,
+                                                &mismatch));
+
+        // provide nullptr to AmsAddr
+        fructose_assert(ADSERR_CLIENT_NOAMSADDR ==
+                        AdsSyncWriteVerifyReqEx(port, nullptr, 0x4020, 0, sizeof(outBuffer), &outBuffer, &readBack,
+                                                &mismatch));
+
+        // provide nullptr to readBack
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncWriteVerifyReqEx(port, &server, 0x4020, 0, sizeof(outBuffer), &outBuffer, nullptr,
+                                                &mismatch));
+
+        // provide invalid indexGroup
+        fructose_assert(ADSERR_DEVICE_SRVNOTSUPP ==
+                        AdsSyncWriteVerifyReqEx(port, &server, 0, 0, sizeof(outBuffer), &outBuffer, &readBack,
+                                                &mismatch));
+
+        const uint32_t defaultValue = 0;
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &server, 0x4020, 0, sizeof(defaultValue), &defaultValue));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
     void testAdsWriteControlReqEx(const std::string&)
     {
         const long port = AdsPortOpenEx();
@@ -735,6 +1954,149 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    void testAdsCallbackStats(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        AdsNotificationAttrib attrib = { 1, ADSTRANS_SERVERCYCLE, 0, {1000000} };
+        uint32_t fast;
+        uint32_t slow;
+        AdsSetCallbackBudget(1000, 90, &DispatcherEvent, 0);
+        g_NumSlowCallbacks = 0;
+        fructose_assert(0 == AdsSyncAddDeviceNotificationReqEx(port, &server, 0x4020, 4, &attrib, &NotifyCallback, 0,
+                                                               &fast));
+        fructose_assert(0 == AdsSyncAddDeviceNotificationReqEx(port, &server, 0x4020, 4, &attrib, &SlowCallback, 0,
+                                                               &slow));
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &server, slow));
+
+        // the slow callback was removed already
+        AdsCallbackStats stats[2];
+        uint32_t numStats = 2;
+        fructose_assert(0 == AdsGetCallbackStatsEx(port, stats, &numStats));
+        fructose_assert(1 == numStats);
+        fructose_assert(fast == stats[0].hNotify);
+        fructose_assert(0 < stats[0].numCalls);
+        fructose_assert(0 == stats[0].numOverBudget);
+        fructose_assert(0 < g_NumSlowCallbacks);
+        AdsSetCallbackBudget(0, 0, nullptr, 0);
+
+        // provide bad parameters
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetCallbackStatsEx(port, nullptr, &numStats));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetCallbackStatsEx(port, stats, nullptr));
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsGetCallbackStatsEx(0, stats, &numStats));
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &server, fast));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsLockStats(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+#ifdef CONFIG_ADSLIB_LOCK_STATS
+        fructose_assert(0 == AdsEnableLockStats(true));
+#else
+        fructose_assert(ADSERR_DEVICE_SRVNOTSUPP == AdsEnableLockStats(true));
+#endif
+        AdsResetLockStats();
+        uint16_t adsState;
+        uint16_t devState;
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+        fructose_assert(0 == AdsEnableLockStats(false));
+
+        AdsLockStats stats[32];
+        uint32_t numStats = 32;
+        fructose_assert(0 == AdsGetLockStats(stats, &numStats));
+#ifdef CONFIG_ADSLIB_LOCK_STATS
+        const auto router = std::find_if(stats, stats + numStats, [](const AdsLockStats& s) {
+            return std::string("AmsRouter::mutex") == s.name;
+        });
+        fructose_assert(router != stats + numStats);
+        fructose_assert(0 < router->numAcquired);
+#else
+        // without profiled mutexes no lock registers its name
+        fructose_assert(0 == numStats);
+#endif
+
+        // provide bad parameters
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetLockStats(nullptr, &numStats));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetLockStats(stats, nullptr));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsMetrics(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        uint16_t adsState;
+        uint16_t devState;
+        fructose_assert(0 == AdsSyncReadStateReqEx(port, &server, &adsState, &devState));
+
+        char tooSmall[8];
+        uint32_t length = 0;
+        fructose_assert(ADSERR_DEVICE_INVALIDSIZE == AdsGetMetrics(tooSmall, sizeof(tooSmall), &length));
+        fructose_assert(sizeof(tooSmall) < length);
+
+        std::vector<char> buffer(length + 1);
+        uint32_t bytesWritten = 0;
+        fructose_assert(0 == AdsGetMetrics(buffer.data(), buffer.size(), &bytesWritten));
+        const std::string text(buffer.data());
+        fructose_assert(text.size() == bytesWritten);
+        fructose_assert(std::string::npos != text.find("# TYPE ads_requests counter\n"));
+        fructose_assert(std::string::npos != text.find("ads_request_rtt_seconds_count{ip="));
+        fructose_assert(text.size() - 6 == text.rfind("# EOF\n"));
+
+        static std::string written;
+        fructose_assert(0 == AdsWriteMetrics([](const char* data, uint32_t size, uint32_t) {
+            written.assign(data, size);
+        }, 0));
+        fructose_assert(0 == written.find("# TYPE "));
+
+        // provide bad parameters
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetMetrics(nullptr, 0, &length));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetMetrics(buffer.data(), buffer.size(), nullptr));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsWriteMetrics(nullptr, 0));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsMemoryUsage(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        AdsMemoryUsage total;
+        AdsMemoryUsage route;
+        fructose_assert(0 == AdsGetMemoryUsage(nullptr, &total));
+        fructose_assert(0 == AdsGetMemoryUsage(&serverNetId, &route));
+        fructose_assert(0 < route.bytes[ADS_MEM_RESPONSE_FRAMES]);
+        fructose_assert(route.total <= total.total);
+        fructose_assert(0 == total.budget);
+
+        // a new notification receive buffer doesn't fit into the budget
+        AdsNotificationAttrib attrib = { 1, ADSTRANS_SERVERCYCLE, 0, {1000000} };
+        uint32_t hNotify;
+        AdsSetMemoryBudget(total.total + 1);
+        fructose_assert(GLOBALERR_NO_MEMORY ==
+                        AdsSyncAddDeviceNotificationReqEx(port, &server, 0x4020, 4, &attrib, &NotifyCallback, 0,
+                                                          &hNotify));
+        AdsSetMemoryBudget(0);
+        fructose_assert(0 == AdsSyncAddDeviceNotificationReqEx(port, &server, 0x4020, 4, &attrib, &NotifyCallback, 0,
+                                                               &hNotify));
+        fructose_assert(0 == AdsGetMemoryUsage(&serverNetId, &route));
+        fructose_assert(0 < route.bytes[ADS_MEM_NOTIFICATION_RING]);
+        fructose_assert(0 < route.bytes[ADS_MEM_NOTIFICATION_BUFFERS]);
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &server, hNotify));
+
+        // provide bad parameters
+        const AmsNetId unknown { 1, 2, 3, 4, 5, 6 };
+        fructose_assert(GLOBALERR_MISSING_ROUTE == AdsGetMemoryUsage(&unknown, &route));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetMemoryUsage(nullptr, nullptr));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
     void testAdsTimeout(const std::string&)
     {
         const long port = AdsPortOpenEx();
@@ -918,6 +2280,9 @@ int main()
     TestAmsRouter routerTest(errorstream);
     routerTest.add_test("testAmsRouterAddRoute", &TestAmsRouter::testAmsRouterAddRoute);
     routerTest.add_test("testAmsRouterDelRoute", &TestAmsRouter::testAmsRouterDelRoute);
+    routerTest.add_test("testAmsRouterAddRouteLazy", &TestAmsRouter::testAmsRouterAddRouteLazy);
+    routerTest.add_test("testAmsRouterAddRoutes", &TestAmsRouter::testAmsRouterAddRoutes);
+    routerTest.add_test("testAmsRouterPollingMode", &TestAmsRouter::testAmsRouterPollingMode);
 //    routerTest.add_test("testConcurrentRoutes", &TestAmsRouter::testConcurrentRoutes);
     routerTest.run();
 
@@ -925,20 +2290,57 @@ int main()
     ipv4Test.add_test("testComparsion", &TestIpV4::testComparsion);
     ipv4Test.run();
 
+    TestTracer tracerTest(errorstream);
+    tracerTest.add_test("testThreadNames", &TestTracer::testThreadNames);
+    tracerTest.run();
+
     TestRingBuffer ringBufferTest(errorstream);
     ringBufferTest.add_test("testBytesFree", &TestRingBuffer::testBytesFree);
     ringBufferTest.add_test("testWriteChunk", &TestRingBuffer::testWriteChunk);
+    ringBufferTest.add_test("testRecords", &TestRingBuffer::testRecords);
     ringBufferTest.run();
+
+    TestFlatMap flatMapTest(errorstream);
+    flatMapTest.add_test("testCompareWithMap", &TestFlatMap::testCompareWithMap);
+    flatMapTest.add_test("testAdsKeys", &TestFlatMap::testAdsKeys);
+    flatMapTest.run();
 #endif
+    TestAdsSimulator simulatorTest(errorstream);
+    simulatorTest.add_test("testSimulatorScript", &TestAdsSimulator::testSimulatorScript);
+    simulatorTest.add_test("testSimulatorFaults", &TestAdsSimulator::testSimulatorFaults);
+    simulatorTest.add_test("testSimulatorRecovery", &TestAdsSimulator::testSimulatorRecovery);
+    simulatorTest.add_test("testSimulatorTimeout", &TestAdsSimulator::testSimulatorTimeout);
+    simulatorTest.add_test("testSimulatorLargeFrames", &TestAdsSimulator::testSimulatorLargeFrames);
+    simulatorTest.add_test("testSimulatorEndurance", &TestAdsSimulator::testSimulatorEndurance);
+    simulatorTest.add_test("testSimulatorReqMulti", &TestAdsSimulator::testSimulatorReqMulti);
+    simulatorTest.add_test("testSimulatorReqMultiConnect", &TestAdsSimulator::testSimulatorReqMultiConnect);
+    simulatorTest.add_test("testSimulatorLoadRoutes", &TestAdsSimulator::testSimulatorLoadRoutes);
+    simulatorTest.add_test("testSimulatorIdleTimeout", &TestAdsSimulator::testSimulatorIdleTimeout);
+    simulatorTest.add_test("testSimulatorNotificationBurst", &TestAdsSimulator::testSimulatorNotificationBurst);
+    simulatorTest.add_test("testSimulatorCallbackStats", &TestAdsSimulator::testSimulatorCallbackStats);
+    simulatorTest.add_test("testSimulatorNotificationTeardown", &TestAdsSimulator::testSimulatorNotificationTeardown);
+    simulatorTest.add_test("testSimulatorBits", &TestAdsSimulator::testSimulatorBits);
+    simulatorTest.add_test("testSimulatorFiles", &TestAdsSimulator::testSimulatorFiles);
+    simulatorTest.run();
+
     TestAds adsTest(errorstream);
     adsTest.add_test("testAdsPortOpenEx", &TestAds::testAdsPortOpenEx);
+    adsTest.add_test("testAdsAutoPort", &TestAds::testAdsAutoPort);
     adsTest.add_test("testAdsReadReqEx2", &TestAds::testAdsReadReqEx2);
     adsTest.add_test("testAdsReadDeviceInfoReqEx", &TestAds::testAdsReadDeviceInfoReqEx);
     adsTest.add_test("testAdsReadStateReqEx", &TestAds::testAdsReadStateReqEx);
+    adsTest.add_test("testAdsRequestTiming", &TestAds::testAdsRequestTiming);
+    adsTest.add_test("testAdsTrace", &TestAds::testAdsTrace);
+    adsTest.add_test("testAdsReadStateReqMulti", &TestAds::testAdsReadStateReqMulti);
     adsTest.add_test("testAdsReadWriteReqEx2", &TestAds::testAdsReadWriteReqEx2);
     adsTest.add_test("testAdsWriteReqEx", &TestAds::testAdsWriteReqEx);
+    adsTest.add_test("testAdsWriteVerifyReqEx", &TestAds::testAdsWriteVerifyReqEx);
     adsTest.add_test("testAdsWriteControlReqEx", &TestAds::testAdsWriteControlReqEx);
     adsTest.add_test("testAdsNotification", &TestAds::testAdsNotification);
+    adsTest.add_test("testAdsCallbackStats", &TestAds::testAdsCallbackStats);
+    adsTest.add_test("testAdsLockStats", &TestAds::testAdsLockStats);
+    adsTest.add_test("testAdsMetrics", &TestAds::testAdsMetrics);
+    adsTest.add_test("testAdsMemoryUsage", &TestAds::testAdsMemoryUsage);
     adsTest.add_test("testAdsTimeout", &TestAds::testAdsTimeout);
     adsTest.run();
 
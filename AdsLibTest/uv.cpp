@@ -0,0 +1,139 @@
+#include "AdsUv.h"
+#include "AdsSimulator/Simulator.h"
+
+#include <functional>
+#include <iostream>
+
+#include <fructose/fructose.h>
+using namespace fructose;
+
+/**
+ * Runs the polling mode on a libuv loop against the simulator. The polling mode
+ * applies to the whole process, so the adapter gets a test binary of its own.
+ * Skipped, if libuv is not installed. Headers and library in other locations
+ * are given with UV_CFLAGS and UV_LIBS, e.g. for a runtime only libuv 1.44
+ * with the headers bundled by node:
+ *   make testUv UV_CFLAGS=-I$NODE/include/node UV_LIBS=/lib/x86_64-linux-gnu/libuv.so.1
+ */
+static const AmsNetId simNetId {127, 0, 0, 4, 1, 1};
+static const AmsAddr sim {simNetId, AMSPORT_R0_PLC_TC3};
+
+static size_t g_NumNotifications = 0;
+static void NotifyCallback(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    ++g_NumNotifications;
+}
+
+struct TestAdsUv : test_base<TestAdsUv> {
+    std::ostream& out;
+    uv_loop_t loop;
+    std::unique_ptr<AdsUvLoop> adapter;
+    long port;
+
+    TestAdsUv(std::ostream& outstream)
+        : out(outstream),
+        port(0)
+    {
+        uv_loop_init(&loop);
+        adapter.reset(new AdsUvLoop {&loop});
+    }
+
+    ~TestAdsUv()
+    {
+        adapter.reset();
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_loop_close(&loop);
+    }
+
+    /**
+     * Run the loop for <ms>, calling <f> from a timer callback first, like an
+     * application would issue requests
+     */
+    void RunInLoop(uint64_t ms, std::function<void()> f = std::function<void()>())
+    {
+        uv_timer_t start;
+        uv_timer_t stop;
+        start.data = &f;
+        uv_timer_init(&loop, &start);
+        uv_timer_init(&loop, &stop);
+        uv_timer_start(&start, [](uv_timer_t* timer) {
+            const auto& f = *static_cast<std::function<void()>*>(timer->data);
+            if (f) {
+                f();
+            }
+        }, 0, 0);
+        uv_timer_start(&stop, [](uv_timer_t* timer) {
+            uv_stop(timer->loop);
+        }, ms, 0);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_close(reinterpret_cast<uv_handle_t*>(&start), nullptr);
+        uv_close(reinterpret_cast<uv_handle_t*>(&stop), nullptr);
+        uv_run(&loop, UV_RUN_NOWAIT);
+    }
+
+    void testUvStart(const std::string&)
+    {
+        fructose_assert(0 == adapter->Start());
+        fructose_assert(0 == AdsAddRoute(simNetId, "127.0.0.4"));
+        port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+    }
+
+    void testUvRequest(const std::string&)
+    {
+        long status = -1;
+        uint16_t adsState = 0;
+        uint16_t devState;
+        RunInLoop(10, [&]() {
+            status = AdsSyncReadStateReqEx(port, &sim, &adsState, &devState);
+        });
+        fructose_assert(0 == status);
+        fructose_assert(ADSSTATE_RUN == adsState);
+    }
+
+    void testUvNotifications(const std::string& testname)
+    {
+        // 1ms cycle
+        const AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {10000} };
+        uint32_t hNotify;
+        long status = -1;
+        g_NumNotifications = 0;
+        RunInLoop(500, [&]() {
+            status = AdsSyncAddDeviceNotificationReqEx(port, &sim, 0x4020, 0, &attrib, &NotifyCallback, 0, &hNotify);
+        });
+        fructose_assert(0 == status);
+        out << testname << " received " << g_NumNotifications << " notifications in 500ms\n";
+        fructose_assert(10 < g_NumNotifications);
+
+        // the handles of a destroyed adapter are released by the loop
+        adapter.reset();
+        const auto numReceived = g_NumNotifications;
+        RunInLoop(100);
+        fructose_assert(numReceived == g_NumNotifications);
+
+        adapter.reset(new AdsUvLoop {&loop});
+        fructose_assert(0 == adapter->Start());
+        RunInLoop(10, [&]() {
+            status = AdsSyncDelDeviceNotificationReqEx(port, &sim, hNotify);
+        });
+        fructose_assert(0 == status);
+    }
+
+    void testUvStop(const std::string&)
+    {
+        fructose_assert(0 == AdsPortCloseEx(port));
+        AdsDelRoute(simNetId);
+        adapter->Stop();
+    }
+};
+
+int main()
+{
+    Simulator simulator {SimScript {}, IpV4 {"127.0.0.4"}};
+    TestAdsUv uvTest(std::cout);
+    uvTest.add_test("testUvStart", &TestAdsUv::testUvStart);
+    uvTest.add_test("testUvRequest", &TestAdsUv::testUvRequest);
+    uvTest.add_test("testUvNotifications", &TestAdsUv::testUvNotifications);
+    uvTest.add_test("testUvStop", &TestAdsUv::testUvStop);
+    return uvTest.run();
+}
@@ -0,0 +1,505 @@
+
+#include <AdsLib.h>
+#include "AdsSimulator/Simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/**
+ * Drives a configurable workload through the public C API to find out how many
+ * requests per second an ADS device serves:
+ *   make AdsLoadGen.bin
+ *   ./AdsLoadGen.bin --target 192.168.0.232 --threads 8 --mix read:80,write:20 --duration 30
+ *   ./AdsLoadGen.bin --simulate --threads 4 --size 64
+ */
+static const char* const USAGE =
+    "usage: AdsLoadGen.bin [options]\n"
+    "  --target <ip>[/<netId>]   ADS device, repeat for several targets, netId defaults to <ip>.1.1\n"
+    "  --simulate [<script>]     serve the targets by in-process simulators (default target 127.0.0.2)\n"
+    "  --ams-port <n>            AMS port of the targets (851)\n"
+    "  --threads <n>             number of request threads (1)\n"
+    "  --ports <n>               number of local ADS ports shared by the threads (one per thread)\n"
+    "  --rate <n>                requests per second and thread, 0 runs unthrottled (0)\n"
+    "  --mix <op:weight,...>     ops: read, write, readwrite, state (read:1)\n"
+    "  --size <bytes>            payload of read, write and readwrite (4)\n"
+    "  --group <n> --offset <n>  index group and offset to access (0x4020, 0)\n"
+    "  --notifications <n>       device notifications registered per thread (0)\n"
+    "  --cycle <ms>              cycle time of the notifications (10)\n"
+    "  --timeout <ms>            ADS timeout of the ports (5000)\n"
+    "  --duration <s>            length of the run (10)\n"
+    "  --interval <s>            reporting interval (1)\n";
+
+enum Operation { OP_READ, OP_WRITE, OP_READWRITE, OP_STATE, OP_COUNT };
+static const char* const OPERATION_NAMES[OP_COUNT] = { "read", "write", "readwrite", "state" };
+
+struct Target {
+    std::string ip;
+    AmsAddr addr;
+};
+
+struct Options {
+    std::vector<Target> targets;
+    bool simulate = false;
+    std::string script;
+    uint16_t amsPort = AMSPORT_R0_PLC_TC3;
+    size_t threads = 1;
+    size_t ports = 0;
+    double rate = 0;
+    std::vector<Operation> mix;
+    uint32_t size = 4;
+    uint32_t group = 0x4020;
+    uint32_t offset = 0;
+    size_t notifications = 0;
+    uint32_t cycleMs = 10;
+    uint32_t timeoutMs = 5000;
+    double duration = 10;
+    double interval = 1;
+};
+
+/**
+ * Latency histogram with 16 linear sub-buckets per power of two, which keeps
+ * the error of the reported percentiles below 7% at constant memory.
+ */
+struct LatencyHistogram {
+    static const size_t SUB_BUCKETS = 16;
+
+    LatencyHistogram()
+        : buckets(64 * SUB_BUCKETS),
+        count(0),
+        max(0)
+    {}
+
+    void Add(uint64_t ns)
+    {
+        ++buckets[Index(ns)];
+        ++count;
+        max = std::max(max, ns);
+    }
+
+    void Merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        max = std::max(max, other.max);
+    }
+
+    uint64_t Percentile(double p) const
+    {
+        const auto rank = static_cast<uint64_t>(std::ceil(p / 100 * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen && (seen >= rank)) {
+                return std::min(UpperBound(i), max);
+            }
+        }
+        return max;
+    }
+
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+    uint64_t max;
+
+private:
+    static size_t Index(uint64_t ns)
+    {
+        if (ns < SUB_BUCKETS) {
+            return ns;
+        }
+        size_t exponent = 0;
+        while ((ns >> exponent) >= 2 * SUB_BUCKETS) {
+            ++exponent;
+        }
+        return (exponent + 1) * SUB_BUCKETS + (ns >> exponent) - SUB_BUCKETS;
+    }
+
+    static uint64_t UpperBound(size_t index)
+    {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        const auto exponent = index / SUB_BUCKETS - 1;
+        return ((index % SUB_BUCKETS + SUB_BUCKETS + 1) << exponent) - 1;
+    }
+};
+
+/**
+ * Everything a worker measured since the last report
+ */
+struct Sample {
+    LatencyHistogram latency;
+    uint64_t numRequests = 0;
+    uint64_t numErrors = 0;
+    std::map<long, uint64_t> errors;
+
+    void Merge(const Sample& other)
+    {
+        latency.Merge(other.latency);
+        numRequests += other.numRequests;
+        numErrors += other.numErrors;
+        for (const auto& e : other.errors) {
+            errors[e.first] += e.second;
+        }
+    }
+};
+
+struct Worker {
+    std::mutex mutex;
+    Sample sample;
+
+    void Record(uint64_t ns, long status)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sample.latency.Add(ns);
+        ++sample.numRequests;
+        if (status) {
+            ++sample.numErrors;
+            ++sample.errors[status];
+        }
+    }
+
+    Sample Take()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Sample taken;
+        std::swap(taken, sample);
+        return taken;
+    }
+};
+
+static std::atomic<uint64_t> g_NumNotifications {0};
+static void OnNotification(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    ++g_NumNotifications;
+}
+
+static uint32_t ParseNumber(const std::string& value)
+{
+    return static_cast<uint32_t>(std::stoul(value, nullptr, 0));
+}
+
+static Target ParseTarget(const std::string& value, uint16_t amsPort)
+{
+    const auto slash = value.find('/');
+    Target target;
+    target.ip = value.substr(0, slash);
+    const auto netId = (slash == std::string::npos) ? target.ip + ".1.1" : value.substr(slash + 1);
+    std::istringstream in(netId);
+    for (auto& b : target.addr.netId.b) {
+        unsigned int byte;
+        char dot;
+        if (!(in >> byte) || (byte > 255) || ((&b != &target.addr.netId.b[5]) && !(in >> dot))) {
+            throw std::invalid_argument("invalid AmsNetId '" + netId + "'");
+        }
+        b = static_cast<uint8_t>(byte);
+    }
+    target.addr.port = amsPort;
+    return target;
+}
+
+static std::vector<Operation> ParseMix(const std::string& value)
+{
+    std::vector<Operation> mix;
+    std::istringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        const auto colon = item.find(':');
+        const auto name = item.substr(0, colon);
+        const auto weight = (colon == std::string::npos) ? 1 : ParseNumber(item.substr(colon + 1));
+        const auto op = std::find(std::begin(OPERATION_NAMES), std::end(OPERATION_NAMES), name);
+        if (op == std::end(OPERATION_NAMES)) {
+            throw std::invalid_argument("unknown operation '" + name + "'");
+        }
+        mix.insert(mix.end(), weight, static_cast<Operation>(op - std::begin(OPERATION_NAMES)));
+    }
+    if (mix.empty()) {
+        throw std::invalid_argument("empty mix");
+    }
+    return mix;
+}
+
+static Options ParseOptions(int argc, char* argv[])
+{
+    Options options;
+    std::vector<std::string> targets;
+    for (int i = 1; i < argc; ++i) {
+        const std::string key = argv[i];
+        const bool hasValue = (i + 1 < argc) && strncmp(argv[i + 1], "--", 2);
+        if (key == "--simulate") {
+            options.simulate = true;
+            if (hasValue) {
+                options.script = argv[++i];
+            }
+            continue;
+        }
+        if (!hasValue) {
+            throw std::invalid_argument("missing value of '" + key + "'");
+        }
+
+        const std::string value = argv[++i];
+        if (key == "--target") {
+            targets.push_back(value);
+        } else if (key == "--ams-port") {
+            options.amsPort = static_cast<uint16_t>(ParseNumber(value));
+        } else if (key == "--threads") {
+            options.threads = std::max<size_t>(1, ParseNumber(value));
+        } else if (key == "--ports") {
+            options.ports = ParseNumber(value);
+        } else if (key == "--rate") {
+            options.rate = std::stod(value);
+        } else if (key == "--mix") {
+            options.mix = ParseMix(value);
+        } else if (key == "--size") {
+            options.size = ParseNumber(value);
+        } else if (key == "--group") {
+            options.group = ParseNumber(value);
+        } else if (key == "--offset") {
+            options.offset = ParseNumber(value);
+        } else if (key == "--notifications") {
+            options.notifications = ParseNumber(value);
+        } else if (key == "--cycle") {
+            options.cycleMs = ParseNumber(value);
+        } else if (key == "--timeout") {
+            options.timeoutMs = ParseNumber(value);
+        } else if (key == "--duration") {
+            options.duration = std::stod(value);
+        } else if (key == "--interval") {
+            options.interval = std::max(0.1, std::stod(value));
+        } else {
+            throw std::invalid_argument("unknown option '" + key + "'");
+        }
+    }
+
+    if (targets.empty()) {
+        if (!options.simulate) {
+            throw std::invalid_argument("no --target given");
+        }
+        targets.push_back("127.0.0.2");
+    }
+    for (const auto& t : targets) {
+        options.targets.push_back(ParseTarget(t, options.amsPort));
+    }
+    if (options.mix.empty()) {
+        options.mix.push_back(OP_READ);
+    }
+    if (!options.ports || (options.ports > options.threads)) {
+        options.ports = options.threads;
+    }
+    return options;
+}
+
+static std::string Duration(uint64_t ns)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(ns < 10000 ? 1 : 0);
+    if (ns < 1000000) {
+        out << ns / 1000.0 << "us";
+    } else {
+        out << std::setprecision(1) << ns / 1000000.0 << "ms";
+    }
+    return out.str();
+}
+
+static void Print(std::ostream& out, const char* label, const Sample& sample, double seconds,
+                  uint64_t numNotifications)
+{
+    out << std::setw(8) << std::left << label << std::right << std::fixed << std::setprecision(0) <<
+        std::setw(9) << sample.numRequests / seconds << " req/s" <<
+        "  p50 " << std::setw(7) << Duration(sample.latency.Percentile(50)) <<
+        "  p90 " << std::setw(7) << Duration(sample.latency.Percentile(90)) <<
+        "  p99 " << std::setw(7) << Duration(sample.latency.Percentile(99)) <<
+        "  max " << std::setw(7) << Duration(sample.latency.max) <<
+        "  errors " << sample.numErrors <<
+        "  notifications " << std::setprecision(0) << numNotifications / seconds << "/s\n";
+}
+
+static void Run(const Options& options, long port, Worker& worker, size_t id, const std::atomic<bool>& running)
+{
+    std::vector<uint8_t> readBuffer(options.size);
+    std::vector<uint8_t> writeBuffer(options.size, static_cast<uint8_t>(id));
+    std::vector<std::pair<const AmsAddr*, uint32_t> > notifications;
+    const AdsNotificationAttrib attrib = {
+        options.size, ADSTRANS_SERVERCYCLE, 0, {options.cycleMs * 10000}
+    };
+    for (size_t i = 0; i < options.notifications; ++i) {
+        const auto& addr = options.targets[(id + i) % options.targets.size()].addr;
+        uint32_t hNotify;
+        const auto status = AdsSyncAddDeviceNotificationReqEx(port, &addr, options.group, options.offset, &attrib,
+                                                              &OnNotification, 0, &hNotify);
+        if (status) {
+            std::cerr << "Adding notification failed with: 0x" << std::hex << status << std::dec << '\n';
+        } else {
+            notifications.push_back(std::make_pair(&addr, hNotify));
+        }
+    }
+
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.rate ? 1 / options.rate : 0));
+    auto next = std::chrono::steady_clock::now();
+    for (size_t i = id; running; ++i) {
+        if (options.rate) {
+            std::this_thread::sleep_until(next);
+            next += period;
+        }
+
+        const auto& addr = options.targets[i % options.targets.size()].addr;
+        const auto op = options.mix[(i / options.targets.size()) % options.mix.size()];
+        uint32_t bytesRead;
+        uint16_t adsState;
+        uint16_t devState;
+        long status = 0;
+        const auto start = std::chrono::steady_clock::now();
+        switch (op) {
+        case OP_READ:
+            status = AdsSyncReadReqEx2(port, &addr, options.group, options.offset, options.size,
+                                       readBuffer.data(), &bytesRead);
+            break;
+
+        case OP_WRITE:
+            status = AdsSyncWriteReqEx(port, &addr, options.group, options.offset, options.size,
+                                       writeBuffer.data());
+            break;
+
+        case OP_READWRITE:
+            status = AdsSyncReadWriteReqEx2(port, &addr, options.group, options.offset, options.size,
+                                            readBuffer.data(), options.size, writeBuffer.data(), &bytesRead);
+            break;
+
+        default:
+            status = AdsSyncReadStateReqEx(port, &addr, &adsState, &devState);
+            break;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        worker.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), status);
+    }
+
+    for (const auto& n : notifications) {
+        AdsSyncDelDeviceNotificationReqEx(port, n.first, n.second);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n' << USAGE;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Simulator> > simulators;
+    try {
+        if (options.simulate) {
+            SimScript script;
+            if (!options.script.empty()) {
+                std::ifstream file(options.script);
+                if (!file) {
+                    std::cerr << "Open script '" << options.script << "' failed\n";
+                    return 1;
+                }
+                script = SimScript::Parse(file);
+            }
+            for (const auto& t : options.targets) {
+                simulators.emplace_back(new Simulator {script, IpV4 {t.ip}});
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Start simulator failed: " << e.what() << '\n';
+        return 1;
+    }
+
+    for (const auto& t : options.targets) {
+        const auto status = AdsAddRoute(t.addr.netId, t.ip.c_str());
+        if (status) {
+            std::cerr << "Adding route to " << t.ip << " failed with: 0x" << std::hex << status << '\n';
+            return 1;
+        }
+    }
+
+    std::vector<long> ports;
+    for (size_t i = 0; i < options.ports; ++i) {
+        const long port = AdsPortOpenEx();
+        if (!port) {
+            std::cerr << "Open ADS port failed\n";
+            return 1;
+        }
+        AdsSyncSetTimeoutEx(port, options.timeoutMs);
+        ports.push_back(port);
+    }
+
+    std::cout << "targets " << options.targets.size() << ", threads " << options.threads << ", ports " <<
+        options.ports << ", size " << options.size << " bytes, rate " <<
+    (options.rate ? std::to_string(options.rate * options.threads) + " req/s" : std::string("unthrottled")) <<
+        (options.simulate ? ", simulated" : "") << '\n';
+
+    std::atomic<bool> running {true};
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < options.threads; ++i) {
+        workers.emplace_back(new Worker);
+        threads.emplace_back(&Run, std::cref(options), ports[i % ports.size()], std::ref(*workers.back()), i,
+                             std::cref(running));
+    }
+
+    Sample total;
+    const auto begin = std::chrono::steady_clock::now();
+    const auto end = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.duration));
+    auto last = begin;
+    uint64_t lastNotifications = 0;
+    while (last < end) {
+        const auto wakeup = std::min(end, last + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                         std::chrono::duration<double>(options.interval)));
+        std::this_thread::sleep_until(wakeup);
+        const auto now = std::chrono::steady_clock::now();
+        Sample interval;
+        for (auto& w : workers) {
+            interval.Merge(w->Take());
+        }
+        const uint64_t numNotifications = g_NumNotifications;
+        std::ostringstream label;
+        label << std::fixed << std::setprecision(1) << std::chrono::duration<double>(now - begin).count() << 's';
+        Print(std::cout, label.str().c_str(), interval, std::chrono::duration<double>(now - last).count(),
+              numNotifications - lastNotifications);
+        total.Merge(interval);
+        last = now;
+        lastNotifications = numNotifications;
+    }
+
+    running = false;
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto& w : workers) {
+        total.Merge(w->Take());
+    }
+
+    std::cout << '\n';
+    Print(std::cout, "total", total, std::chrono::duration<double>(last - begin).count(), lastNotifications);
+    for (const auto& e : total.errors) {
+        std::cout << "  error 0x" << std::hex << e.first << ": " << std::dec << e.second << '\n';
+    }
+
+    for (const auto& p : ports) {
+        AdsPortCloseEx(p);
+    }
+    for (const auto& t : options.targets) {
+        AdsDelRoute(t.addr.netId);
+    }
+    return total.numErrors ? 2 : 0;
+}
@@ -0,0 +1,1111 @@
+#include "Simulator.h"
+#include "AmsHeader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+static const char* const COMMAND_NAMES[] = {
+    "*", "device_info", "read", "write", "read_state", "write_control", "add_notification", "del_notification",
+    "device_notification", "read_write",
+};
+
+template<class T>
+static T Next(std::istream& words, const char* what)
+{
+    T value;
+    if (!(words >> value)) {
+        throw std::invalid_argument(std::string("missing ") + what);
+    }
+    return value;
+}
+
+static uint32_t NextCode(std::istream& words)
+{
+    uint32_t value;
+    if (!(words >> std::setbase(0) >> value)) {
+        throw std::invalid_argument("missing error code");
+    }
+    return value;
+}
+
+static double NextProbability(std::istream& words)
+{
+    const auto p = Next<double>(words, "probability");
+    if ((p < 0) || (p > 1)) {
+        throw std::invalid_argument("probability out of range");
+    }
+    return p;
+}
+
+static std::vector<SimFaults*> NextCommands(SimScript& script, std::istream& words)
+{
+    const auto name = Next<std::string>(words, "command");
+    const auto cmd = std::find(std::begin(COMMAND_NAMES), std::end(COMMAND_NAMES), name) - std::begin(COMMAND_NAMES);
+    if (cmd >= static_cast<ptrdiff_t>(script.commands.size())) {
+        throw std::invalid_argument("unknown command '" + name + "'");
+    }
+
+    std::vector<SimFaults*> commands;
+    for (size_t i = cmd ? cmd : 1; i <= (cmd ? cmd : script.commands.size() - 1); ++i) {
+        commands.push_back(&script.commands[i]);
+    }
+    return commands;
+}
+
+static SimLatency NextLatency(std::istream& words)
+{
+    const auto distribution = Next<std::string>(words, "distribution");
+    if (distribution == "fixed") {
+        return SimLatency {SimLatency::FIXED, Next<uint32_t>(words, "latency"), 0};
+    }
+    if (distribution == "uniform") {
+        const auto a = Next<uint32_t>(words, "lower bound");
+        const auto b = Next<uint32_t>(words, "upper bound");
+        return SimLatency {SimLatency::UNIFORM, std::min(a, b), std::max(a, b)};
+    }
+    if (distribution == "exponential") {
+        return SimLatency {SimLatency::EXPONENTIAL, Next<uint32_t>(words, "mean"), 0};
+    }
+    throw std::invalid_argument("unknown distribution '" + distribution + "'");
+}
+
+static SimEvent NextEvent(std::istream& words)
+{
+    const auto fault = Next<std::string>(words, "fault");
+    if (fault == "drop") {
+        return SimEvent {SIM_DROP, 0};
+    }
+    if (fault == "reset") {
+        return SimEvent {SIM_RESET, 0};
+    }
+    if (fault == "oversize") {
+        return SimEvent {SIM_OVERSIZE, 0};
+    }
+    if (fault == "delay") {
+        return SimEvent {SIM_DELAY, Next<uint32_t>(words, "delay")};
+    }
+    if (fault == "error") {
+        return SimEvent {SIM_ERROR, NextCode(words)};
+    }
+    if (fault == "burst") {
+        return SimEvent {SIM_BURST, Next<uint32_t>(words, "notifications")};
+    }
+    throw std::invalid_argument("unknown fault '" + fault + "'");
+}
+
+static void ParseLine(SimScript& script, const std::string& keyword, std::istream& words)
+{
+    if (keyword == "seed") {
+        script.seed = Next<uint32_t>(words, "seed");
+    } else if (keyword == "memory") {
+        script.memorySize = Next<size_t>(words, "size");
+    } else if (keyword == "latency") {
+        const auto commands = NextCommands(script, words);
+        const auto latency = NextLatency(words);
+        for (auto& c : commands) {
+            c->latency = latency;
+        }
+    } else if (keyword == "drop") {
+        const auto commands = NextCommands(script, words);
+        const auto p = NextProbability(words);
+        for (auto& c : commands) {
+            c->drop = p;
+        }
+    } else if (keyword == "delay") {
+        const auto commands = NextCommands(script, words);
+        const auto p = NextProbability(words);
+        const auto us = Next<uint32_t>(words, "delay");
+        for (auto& c : commands) {
+            c->delay = p;
+            c->delayUs = us;
+        }
+    } else if (keyword == "error") {
+        const auto commands = NextCommands(script, words);
+        const auto p = NextProbability(words);
+        const auto code = NextCode(words);
+        for (auto& c : commands) {
+            c->error = p;
+            c->errorCode = code;
+        }
+    } else if (keyword == "reset") {
+        const auto commands = NextCommands(script, words);
+        const auto p = NextProbability(words);
+        for (auto& c : commands) {
+            c->reset = p;
+        }
+    } else if (keyword == "oversize") {
+        const auto commands = NextCommands(script, words);
+        const auto p = NextProbability(words);
+        for (auto& c : commands) {
+            c->oversize = p;
+        }
+        uint32_t bytes;
+        if (words >> bytes) {
+            script.oversizeBytes = bytes;
+        }
+        words.clear();
+    } else if (keyword == "burst") {
+        script.burstCount = Next<uint32_t>(words, "notifications");
+        script.burstPeriodMs = Next<uint32_t>(words, "period");
+    } else if (keyword == "accept_delay") {
+        script.acceptDelayMs = Next<uint32_t>(words, "delay");
+    } else if (keyword == "at") {
+        const auto request = Next<uint64_t>(words, "request");
+        script.events.emplace(request, NextEvent(words));
+    } else {
+        throw std::invalid_argument("unknown keyword '" + keyword + "'");
+    }
+
+    std::string trailing;
+    if (words >> trailing) {
+        throw std::invalid_argument("unexpected '" + trailing + "'");
+    }
+}
+
+SimScript::SimScript()
+    : seed(0),
+    memorySize(64 * 1024),
+    oversizeBytes(64 * 1024),
+    burstCount(0),
+    burstPeriodMs(0),
+    acceptDelayMs(0),
+    commands(),
+    events()
+{}
+
+SimScript SimScript::Parse(std::istream& input)
+{
+    SimScript script;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(input, line); ++lineNumber) {
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string keyword;
+        if (!(words >> keyword)) {
+            continue;
+        }
+
+        try {
+            ParseLine(script, keyword, words);
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument("line " + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+    return script;
+}
+
+SimScript SimScript::Parse(const std::string& script)
+{
+    std::istringstream input(script);
+    return Parse(input);
+}
+
+template<class T>
+static void Put(std::vector<uint8_t>& out, const T value)
+{
+    const auto le = qToLittleEndian<T>(value);
+    const auto bytes = reinterpret_cast<const uint8_t*>(&le);
+    out.insert(out.end(), bytes, bytes + sizeof(le));
+}
+
+static void Put(std::vector<uint8_t>& out, const AmsAddr& addr)
+{
+    out.insert(out.end(), addr.netId.b, addr.netId.b + sizeof(addr.netId.b));
+    Put<uint16_t>(out, addr.port);
+}
+
+template<class T>
+static T Get(const uint8_t*& data)
+{
+    const auto value = qFromLittleEndian<T>(data);
+    data += sizeof(T);
+    return value;
+}
+
+static std::vector<uint8_t> Result(uint32_t result)
+{
+    std::vector<uint8_t> payload;
+    Put<uint32_t>(payload, result);
+    return payload;
+}
+
+static std::vector<uint8_t> MakeFrame(const AmsAddr& target, const AmsAddr& source, uint16_t cmdId,
+                                      uint16_t stateFlags, uint32_t invokeId, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> frame;
+    frame.reserve(sizeof(AmsTcpHeader) + sizeof(AoEHeader) + payload.size());
+    Put<uint16_t>(frame, 0);
+    Put<uint32_t>(frame, static_cast<uint32_t>(sizeof(AoEHeader) + payload.size()));
+    Put(frame, target);
+    Put(frame, source);
+    Put<uint16_t>(frame, cmdId);
+    Put<uint16_t>(frame, stateFlags);
+    Put<uint32_t>(frame, static_cast<uint32_t>(payload.size()));
+    Put<uint32_t>(frame, 0);
+    Put<uint32_t>(frame, invokeId);
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+/**
+ * 100ns intervals since 1601-01-01 like the timestamps of a TwinCAT system
+ */
+static uint64_t FileTime()
+{
+    const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return 116444736000000000ULL + std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count() / 100;
+}
+
+struct Simulator::Response {
+    std::vector<uint8_t> frame;
+    bool reset;
+};
+
+struct Simulator::Session {
+    struct Notification {
+        AmsAddr client;
+        AmsAddr server;
+        uint32_t group;
+        uint32_t offset;
+        uint32_t length;
+        bool onChange;
+        Clock::duration cycle;
+        Clock::time_point next;
+        std::vector<uint8_t> last;
+    };
+
+    Session(Simulator& simulator, SOCKET socket, uint32_t seed)
+        : sim(simulator),
+        sock(socket),
+        rng(seed),
+        open(true),
+        closed(false),
+        finished(false),
+        nextHandle(1),
+        pendingBurst(0),
+        nextBurst(Clock::now())
+    {
+        writer = std::thread(&Session::Write, this);
+        reader = std::thread(&Session::Read, this);
+    }
+
+    ~Session()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (open) {
+                shutdown(sock, SHUT_RDWR);
+            }
+        }
+        reader.join();
+    }
+
+    bool Roll(double probability)
+    {
+        return (probability > 0) && std::bernoulli_distribution {probability}(rng);
+    }
+
+    uint32_t Latency(const SimLatency& latency)
+    {
+        switch (latency.distribution) {
+        case SimLatency::UNIFORM:
+            return std::uniform_int_distribution<uint32_t> {latency.a, latency.b}(rng);
+
+        case SimLatency::EXPONENTIAL:
+            return latency.a ? static_cast<uint32_t>(std::exponential_distribution<double> {1.0 / latency.a}(rng)) : 0;
+
+        default:
+            return latency.a;
+        }
+    }
+
+    void Enqueue(Clock::time_point due, Response response)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace(due, std::move(response));
+        }
+        cv.notify_all();
+    }
+
+    uint32_t AddNotification(const Notification& notification)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto hNotify = nextHandle++;
+        notifications.emplace(hNotify, notification);
+        cv.notify_all();
+        return hNotify;
+    }
+
+    bool DelNotification(uint32_t hNotify)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return notifications.erase(hNotify);
+    }
+
+    void Burst(uint32_t count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingBurst += count;
+        }
+        cv.notify_all();
+    }
+
+    bool Receive(uint8_t* buffer, size_t bytesToRead)
+    {
+        while (bytesToRead) {
+            const int bytesRead = recv(sock, reinterpret_cast<char*>(buffer), static_cast<int>(bytesToRead), 0);
+            if (bytesRead <= 0) {
+                return false;
+            }
+            buffer += bytesRead;
+            bytesToRead -= bytesRead;
+        }
+        return true;
+    }
+
+    bool Send(const uint8_t* buffer, size_t bytesToWrite)
+    {
+        while (bytesToWrite) {
+            const int bytesWritten =
+                send(sock, reinterpret_cast<const char*>(buffer), static_cast<int>(bytesToWrite), MSG_NOSIGNAL);
+            if (bytesWritten <= 0) {
+                return false;
+            }
+            buffer += bytesWritten;
+            bytesToWrite -= bytesWritten;
+        }
+        return true;
+    }
+
+    void Read()
+    {
+        std::vector<uint8_t> frame;
+        uint8_t tcpHeader[sizeof(AmsTcpHeader)];
+        while (Receive(tcpHeader, sizeof(tcpHeader))) {
+            const auto length = AmsTcpHeader {tcpHeader}.length();
+            if ((length < sizeof(AoEHeader)) || (length > MAX_FRAME_SIZE)) {
+                break;
+            }
+            frame.resize(length);
+            if (!Receive(frame.data(), length)) {
+                break;
+            }
+            sim.Handle(*this, frame);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        cv.notify_all();
+        writer.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open = false;
+            closesocket(sock);
+        }
+        finished = true;
+    }
+
+    /**
+     * Cut the connection in the middle of <frame>, the abortive close makes the peer see a reset
+     */
+    void Reset(const std::vector<uint8_t>& frame)
+    {
+        Send(frame.data(), frame.size() / 2);
+        const linger abortive {1, 0};
+        setsockopt(sock, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char*>(&abortive), sizeof(abortive));
+        shutdown(sock, SHUT_RD);
+        ++sim.numResets;
+    }
+
+    struct Due {
+        uint32_t hNotify;
+        Notification notification;
+        bool cyclic;
+    };
+
+    bool SendNotifications(const std::vector<Due>& due, uint32_t burst)
+    {
+        for (const auto& n : due) {
+            std::vector<uint8_t> data;
+            if (sim.ReadImage(n.notification.group, n.notification.offset, n.notification.length, data)) {
+                data.assign(n.notification.length, 0);
+            }
+            const bool changed = !n.notification.onChange || (data != n.notification.last);
+            const uint32_t count = burst + (n.cyclic && changed);
+            if (!count) {
+                continue;
+            }
+
+            std::vector<uint8_t> payload;
+            const auto timestamp = FileTime();
+            Put<uint32_t>(payload, static_cast<uint32_t>(5 * sizeof(uint32_t) + sizeof(timestamp) + data.size()));
+            Put<uint32_t>(payload, 1);
+            Put<uint32_t>(payload, static_cast<uint32_t>(timestamp));
+            Put<uint32_t>(payload, static_cast<uint32_t>(timestamp >> 32));
+            Put<uint32_t>(payload, 1);
+            Put<uint32_t>(payload, n.hNotify);
+            Put<uint32_t>(payload, static_cast<uint32_t>(data.size()));
+            payload.insert(payload.end(), data.begin(), data.end());
+            const auto frame = MakeFrame(n.notification.client, n.notification.server,
+                                         AoEHeader::DEVICE_NOTIFICATION, AoEHeader::AMS_REQUEST, 0, payload);
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!Send(frame.data(), frame.size())) {
+                    return false;
+                }
+                ++sim.numNotifications;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = notifications.find(n.hNotify);
+            if (it != notifications.end()) {
+                it->second.last = std::move(data);
+            }
+        }
+        return true;
+    }
+
+    void Write()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!closed) {
+            const auto now = Clock::now();
+            if (!queue.empty() && (queue.begin()->first <= now)) {
+                const auto response = std::move(queue.begin()->second);
+                queue.erase(queue.begin());
+                lock.unlock();
+                if (response.reset) {
+                    Reset(response.frame);
+                    lock.lock();
+                    break;
+                }
+                const bool sent = Send(response.frame.data(), response.frame.size());
+                sim.numResponses += sent;
+                lock.lock();
+                if (!sent) {
+                    break;
+                }
+                continue;
+            }
+
+            if (sim.script.burstPeriodMs && (nextBurst <= now)) {
+                pendingBurst += sim.script.burstCount;
+                nextBurst = now + std::chrono::milliseconds(sim.script.burstPeriodMs);
+            }
+
+            auto wakeup = now + std::chrono::seconds(1);
+            std::vector<Due> due;
+            for (auto& n : notifications) {
+                const bool cyclic = (n.second.next <= now);
+                if (pendingBurst || cyclic) {
+                    due.push_back(Due {n.first, n.second, cyclic});
+                }
+                if (cyclic) {
+                    n.second.next = now + n.second.cycle;
+                }
+                wakeup = std::min(wakeup, n.second.next);
+            }
+            if (!queue.empty()) {
+                wakeup = std::min(wakeup, queue.begin()->first);
+            }
+            if (sim.script.burstPeriodMs) {
+                wakeup = std::min(wakeup, nextBurst);
+            }
+
+            if (!due.empty()) {
+                const auto burst = pendingBurst;
+                pendingBurst = 0;
+                lock.unlock();
+                const bool sent = SendNotifications(due, burst);
+                lock.lock();
+                if (!sent) {
+                    break;
+                }
+                continue;
+            }
+            pendingBurst = 0;
+            cv.wait_until(lock, wakeup);
+        }
+    }
+
+    Simulator& sim;
+    const SOCKET sock;
+    std::mt19937 rng;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool open;
+    bool closed;
+    std::atomic<bool> finished;
+    std::multimap<Clock::time_point, Response> queue;
+    std::map<uint32_t, Notification> notifications;
+    uint32_t nextHandle;
+    uint32_t pendingBurst;
+    Clock::time_point nextBurst;
+    std::thread writer;
+    std::thread reader;
+};
+
+static sockaddr_in SockAddr(IpV4 ip, uint16_t port)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(ip.value);
+    return addr;
+}
+
+static SOCKET Listen(IpV4 ip, uint16_t port, int backlog)
+{
+    const SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (INVALID_SOCKET == sock) {
+        throw std::system_error(WSAGetLastError(), std::system_category());
+    }
+
+    const int enable = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+    const auto addr = SockAddr(ip, port);
+    if (bind(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) || listen(sock, backlog)) {
+        const auto lastError = WSAGetLastError();
+        closesocket(sock);
+        throw std::system_error(lastError, std::system_category());
+    }
+    return sock;
+}
+
+/**
+ * Connect to our own listener, which has a backlog of one connection, so the
+ * kernel drops the SYNs of clients until the connection is accepted
+ */
+static SOCKET Fill(IpV4 ip, uint16_t port)
+{
+    const SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    const auto addr = SockAddr(ip, port);
+    if ((INVALID_SOCKET == sock) || connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))) {
+        const auto lastError = WSAGetLastError();
+        closesocket(sock);
+        throw std::system_error(lastError, std::system_category());
+    }
+    return sock;
+}
+
+Simulator::Simulator(const SimScript& __script, IpV4 ip, uint16_t port)
+    : script(__script),
+    wsaInitialized(!InitSocketLibrary()),
+    listener(Listen(ip, port, script.acceptDelayMs ? 0 : SOMAXCONN)),
+    filler(script.acceptDelayMs ? Fill(ip, port) : INVALID_SOCKET),
+    running(true),
+    memory(script.memorySize),
+    adsState(ADSSTATE_RUN),
+    devState(0),
+    nextFileHandle(1),
+    numConnections(0),
+    numRequests(0),
+    numResponses(0),
+    numDropped(0),
+    numDelayed(0),
+    numErrors(0),
+    numResets(0),
+    numOversized(0),
+    numNotifications(0)
+{
+    acceptor = std::thread(&Simulator::Accept, this);
+}
+
+Simulator::~Simulator()
+{
+    running = false;
+    shutdown(listener, SHUT_RDWR);
+    closesocket(listener);
+    acceptor.join();
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions.clear();
+    }
+    if (wsaInitialized) {
+        WSACleanup();
+    }
+}
+
+SimStats Simulator::GetStats() const
+{
+    return SimStats {
+               numConnections, numRequests, numResponses, numDropped, numDelayed, numErrors, numResets,
+               numOversized, numNotifications
+    };
+}
+
+void Simulator::Accept()
+{
+    if (INVALID_SOCKET != filler) {
+        const auto until = Clock::now() + std::chrono::milliseconds(script.acceptDelayMs);
+        while (running && (Clock::now() < until)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        const SOCKET sock = running ? accept(listener, nullptr, nullptr) : INVALID_SOCKET;
+        if (INVALID_SOCKET != sock) {
+            closesocket(sock);
+        }
+        closesocket(filler);
+    }
+
+    while (running) {
+        const SOCKET sock = accept(listener, nullptr, nullptr);
+        if (INVALID_SOCKET == sock) {
+            continue;
+        }
+        // like the client, don't let Nagle hold responses back behind notifications
+        const int enable = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+        const auto seed = static_cast<uint32_t>(script.seed + numConnections++);
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions.remove_if([](const std::unique_ptr<Session>& s) {
+            return s->finished.load();
+        });
+        sessions.emplace_back(new Session(*this, sock, seed));
+    }
+}
+
+void Simulator::Handle(Session& session, const std::vector<uint8_t>& frame)
+{
+    const AoEHeader request {frame.data()};
+    const auto cmdId = request.cmdId();
+    const auto number = ++numRequests;
+    const auto& faults = script.commands[(cmdId < script.commands.size()) ? cmdId : 0];
+
+    bool drop = session.Roll(faults.drop);
+    bool reset = session.Roll(faults.reset);
+    bool oversize = session.Roll(faults.oversize);
+    uint32_t delayUs = session.Roll(faults.delay) ? faults.delayUs : 0;
+    uint32_t error = session.Roll(faults.error) ? faults.errorCode : 0;
+    const auto latencyUs = session.Latency(faults.latency);
+
+    const auto events = script.events.equal_range(number);
+    for (auto it = events.first; it != events.second; ++it) {
+        switch (it->second.fault) {
+        case SIM_DROP:
+            drop = true;
+            break;
+
+        case SIM_DELAY:
+            delayUs = it->second.value;
+            break;
+
+        case SIM_ERROR:
+            error = it->second.value;
+            break;
+
+        case SIM_RESET:
+            reset = true;
+            break;
+
+        case SIM_OVERSIZE:
+            oversize = true;
+            break;
+
+        case SIM_BURST:
+            session.Burst(it->second.value);
+            break;
+        }
+    }
+
+    const AmsAddr client = request.sourceAms();
+    const AmsAddr server {request.targetAddr(), request.targetPort()};
+    const size_t length = std::min<size_t>(request.length(), frame.size() - sizeof(AoEHeader));
+    const auto due = Clock::now() + std::chrono::microseconds(latencyUs + delayUs);
+    auto payload = Execute(session, cmdId, client, server, frame.data() + sizeof(AoEHeader), length, due);
+    if (error) {
+        payload = Result(error);
+        ++numErrors;
+    }
+
+    if (drop) {
+        ++numDropped;
+        return;
+    }
+
+    if (oversize) {
+        payload.resize(payload.size() + script.oversizeBytes);
+        ++numOversized;
+    }
+    numDelayed += !!delayUs;
+    const auto response = MakeFrame(client, server, cmdId, AoEHeader::AMS_RESPONSE, request.invokeId(), payload);
+    session.Enqueue(due, Response {response, reset});
+}
+
+std::vector<uint8_t> Simulator::Execute(Session& session, uint16_t cmdId, const AmsAddr& client,
+                                        const AmsAddr& server, const uint8_t* data, size_t length,
+                                        Clock::time_point due)
+{
+    std::vector<uint8_t> payload;
+    switch (cmdId) {
+    case AoEHeader::READ_DEVICE_INFO:
+    {
+        static const char name[16] = "AdsSimulator";
+        Put<uint32_t>(payload, ADSERR_NOERR);
+        payload.push_back(3);
+        payload.push_back(1);
+        Put<uint16_t>(payload, 4024);
+        payload.insert(payload.end(), name, name + sizeof(name));
+        return payload;
+    }
+
+    case AoEHeader::READ:
+    {
+        if (length < 3 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        const auto group = Get<uint32_t>(data);
+        const auto offset = Get<uint32_t>(data);
+        const auto readLength = Get<uint32_t>(data);
+        std::vector<uint8_t> value;
+        const auto result = ReadImage(group, offset, readLength, value);
+        if (result) {
+            return Result(result);
+        }
+        Put<uint32_t>(payload, ADSERR_NOERR);
+        Put<uint32_t>(payload, static_cast<uint32_t>(value.size()));
+        payload.insert(payload.end(), value.begin(), value.end());
+        return payload;
+    }
+
+    case AoEHeader::WRITE:
+    {
+        if (length < 3 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        const auto group = Get<uint32_t>(data);
+        const auto offset = Get<uint32_t>(data);
+        const auto writeLength = Get<uint32_t>(data);
+        if (writeLength > length - 3 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        return Result(WriteImage(group, offset, data, writeLength));
+    }
+
+    case AoEHeader::READ_STATE:
+    {
+        std::lock_guard<std::mutex> lock(imageMutex);
+        Put<uint32_t>(payload, ADSERR_NOERR);
+        Put<uint16_t>(payload, adsState);
+        Put<uint16_t>(payload, devState);
+        return payload;
+    }
+
+    case AoEHeader::WRITE_CONTROL:
+    {
+        if (length < 2 * sizeof(uint16_t) + sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        std::lock_guard<std::mutex> lock(imageMutex);
+        adsState = Get<uint16_t>(data);
+        devState = Get<uint16_t>(data);
+        return Result(ADSERR_NOERR);
+    }
+
+    case AoEHeader::ADD_DEVICE_NOTIFICATION:
+    {
+        if (length < 6 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        Session::Notification notification;
+        notification.client = client;
+        notification.server = server;
+        notification.group = Get<uint32_t>(data);
+        notification.offset = Get<uint32_t>(data);
+        notification.length = Get<uint32_t>(data);
+        notification.onChange = (ADSTRANS_SERVERONCHA == Get<uint32_t>(data));
+        Get<uint32_t>(data);
+        const auto cycleTime = Get<uint32_t>(data);
+        notification.cycle = std::max<Clock::duration>(std::chrono::milliseconds(1),
+                                                       std::chrono::microseconds(cycleTime / 10));
+        // like a PLC task, sample the first time one cycle after the response
+        notification.next = due + std::chrono::milliseconds(1);
+        Put<uint32_t>(payload, ADSERR_NOERR);
+        Put<uint32_t>(payload, session.AddNotification(notification));
+        return payload;
+    }
+
+    case AoEHeader::DEL_DEVICE_NOTIFICATION:
+        if (length < sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        return Result(session.DelNotification(Get<uint32_t>(data)) ? ADSERR_NOERR : ADSERR_DEVICE_NOTIFYHNDINVALID);
+
+    case AoEHeader::READ_WRITE:
+    {
+        if (length < 4 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+        const auto group = Get<uint32_t>(data);
+        const auto offset = Get<uint32_t>(data);
+        const auto readLength = Get<uint32_t>(data);
+        const auto writeLength = Get<uint32_t>(data);
+        if (writeLength > length - 4 * sizeof(uint32_t)) {
+            return Result(ADSERR_DEVICE_INVALIDSIZE);
+        }
+
+        std::vector<uint8_t> value;
+        if (ADSIGRP_SYM_HNDBYNAME == group) {
+            const std::string name(reinterpret_cast<const char*>(data), strnlen(reinterpret_cast<const char*>(
+                                                                                    data), writeLength));
+            std::lock_guard<std::mutex> lock(imageMutex);
+            const auto handle = symbols.emplace(name, static_cast<uint32_t>(symbols.size() + 1)).first->second;
+            values[handle];
+            Put<uint32_t>(value, handle);
+        } else if ((ADSIGRP_SUMUP_READ == group) || (ADSIGRP_SUMUP_WRITE == group)) {
+            const auto result = SumUp(group, offset, data, writeLength, value);
+            if (result) {
+                return Result(result);
+            }
+        } else if (ADSIGRP_SUMUP_DELDEVNOTE == group) {
+            if (static_cast<uint64_t>(offset) * sizeof(uint32_t) > writeLength) {
+                return Result(ADSERR_DEVICE_INVALIDSIZE);
+            }
+            for (uint32_t i = 0; i < offset; ++i) {
+                const bool deleted = session.DelNotification(Get<uint32_t>(data));
+                Put<uint32_t>(value, deleted ? ADSERR_NOERR : ADSERR_DEVICE_NOTIFYHNDINVALID);
+            }
+        } else if ((SYSTEMSERVICE_FOPEN <= group) && (group <= SYSTEMSERVICE_FFILEFIND)) {
+            const auto result = FileService(group, offset, data, writeLength, readLength, value);
+            if (result) {
+                return Result(result);
+            }
+        } else {
+            auto result = WriteImage(group, offset, data, writeLength);
+            if (!result) {
+                result = ReadImage(group, offset, readLength, value);
+            }
+            if (result) {
+                return Result(result);
+            }
+        }
+        Put<uint32_t>(payload, ADSERR_NOERR);
+        Put<uint32_t>(payload, static_cast<uint32_t>(value.size()));
+        payload.insert(payload.end(), value.begin(), value.end());
+        return payload;
+    }
+
+    default:
+        return Result(ADSERR_DEVICE_SRVNOTSUPP);
+    }
+}
+
+/**
+ * All index groups share one process image, symbol values and the device state live outside of it
+ */
+uint32_t Simulator::ReadImage(uint32_t group, uint32_t offset, uint32_t length, std::vector<uint8_t>& out)
+{
+    std::lock_guard<std::mutex> lock(imageMutex);
+    if (ADSIGRP_SYM_VALBYHND == group) {
+        const auto it = values.find(offset);
+        if (it == values.end()) {
+            return ADSERR_DEVICE_SYMBOLNOTFOUND;
+        }
+        out = it->second;
+        out.resize(length);
+        return ADSERR_NOERR;
+    }
+
+    if (ADSIGRP_DEVICE_DATA == group) {
+        std::vector<uint8_t> state;
+        Put<uint16_t>(state, adsState);
+        Put<uint16_t>(state, devState);
+        if ((offset > state.size()) || (length > state.size() - offset)) {
+            return ADSERR_DEVICE_INVALIDOFFSET;
+        }
+        out.assign(state.begin() + offset, state.begin() + offset + length);
+        return ADSERR_NOERR;
+    }
+
+    if ((offset > memory.size()) || (length > memory.size() - offset)) {
+        return ADSERR_DEVICE_INVALIDOFFSET;
+    }
+    out.assign(memory.begin() + offset, memory.begin() + offset + length);
+    return ADSERR_NOERR;
+}
+
+/**
+ * Execute the sub requests of ADSIGRP_SUMUP_READ or ADSIGRP_SUMUP_WRITE, <out> receives
+ * the list of results followed by the data read
+ */
+uint32_t Simulator::SumUp(uint32_t group, uint32_t count, const uint8_t* data, uint32_t length,
+                          std::vector<uint8_t>& out)
+{
+    static const size_t SUB_REQUEST_LENGTH = 3 * sizeof(uint32_t);
+    if (static_cast<uint64_t>(count) * SUB_REQUEST_LENGTH > length) {
+        return ADSERR_DEVICE_INVALIDSIZE;
+    }
+
+    const uint8_t* subData = data + count * SUB_REQUEST_LENGTH;
+    const uint8_t* const end = data + length;
+    std::vector<uint8_t> values;
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto subGroup = Get<uint32_t>(data);
+        const auto subOffset = Get<uint32_t>(data);
+        const auto subLength = Get<uint32_t>(data);
+        uint32_t result;
+        if (ADSIGRP_SUMUP_READ == group) {
+            std::vector<uint8_t> value;
+            result = ReadImage(subGroup, subOffset, subLength, value);
+            value.resize(subLength);
+            values.insert(values.end(), value.begin(), value.end());
+        } else {
+            if (subLength > static_cast<size_t>(end - subData)) {
+                return ADSERR_DEVICE_INVALIDSIZE;
+            }
+            result = WriteImage(subGroup, subOffset, subData, subLength);
+            subData += subLength;
+        }
+        Put<uint32_t>(out, result);
+    }
+    out.insert(out.end(), values.begin(), values.end());
+    return ADSERR_NOERR;
+}
+
+/**
+ * Match <name> against a pattern with the wildcards '*' and '?'
+ */
+static bool Matches(const char* pattern, const char* name)
+{
+    if ('*' == *pattern) {
+        return Matches(pattern + 1, name) || (*name && Matches(pattern, name + 1));
+    }
+    if (!*pattern) {
+        return !*name;
+    }
+    return *name && (('?' == *pattern) || (*pattern == *name)) && Matches(pattern + 1, name + 1);
+}
+
+/**
+ * Serve the file index groups of the TwinCAT system service from <files>, path flags are ignored
+ */
+uint32_t Simulator::FileService(uint32_t group, uint32_t offset, const uint8_t* data, uint32_t writeLength,
+                                uint32_t readLength, std::vector<uint8_t>& out)
+{
+    const std::string name(reinterpret_cast<const char*>(data), strnlen(reinterpret_cast<const char*>(data),
+                                                                         writeLength));
+    std::lock_guard<std::mutex> lock(imageMutex);
+    auto open = openFiles.find(offset);
+    switch (group) {
+    case SYSTEMSERVICE_FOPEN:
+    {
+        const auto file = files.find(name);
+        if (offset & FOPEN_WRITE) {
+            files[name].clear();
+        } else if (file == files.end()) {
+            return ADSERR_DEVICE_NOTFOUND;
+        }
+        const size_t pos = (offset & FOPEN_APPEND) && (file != files.end()) ? file->second.size() : 0;
+        openFiles[nextFileHandle] = OpenFile {name, pos, false};
+        Put<uint32_t>(out, nextFileHandle++);
+        return ADSERR_NOERR;
+    }
+
+    case SYSTEMSERVICE_FCLOSE:
+        return openFiles.erase(offset) ? ADSERR_NOERR : ADSERR_DEVICE_NOTFOUND;
+
+    case SYSTEMSERVICE_FREAD:
+    case SYSTEMSERVICE_FWRITE:
+    {
+        if ((open == openFiles.end()) || open->second.find) {
+            return ADSERR_DEVICE_NOTFOUND;
+        }
+        auto& file = files[open->second.name];
+        auto& pos = open->second.pos;
+        if (SYSTEMSERVICE_FREAD == group) {
+            const auto begin = file.begin() + std::min(pos, file.size());
+            const auto length = std::min<size_t>(readLength, file.end() - begin);
+            out.assign(begin, begin + length);
+            pos += length;
+        } else {
+            file.resize(std::max(file.size(), pos + writeLength));
+            std::copy(data, data + writeLength, file.begin() + pos);
+            pos += writeLength;
+        }
+        return ADSERR_NOERR;
+    }
+
+    case SYSTEMSERVICE_FDELETE:
+        return files.erase(name) ? ADSERR_NOERR : ADSERR_DEVICE_NOTFOUND;
+
+    case SYSTEMSERVICE_FFILEFIND:
+    {
+        uint32_t hFind = offset;
+        if ((open == openFiles.end()) || !open->second.find) {
+            hFind = nextFileHandle++;
+            open = openFiles.emplace(hFind, OpenFile {name, 0, true}).first;
+        }
+        auto file = files.begin();
+        std::advance(file, std::min(open->second.pos, files.size()));
+        while ((file != files.end()) && !Matches(open->second.name.c_str(), file->first.c_str())) {
+            ++file;
+        }
+        if (file == files.end()) {
+            openFiles.erase(open);
+            return ADSERR_DEVICE_NOTFOUND;
+        }
+        open->second.pos = std::distance(files.begin(), file) + 1;
+
+        // WIN32_FIND_DATA preceded by the find handle
+        static const uint32_t FILE_ATTRIBUTE_NORMAL = 0x80;
+        Put<uint32_t>(out, hFind);
+        Put<uint32_t>(out, FILE_ATTRIBUTE_NORMAL);
+        out.resize(out.size() + 3 * sizeof(uint64_t));
+        Put<uint32_t>(out, static_cast<uint32_t>(static_cast<uint64_t>(file->second.size()) >> 32));
+        Put<uint32_t>(out, static_cast<uint32_t>(file->second.size()));
+        out.resize(out.size() + 2 * sizeof(uint32_t));
+        std::vector<char> fileName(260 + 14 + 2);
+        file->first.copy(fileName.data(), 259);
+        out.insert(out.end(), fileName.begin(), fileName.end());
+        return ADSERR_NOERR;
+    }
+
+    default:
+        return ADSERR_DEVICE_SRVNOTSUPP;
+    }
+}
+
+uint32_t Simulator::WriteImage(uint32_t group, uint32_t offset, const uint8_t* data, uint32_t length)
+{
+    std::lock_guard<std::mutex> lock(imageMutex);
+    if (ADSIGRP_SYM_RELEASEHND == group) {
+        if ((length < sizeof(uint32_t)) || !values.erase(qFromLittleEndian<uint32_t>(data))) {
+            return ADSERR_DEVICE_SYMBOLNOTFOUND;
+        }
+        return ADSERR_NOERR;
+    }
+
+    if (ADSIGRP_SYM_VALBYHND == group) {
+        const auto it = values.find(offset);
+        if (it == values.end()) {
+            return ADSERR_DEVICE_SYMBOLNOTFOUND;
+        }
+        it->second.assign(data, data + length);
+        return ADSERR_NOERR;
+    }
+
+    if ((offset > memory.size()) || (length > memory.size() - offset)) {
+        return ADSERR_DEVICE_INVALIDOFFSET;
+    }
+    std::copy(data, data + length, memory.begin() + offset);
+    return ADSERR_NOERR;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "AdsDef.h"
+#include "Sockets.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <istream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Response latency of one AMS command in microseconds
+ */
+struct SimLatency {
+    enum Distribution { FIXED, UNIFORM, EXPONENTIAL };
+    Distribution distribution;
+    uint32_t a; /**< FIXED: latency, UNIFORM: lower bound, EXPONENTIAL: mean */
+    uint32_t b; /**< UNIFORM: upper bound */
+};
+
+/**
+ * Faults injected into the responses of one AMS command. Probabilities are in [0, 1].
+ */
+struct SimFaults {
+    SimLatency latency;
+    double drop;        /**< response is never sent */
+    double delay;       /**< response is held back for delayUs, later responses overtake it */
+    uint32_t delayUs;
+    double error;       /**< request fails with errorCode */
+    uint32_t errorCode;
+    double reset;       /**< connection is reset in the middle of the response frame */
+    double oversize;    /**< response frame is padded with SimScript::oversizeBytes */
+};
+
+enum SimFault { SIM_DROP, SIM_DELAY, SIM_ERROR, SIM_RESET, SIM_OVERSIZE, SIM_BURST };
+
+/**
+ * One-shot fault, triggered by the n-th request the simulator receives
+ */
+struct SimEvent {
+    SimFault fault;
+    uint32_t value; /**< SIM_DELAY: microseconds, SIM_ERROR: ADS error code, SIM_BURST: notifications */
+};
+
+/**
+ * Behaviour of a Simulator. The text form is line based, '#' starts a comment.
+ * <cmd> is one of device_info, read, write, read_state, write_control,
+ * add_notification, del_notification, read_write or '*' for all of them.
+ *
+ *   seed <n>                                 seed of the random number generators
+ *   memory <bytes>                           size of the process image
+ *   latency <cmd> fixed <us>
+ *   latency <cmd> uniform <minUs> <maxUs>
+ *   latency <cmd> exponential <meanUs>
+ *   drop <cmd> <probability>
+ *   delay <cmd> <probability> <us>
+ *   error <cmd> <probability> <adsError>
+ *   reset <cmd> <probability>
+ *   oversize <cmd> <probability> [<bytes>]
+ *   burst <notifications> <periodMs>         every period send each notification n times back-to-back
+ *   accept_delay <ms>                        keep the listen backlog full for <ms>, so connects stall until
+ *                                            the client retransmits its SYN after that
+ *   at <request> drop|reset|oversize
+ *   at <request> delay <us>|error <adsError>|burst <notifications>
+ */
+struct SimScript {
+    SimScript();
+
+    /**
+     * Parse a script
+     * @throws std::invalid_argument naming the offending line
+     */
+    static SimScript Parse(std::istream& input);
+    static SimScript Parse(const std::string& script);
+
+    uint32_t seed;
+    size_t memorySize;
+    uint32_t oversizeBytes;
+    uint32_t burstCount;
+    uint32_t burstPeriodMs;
+    uint32_t acceptDelayMs;
+    std::array<SimFaults, 10> commands; /**< indexed by AMS command id */
+    std::multimap<uint64_t, SimEvent> events;
+};
+
+struct SimStats {
+    uint64_t numConnections;
+    uint64_t numRequests;
+    uint64_t numResponses;
+    uint64_t numDropped;
+    uint64_t numDelayed;
+    uint64_t numErrors;
+    uint64_t numResets;
+    uint64_t numOversized;
+    uint64_t numNotifications;
+};
+
+/**
+ * Loopback stand-in for an ADS device. It serves reads, writes, sum up requests,
+ * symbol handles, states, notifications and system service file access from an
+ * in-memory process image and file system and injects the
+ * faults of its SimScript into the responses. Each connection draws its faults
+ * from its own generator seeded with SimScript::seed and the connection number,
+ * so a single client sees the same sequence of faults in every run.
+ */
+struct Simulator {
+    /**
+     * Start listening on ip:port, use distinct addresses of 127.0.0.0/8 to run
+     * several simulators on the default ADS port.
+     * @throws std::system_error if the address is not available
+     */
+    Simulator(const SimScript& script, IpV4 ip = IpV4 {"127.0.0.1"}, uint16_t port = ADS_TCP_SERVER_PORT);
+    ~Simulator();
+    SimStats GetStats() const;
+
+private:
+    struct Session;
+    struct Response;
+
+    const SimScript script;
+    const int wsaInitialized;
+    const SOCKET listener;
+    const SOCKET filler; /**< occupies the listen backlog during SimScript::acceptDelayMs */
+    std::atomic<bool> running;
+
+    std::mutex imageMutex;
+    std::vector<uint8_t> memory;
+    std::map<std::string, uint32_t> symbols;
+    std::map<uint32_t, std::vector<uint8_t> > values;
+    uint16_t adsState;
+    uint16_t devState;
+
+    struct OpenFile {
+        std::string name; /**< of the file, or the pattern of SYSTEMSERVICE_FFILEFIND */
+        size_t pos;       /**< in the file, or index of the next matching file */
+        bool find;
+    };
+    std::map<std::string, std::vector<uint8_t> > files;
+    std::map<uint32_t, OpenFile> openFiles;
+    uint32_t nextFileHandle;
+
+    std::atomic<uint64_t> numConnections;
+    std::atomic<uint64_t> numRequests;
+    std::atomic<uint64_t> numResponses;
+    std::atomic<uint64_t> numDropped;
+    std::atomic<uint64_t> numDelayed;
+    std::atomic<uint64_t> numErrors;
+    std::atomic<uint64_t> numResets;
+    std::atomic<uint64_t> numOversized;
+    std::atomic<uint64_t> numNotifications;
+
+    std::mutex sessionsMutex;
+    std::list<std::unique_ptr<Session> > sessions;
+    std::thread acceptor;
+
+    void Accept();
+    void Handle(Session& session, const std::vector<uint8_t>& frame);
+    std::vector<uint8_t> Execute(Session& session, uint16_t cmdId, const AmsAddr& client, const AmsAddr& server,
+                                 const uint8_t* data, size_t length, std::chrono::steady_clock::time_point due);
+    uint32_t ReadImage(uint32_t group, uint32_t offset, uint32_t length, std::vector<uint8_t>& out);
+    uint32_t WriteImage(uint32_t group, uint32_t offset, const uint8_t* data, uint32_t length);
+    uint32_t SumUp(uint32_t group, uint32_t count, const uint8_t* data, uint32_t length, std::vector<uint8_t>& out);
+    uint32_t FileService(uint32_t group, uint32_t offset, const uint8_t* data, uint32_t writeLength,
+                         uint32_t readLength, std::vector<uint8_t>& out);
+};
@@ -0,0 +1,45 @@
+
+#include "Simulator.h"
+
+#include <fstream>
+#include <iostream>
+
+/**
+ * Standalone ADS device simulator for manual tests and load generation:
+ *   AdsSimulator.bin [<ip> [<script>]]
+ * Use a distinct loopback address like 127.0.0.2, if a local router already
+ * occupies the ADS port on 127.0.0.1.
+ */
+int main(int argc, char* argv[])
+{
+    try {
+        SimScript script;
+        if (argc > 2) {
+            std::ifstream file(argv[2]);
+            if (!file) {
+                std::cerr << "Open script '" << argv[2] << "' failed\n";
+                return 1;
+            }
+            script = SimScript::Parse(file);
+        }
+
+        Simulator simulator {script, IpV4 {argc > 1 ? argv[1] : "127.0.0.1"}};
+        std::cout << "Hit ENTER to stop the simulator\n";
+        std::cin.ignore();
+
+        const auto stats = simulator.GetStats();
+        std::cout << "connections:   " << stats.numConnections << '\n' <<
+            "requests:      " << stats.numRequests << '\n' <<
+            "responses:     " << stats.numResponses << '\n' <<
+            "dropped:       " << stats.numDropped << '\n' <<
+            "delayed:       " << stats.numDelayed << '\n' <<
+            "errors:        " << stats.numErrors << '\n' <<
+            "resets:        " << stats.numResets << '\n' <<
+            "oversized:     " << stats.numOversized << '\n' <<
+            "notifications: " << stats.numNotifications << '\n';
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}